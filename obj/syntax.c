@@ -0,0 +1,723 @@
+// generated by tools/syngen.c, do not edit
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+
+#include "editor.h"
+#include "term.h"
+#include "utility.h"
+
+struct synKeyword {
+  const char *word;
+  unsigned char len;
+  unsigned char hl;
+};
+
+// is_seperator as a bitmap
+static const unsigned char syn_sep[32] = {0x01, 0x3e, 0x00, 0x00, 0x21, 0xff, 0x00, 0x78, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+#define SYN_SEP(c)                                                             \
+  (syn_sep[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & 7)))
+
+static void synFill(unsigned char *hl, int base, int cap, int i, int v,
+                    int n) {
+  if (!hl)
+    return;
+  int lo = (i < base) ? base : i;
+  int hi = (i + n > base + cap) ? base + cap : i + n;
+  if (hi > lo)
+    memset(&hl[lo - base], v, hi - lo);
+}
+
+/* c, from syntax/c.syn */
+
+static char *c_match[] = {".c", ".h", ".cpp", NULL};
+static char *c_keywords[] = {"switch", "if", "while", "for", "break", "continue", "return", "else", "struct", "union", "typedef", "static", "enum", "class", "case", "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|", "void|", "#define", "#include", NULL};
+
+static const struct synKeyword c_kwtab[64] = {
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"else", 4, HL_KEYWORD1},
+    {"switch", 6, HL_KEYWORD1},
+    {"for", 3, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"unsigned", 8, HL_KEYWORD2},
+    {"union", 5, HL_KEYWORD1},
+    {"float", 5, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"static", 6, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"typedef", 7, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"#include", 8, HL_KEYWORD1},
+    {"int", 3, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"while", 5, HL_KEYWORD1},
+    {"char", 4, HL_KEYWORD2},
+    {"enum", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"long", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"class", 5, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"signed", 6, HL_KEYWORD2},
+    {"double", 6, HL_KEYWORD2},
+    {"#define", 7, HL_KEYWORD1},
+    {"if", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"return", 6, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"struct", 6, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"void", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"continue", 8, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"case", 4, HL_KEYWORD1},
+    {"break", 5, HL_KEYWORD1},
+};
+
+// highlight of the word at s if it is a keyword, else 0
+static int c_keyword(const char *s, int *len) {
+  int n = 0;
+  while (n <= 8 && !SYN_SEP(s[n]))
+    n++;
+  *len = n;
+  if (n < 2 || n > 8)
+    return 0;
+  uint32_t h = (uint32_t)(unsigned char)s[0] * 0x9e3779b1u +
+              (uint32_t)(unsigned char)s[n - 1] * 0x85ebca77u +
+              (uint32_t)(unsigned char)s[n / 2] * 0xc2b2ae3du +
+              (uint32_t)n;
+  const struct synKeyword *k = &c_kwtab[(h * 1387842591u) >> 26];
+  return (k->len == n && !memcmp(k->word, s, n)) ? k->hl : 0;
+}
+
+static int c_scan(struct hlState *st, const char *s, int len, int i,
+                   int to, unsigned char *hl, int base, int cap) {
+  if (st->line_comment) {
+    synFill(hl, base, cap, i, HL_COMMENT, to - i);
+    return to;
+  }
+
+  while (i < to) {
+    unsigned char c = s[i];
+    unsigned char prev_hl = st->prev_hl;
+
+    if (st->in_comment) { // jump to the end of the comment
+      int lim = to + 1 < len ? to + 1 : len;
+      const char *e = memmem(&s[i], lim - i, "*/", 2);
+      st->prev_hl = HL_MLCOMMENT;
+      if (!e) {
+        synFill(hl, base, cap, i, HL_MLCOMMENT, to - i);
+        return to;
+      }
+      int end = e - s + 2;
+      synFill(hl, base, cap, i, HL_MLCOMMENT, end - i);
+      i = end;
+      st->in_comment = 0;
+      st->prev_sep = 1;
+      continue;
+    }
+
+    if (st->in_string) {
+      synFill(hl, base, cap, i, HL_STRING, 1);
+      st->prev_hl = HL_STRING;
+      if (c == '\\' && i + 1 < len) {
+        synFill(hl, base, cap, i + 1, HL_STRING, 1);
+        i += 2;
+        continue;
+      }
+      if (c == st->in_string)
+        st->in_string = 0;
+      i++;
+      st->prev_sep = 1;
+      continue;
+    }
+
+    switch (c) {
+    case '"':
+    case '\'':
+      st->in_string = c;
+      synFill(hl, base, cap, i, HL_STRING, 1);
+      st->prev_hl = HL_STRING;
+      i++;
+      continue;
+    case '.':
+      if (prev_hl == HL_NUMBER) {
+        synFill(hl, base, cap, i, HL_NUMBER, 1);
+        i++;
+        st->prev_sep = 0;
+        continue;
+      }
+      break;
+    case '/':
+      if (s[i + 0] == '/' && s[i + 1] == '/') {
+        synFill(hl, base, cap, i, HL_COMMENT, to - i);
+        st->line_comment = 1;
+        st->prev_hl = HL_COMMENT;
+        return to;
+      }
+      if (s[i + 0] == '/' && s[i + 1] == '*') {
+        synFill(hl, base, cap, i, HL_MLCOMMENT, 2);
+        st->prev_hl = HL_MLCOMMENT;
+        i += 2;
+        st->in_comment = 1;
+        continue;
+      }
+      break;
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      if (st->prev_sep || prev_hl == HL_NUMBER) {
+        synFill(hl, base, cap, i, HL_NUMBER, 1);
+        st->prev_hl = HL_NUMBER;
+        i++;
+        st->prev_sep = 0;
+        continue;
+      }
+      break;
+    }
+
+    if (st->prev_sep) {
+      int n;
+      int kw = c_keyword(&s[i], &n);
+      if (kw) {
+        st->prev_hl = kw;
+        synFill(hl, base, cap, i, kw, n);
+        i += n;
+        st->prev_sep = 0;
+        continue;
+      }
+    }
+
+    st->prev_sep = SYN_SEP(c) != 0;
+    st->prev_hl = HL_NORMAL;
+    i++;
+  }
+  return i;
+}
+
+/* markdown, from syntax/markdown.syn */
+
+static char *markdown_match[] = {".md", ".markdown", NULL};
+static char *markdown_keywords[] = {"#", "##", "###", "####", "#####", "######", NULL};
+
+static const struct synKeyword markdown_kwtab[16] = {
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"###", 3, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"#####", 5, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"##", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"####", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"#", 1, HL_KEYWORD1},
+    {"######", 6, HL_KEYWORD1},
+};
+
+// highlight of the word at s if it is a keyword, else 0
+static int markdown_keyword(const char *s, int *len) {
+  int n = 0;
+  while (n <= 6 && !SYN_SEP(s[n]))
+    n++;
+  *len = n;
+  if (n < 1 || n > 6)
+    return 0;
+  uint32_t h = (uint32_t)(unsigned char)s[0] * 0x9e3779b1u +
+              (uint32_t)(unsigned char)s[n - 1] * 0x85ebca77u +
+              (uint32_t)(unsigned char)s[n / 2] * 0xc2b2ae3du +
+              (uint32_t)n;
+  const struct synKeyword *k = &markdown_kwtab[(h * 2654435769u) >> 28];
+  return (k->len == n && !memcmp(k->word, s, n)) ? k->hl : 0;
+}
+
+static int markdown_scan(struct hlState *st, const char *s, int len, int i,
+                   int to, unsigned char *hl, int base, int cap) {
+  if (st->line_comment) {
+    synFill(hl, base, cap, i, HL_COMMENT, to - i);
+    return to;
+  }
+
+  while (i < to) {
+    unsigned char c = s[i];
+
+    if (st->in_comment) { // jump to the end of the comment
+      int lim = to + 2 < len ? to + 2 : len;
+      const char *e = memmem(&s[i], lim - i, "-->", 3);
+      st->prev_hl = HL_MLCOMMENT;
+      if (!e) {
+        synFill(hl, base, cap, i, HL_MLCOMMENT, to - i);
+        return to;
+      }
+      int end = e - s + 3;
+      synFill(hl, base, cap, i, HL_MLCOMMENT, end - i);
+      i = end;
+      st->in_comment = 0;
+      st->prev_sep = 1;
+      continue;
+    }
+
+    switch (c) {
+    case '<':
+      if (s[i + 0] == '<' && s[i + 1] == '!' && s[i + 2] == '-' && s[i + 3] == '-') {
+        synFill(hl, base, cap, i, HL_MLCOMMENT, 4);
+        st->prev_hl = HL_MLCOMMENT;
+        i += 4;
+        st->in_comment = 1;
+        continue;
+      }
+      break;
+    }
+
+    if (st->prev_sep) {
+      int n;
+      int kw = markdown_keyword(&s[i], &n);
+      if (kw) {
+        st->prev_hl = kw;
+        synFill(hl, base, cap, i, kw, n);
+        i += n;
+        st->prev_sep = 0;
+        continue;
+      }
+    }
+
+    st->prev_sep = SYN_SEP(c) != 0;
+    st->prev_hl = HL_NORMAL;
+    i++;
+  }
+  return i;
+}
+
+/* sh, from syntax/sh.syn */
+
+static char *sh_match[] = {".sh", ".bash", NULL};
+static char *sh_keywords[] = {"if", "then", "else", "elif", "fi", "case", "esac", "for", "while", "until", "do", "done", "in", "function", "return", "break", "continue", "exit", "local", "export", "readonly", "echo|", "printf|", "read|", "cd|", "test|", "set|", "unset|", "shift|", "trap|", "eval|", "exec|", "source|", NULL};
+
+static const struct synKeyword sh_kwtab[128] = {
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"trap", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"printf", 6, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"then", 4, HL_KEYWORD1},
+    {"esac", 4, HL_KEYWORD1},
+    {"exit", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"in", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"fi", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"cd", 2, HL_KEYWORD2},
+    {"done", 4, HL_KEYWORD1},
+    {"shift", 5, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"return", 6, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"break", 5, HL_KEYWORD1},
+    {"exec", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"source", 6, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"echo", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"eval", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"local", 5, HL_KEYWORD1},
+    {"read", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"continue", 8, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"if", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"set", 3, HL_KEYWORD2},
+    {"for", 3, HL_KEYWORD1},
+    {"elif", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"do", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"unset", 5, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"while", 5, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"export", 6, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"function", 8, HL_KEYWORD1},
+    {"case", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"readonly", 8, HL_KEYWORD1},
+    {"test", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"until", 5, HL_KEYWORD1},
+    {"else", 4, HL_KEYWORD1},
+};
+
+// highlight of the word at s if it is a keyword, else 0
+static int sh_keyword(const char *s, int *len) {
+  int n = 0;
+  while (n <= 8 && !SYN_SEP(s[n]))
+    n++;
+  *len = n;
+  if (n < 2 || n > 8)
+    return 0;
+  uint32_t h = (uint32_t)(unsigned char)s[0] * 0x9e3779b1u +
+              (uint32_t)(unsigned char)s[n - 1] * 0x85ebca77u +
+              (uint32_t)(unsigned char)s[n / 2] * 0xc2b2ae3du +
+              (uint32_t)n;
+  const struct synKeyword *k = &sh_kwtab[(h * 3246142285u) >> 25];
+  return (k->len == n && !memcmp(k->word, s, n)) ? k->hl : 0;
+}
+
+static int sh_scan(struct hlState *st, const char *s, int len, int i,
+                   int to, unsigned char *hl, int base, int cap) {
+  if (st->line_comment) {
+    synFill(hl, base, cap, i, HL_COMMENT, to - i);
+    return to;
+  }
+
+  while (i < to) {
+    unsigned char c = s[i];
+    unsigned char prev_hl = st->prev_hl;
+
+    if (st->in_string) {
+      synFill(hl, base, cap, i, HL_STRING, 1);
+      st->prev_hl = HL_STRING;
+      if (c == '\\' && i + 1 < len) {
+        synFill(hl, base, cap, i + 1, HL_STRING, 1);
+        i += 2;
+        continue;
+      }
+      if (c == st->in_string)
+        st->in_string = 0;
+      i++;
+      st->prev_sep = 1;
+      continue;
+    }
+
+    switch (c) {
+    case '"':
+    case '\'':
+      st->in_string = c;
+      synFill(hl, base, cap, i, HL_STRING, 1);
+      st->prev_hl = HL_STRING;
+      i++;
+      continue;
+    case '#':
+      if (s[i + 0] == '#') {
+        synFill(hl, base, cap, i, HL_COMMENT, to - i);
+        st->line_comment = 1;
+        st->prev_hl = HL_COMMENT;
+        return to;
+      }
+      break;
+    case '.':
+      if (prev_hl == HL_NUMBER) {
+        synFill(hl, base, cap, i, HL_NUMBER, 1);
+        i++;
+        st->prev_sep = 0;
+        continue;
+      }
+      break;
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      if (st->prev_sep || prev_hl == HL_NUMBER) {
+        synFill(hl, base, cap, i, HL_NUMBER, 1);
+        st->prev_hl = HL_NUMBER;
+        i++;
+        st->prev_sep = 0;
+        continue;
+      }
+      break;
+    }
+
+    if (st->prev_sep) {
+      int n;
+      int kw = sh_keyword(&s[i], &n);
+      if (kw) {
+        st->prev_hl = kw;
+        synFill(hl, base, cap, i, kw, n);
+        i += n;
+        st->prev_sep = 0;
+        continue;
+      }
+    }
+
+    st->prev_sep = SYN_SEP(c) != 0;
+    st->prev_hl = HL_NORMAL;
+    i++;
+  }
+  return i;
+}
+
+/* yaml, from syntax/yaml.syn */
+
+static char *yaml_match[] = {".yml", ".yaml", NULL};
+static char *yaml_keywords[] = {"true", "false", "null", "yes", "no", "True|", "False|", "Null|", "TRUE|", "FALSE|", "NULL|", NULL};
+
+static const struct synKeyword yaml_kwtab[32] = {
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"TRUE", 4, HL_KEYWORD2},
+    {"no", 2, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"NULL", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"true", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"FALSE", 5, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"null", 4, HL_KEYWORD1},
+    {NULL, 0, 0},
+    {"True", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {"false", 5, HL_KEYWORD1},
+    {"yes", 3, HL_KEYWORD1},
+    {"Null", 4, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {"False", 5, HL_KEYWORD2},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+    {NULL, 0, 0},
+};
+
+// highlight of the word at s if it is a keyword, else 0
+static int yaml_keyword(const char *s, int *len) {
+  int n = 0;
+  while (n <= 5 && !SYN_SEP(s[n]))
+    n++;
+  *len = n;
+  if (n < 2 || n > 5)
+    return 0;
+  uint32_t h = (uint32_t)(unsigned char)s[0] * 0x9e3779b1u +
+              (uint32_t)(unsigned char)s[n - 1] * 0x85ebca77u +
+              (uint32_t)(unsigned char)s[n / 2] * 0xc2b2ae3du +
+              (uint32_t)n;
+  const struct synKeyword *k = &yaml_kwtab[(h * 774553915u) >> 27];
+  return (k->len == n && !memcmp(k->word, s, n)) ? k->hl : 0;
+}
+
+static int yaml_scan(struct hlState *st, const char *s, int len, int i,
+                   int to, unsigned char *hl, int base, int cap) {
+  if (st->line_comment) {
+    synFill(hl, base, cap, i, HL_COMMENT, to - i);
+    return to;
+  }
+
+  while (i < to) {
+    unsigned char c = s[i];
+    unsigned char prev_hl = st->prev_hl;
+
+    if (st->in_string) {
+      synFill(hl, base, cap, i, HL_STRING, 1);
+      st->prev_hl = HL_STRING;
+      if (c == '\\' && i + 1 < len) {
+        synFill(hl, base, cap, i + 1, HL_STRING, 1);
+        i += 2;
+        continue;
+      }
+      if (c == st->in_string)
+        st->in_string = 0;
+      i++;
+      st->prev_sep = 1;
+      continue;
+    }
+
+    switch (c) {
+    case '"':
+    case '\'':
+      st->in_string = c;
+      synFill(hl, base, cap, i, HL_STRING, 1);
+      st->prev_hl = HL_STRING;
+      i++;
+      continue;
+    case '#':
+      if (s[i + 0] == '#') {
+        synFill(hl, base, cap, i, HL_COMMENT, to - i);
+        st->line_comment = 1;
+        st->prev_hl = HL_COMMENT;
+        return to;
+      }
+      break;
+    case '.':
+      if (prev_hl == HL_NUMBER) {
+        synFill(hl, base, cap, i, HL_NUMBER, 1);
+        i++;
+        st->prev_sep = 0;
+        continue;
+      }
+      break;
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      if (st->prev_sep || prev_hl == HL_NUMBER) {
+        synFill(hl, base, cap, i, HL_NUMBER, 1);
+        st->prev_hl = HL_NUMBER;
+        i++;
+        st->prev_sep = 0;
+        continue;
+      }
+      break;
+    }
+
+    if (st->prev_sep) {
+      int n;
+      int kw = yaml_keyword(&s[i], &n);
+      if (kw) {
+        st->prev_hl = kw;
+        synFill(hl, base, cap, i, kw, n);
+        i += n;
+        st->prev_sep = 0;
+        continue;
+      }
+    }
+
+    st->prev_sep = SYN_SEP(c) != 0;
+    st->prev_hl = HL_NORMAL;
+    i++;
+  }
+  return i;
+}
+
+struct editorSyntax HLDB[] = {
+    {"c", c_match, c_keywords, "//", "/*", "*/", HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS, c_scan},
+    {"markdown", markdown_match, markdown_keywords, NULL, "<!--", "-->", 0 | 0, markdown_scan},
+    {"sh", sh_match, sh_keywords, "#", NULL, NULL, HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS, sh_scan},
+    {"yaml", yaml_match, yaml_keywords, "#", NULL, NULL, HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS, yaml_scan},
+};
+
+const unsigned int HLDB_ENTRIES = sizeof(HLDB) / sizeof(HLDB[0]);
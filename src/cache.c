@@ -0,0 +1,361 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "editor.h"
+#include "pool.h"
+#include "stats.h"
+
+#define CACHE_MAGIC "PEBC\x02"
+#define CACHE_MAGIC_LEN 5
+#define CACHE_SESSION 5                  // ints of session after the magic
+#define CACHE_HASH_BLOCK (1 << 20)       // bytes hashed per pool job
+
+/* hashing */
+
+static uint64_t cacheMix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// four independent lanes so the multiplies overlap
+static uint64_t cacheHashBlock(const unsigned char *p, long long n) {
+  uint64_t h[4] = {0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+                   0x165667b19e3779f9ULL, 0x27d4eb2f165667c5ULL};
+  long long i = 0;
+  for (; i + 32 <= n; i += 32) {
+    for (int k = 0; k < 4; k++) {
+      uint64_t w;
+      memcpy(&w, &p[i + 8 * k], 8);
+      h[k] = (h[k] ^ w) * 0x9fb21c651e98df25ULL;
+      h[k] ^= h[k] >> 29;
+    }
+  }
+  uint64_t r = n;
+  for (int k = 0; k < 4; k++)
+    r = cacheMix(r ^ h[k]);
+  for (; i < n; i++)
+    r = (r ^ p[i]) * 0x100000001b3ULL;
+  return cacheMix(r);
+}
+
+struct cacheHashJob {
+  const unsigned char *buf;
+  long long len;
+  uint64_t *out;
+};
+
+static void cacheHashJob(void *arg, int job) {
+  struct cacheHashJob *h = arg;
+  long long from = (long long)job * CACHE_HASH_BLOCK;
+  long long n = h->len - from < CACHE_HASH_BLOCK ? h->len - from
+                                                 : CACHE_HASH_BLOCK;
+  h->out[job] = cacheHashBlock(&h->buf[from], n);
+}
+
+// hash of the whole file, blocks are hashed on all cores
+uint64_t editorCacheHash(const char *buf, long long len) {
+  int nblocks = (len + CACHE_HASH_BLOCK - 1) / CACHE_HASH_BLOCK;
+  uint64_t *out = malloc(sizeof(uint64_t) * (nblocks ? nblocks : 1));
+  struct cacheHashJob h = {(const unsigned char *)buf, len, out};
+  poolRun(nblocks, cacheHashJob, &h);
+  uint64_t r = len;
+  for (int j = 0; j < nblocks; j++)
+    r = cacheMix(r ^ out[j]) + j;
+  free(out);
+  return r;
+}
+
+/* encoding */
+
+struct cacheBuf {
+  unsigned char *b;
+  int len;
+  int cap;
+};
+
+static void cachePut(struct cacheBuf *cb, const void *s, int n) {
+  if (cb->len + n > cb->cap) {
+    while (cb->len + n > cb->cap)
+      cb->cap = cb->cap ? cb->cap * 2 : 4096;
+    cb->b = realloc(cb->b, cb->cap);
+  }
+  memcpy(&cb->b[cb->len], s, n);
+  cb->len += n;
+}
+
+static void cachePutNum(struct cacheBuf *cb, uint64_t v) {
+  unsigned char b[10];
+  int n = 0;
+  do {
+    b[n] = v & 0x7f;
+    v >>= 7;
+    if (v)
+      b[n] |= 0x80;
+    n++;
+  } while (v);
+  cachePut(cb, b, n);
+}
+
+static void cachePutStr(struct cacheBuf *cb, const char *s) {
+  int n = strlen(s);
+  cachePutNum(cb, n);
+  cachePut(cb, s, n);
+}
+
+static int cacheGetNum(const unsigned char **p, const unsigned char *end,
+                       uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; *p < end && shift < 64; shift += 7) {
+    unsigned char b = *(*p)++;
+    *v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return 1;
+  }
+  return 0;
+}
+
+/* files */
+
+static uint64_t cacheStrHash(const char *s) {
+  uint64_t h = 0xcbf29ce484222325ULL; // fnv-1a
+  for (; *s; s++)
+    h = (h ^ (unsigned char)*s) * 0x100000001b3ULL;
+  return h;
+}
+
+// cache file for path, makes the directory, *real gets the absolute path
+static char *cachePath(const char *path, char **real, int create) {
+  *real = realpath(path, NULL);
+  if (*real == NULL)
+    return NULL;
+
+  char dir[PATH_MAX];
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (xdg && *xdg)
+    snprintf(dir, sizeof(dir), "%s/peb", xdg);
+  else if (home && *home)
+    snprintf(dir, sizeof(dir), "%s/.cache/peb", home);
+  else
+    return NULL;
+  if (create) {
+    char *slash = strrchr(dir, '/');
+    *slash = '\0';
+    mkdir(dir, 0700); // ~/.cache may not exist yet
+    *slash = '/';
+    mkdir(dir, 0700);
+  }
+
+  char *file = malloc(strlen(dir) + 18);
+  sprintf(file, "%s/%016llx", dir, (unsigned long long)cacheStrHash(*real));
+  return file;
+}
+
+// cache file for some other data derived from path, kind is appended to the
+// name to tell them apart, NULL if there is no cache directory
+char *editorCachePath(const char *path, const char *kind) {
+  char *real;
+  char *file = cachePath(path, &real, 1);
+  free(real);
+  if (!file)
+    return NULL;
+  file = realloc(file, strlen(file) + strlen(kind) + 1);
+  strcat(file, kind);
+  return file;
+}
+
+static const char *cacheFiletype() {
+  return E.syntax ? E.syntax->filetype : "";
+}
+
+static void cacheHeader(struct cacheBuf *cb, const char *real, struct stat *st,
+                        uint64_t hash) {
+  cachePutNum(cb, st->st_size);
+  cachePutNum(cb, st->st_mtim.tv_sec);
+  cachePutNum(cb, st->st_mtim.tv_nsec);
+  cachePutNum(cb, hash);
+  cachePutStr(cb, real);
+  cachePutStr(cb, cacheFiletype()); // comment states depend on the syntax
+}
+
+static void cacheSessionInts(int *s) {
+  s[0] = E.cx;
+  s[1] = E.cy;
+  s[2] = E.rowoff;
+  s[3] = E.coloff;
+  s[4] = E.wrap;
+}
+
+// look up path, 1 and c filled in if the cache matches the file
+int editorCacheRead(const char *path, struct stat *st, uint64_t hash,
+                    struct editorCache *c) {
+  char *real;
+  char *file = cachePath(path, &real, 0);
+  if (!file) {
+    free(real);
+    return 0;
+  }
+
+  int hit = 0;
+  unsigned char *data = NULL;
+  int fd = open(file, O_RDONLY);
+  struct stat cst;
+  if (fd != -1 && fstat(fd, &cst) == 0 &&
+      cst.st_size > CACHE_MAGIC_LEN + CACHE_SESSION * (int)sizeof(int)) {
+    data = malloc(cst.st_size);
+    if (read(fd, data, cst.st_size) != cst.st_size) {
+      free(data);
+      data = NULL;
+    }
+  }
+  if (fd != -1)
+    close(fd);
+
+  // compare the header against a fresh one
+  struct cacheBuf want = {NULL, 0, 0};
+  cacheHeader(&want, real, st, hash);
+  const unsigned char *p = data, *end = data ? data + cst.st_size : NULL;
+  int session[CACHE_SESSION];
+  uint64_t numrows;
+  if (data && !memcmp(p, CACHE_MAGIC, CACHE_MAGIC_LEN)) {
+    p += CACHE_MAGIC_LEN;
+    memcpy(session, p, sizeof(session));
+    p += sizeof(session);
+    if (end - p >= want.len && !memcmp(p, want.b, want.len)) {
+      p += want.len;
+      hit = cacheGetNum(&p, end, &numrows) && numrows <= INT_MAX;
+    }
+  }
+
+  if (hit) {
+    c->numrows = numrows;
+    c->lens = malloc(sizeof(int) * (numrows ? numrows : 1));
+    c->open = NULL;
+    c->words = c->chars = NULL;
+    long long total = 0;
+    for (uint64_t j = 0; hit && j < numrows; j++) {
+      uint64_t len;
+      hit = cacheGetNum(&p, end, &len) && len <= INT_MAX;
+      c->lens[j] = len;
+      total += len;
+    }
+    int bytes = (numrows + 7) / 8;
+    hit = hit && total == st->st_size && end - p > bytes;
+    if (hit) {
+      c->open = malloc(bytes ? bytes : 1);
+      memcpy(c->open, p, bytes);
+      p += bytes;
+      if (*p++) { // the rows were counted
+        c->words = malloc(sizeof(int) * (numrows ? numrows : 1));
+        c->chars = malloc(sizeof(int) * (numrows ? numrows : 1));
+        for (uint64_t j = 0; hit && j < numrows; j++) {
+          uint64_t w, n;
+          hit = cacheGetNum(&p, end, &w) && cacheGetNum(&p, end, &n) &&
+                w <= INT_MAX && n <= INT_MAX;
+          c->words[j] = w;
+          c->chars[j] = n;
+        }
+      }
+      hit = hit && p == end;
+      c->cx = session[0];
+      c->cy = session[1];
+      c->rowoff = session[2];
+      c->coloff = session[3];
+      c->wrap = session[4];
+    }
+    if (!hit)
+      editorCacheFree(c);
+  }
+
+  free(want.b);
+  free(data);
+  free(file);
+  free(real);
+  return hit;
+}
+
+// remember the rows of path, lens holds the bytes of every line in the file
+void editorCacheWrite(const char *path, struct stat *st, uint64_t hash,
+                      const int *lens) {
+  char *real;
+  char *file = cachePath(path, &real, 1);
+  if (!file) {
+    free(real);
+    return;
+  }
+
+  struct cacheBuf cb = {NULL, 0, 0};
+  int session[CACHE_SESSION];
+  cacheSessionInts(session);
+  cachePut(&cb, CACHE_MAGIC, CACHE_MAGIC_LEN);
+  cachePut(&cb, session, sizeof(session));
+  cacheHeader(&cb, real, st, hash);
+  cachePutNum(&cb, E.numrows);
+  for (int j = 0; j < E.numrows; j++)
+    cachePutNum(&cb, lens[j]);
+  int bytes = (E.numrows + 7) / 8;
+  unsigned char *bits = calloc(bytes ? bytes : 1, 1);
+  for (int j = 0; j < E.numrows; j++)
+    if (E.row[j].hl_open_comment)
+      bits[j / 8] |= 1 << (j % 8);
+  cachePut(&cb, bits, bytes);
+  free(bits);
+  unsigned char counted = editorStatsCounted();
+  cachePut(&cb, &counted, 1);
+  for (int j = 0; counted && j < E.numrows; j++) {
+    int words, chars;
+    editorStatsRowCounts(j, &words, &chars);
+    cachePutNum(&cb, words);
+    cachePutNum(&cb, chars);
+  }
+
+  // write next to it and rename so a reader never sees half a cache
+  char *tmp = malloc(strlen(file) + 5);
+  sprintf(tmp, "%s.tmp", file);
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd != -1) {
+    int ok = (write(fd, cb.b, cb.len) == cb.len);
+    close(fd);
+    if (!ok || rename(tmp, file) == -1)
+      unlink(tmp);
+  }
+
+  free(tmp);
+  free(cb.b);
+  free(file);
+  free(real);
+}
+
+// store the cursor and scroll position for the next open
+void editorCacheSession(const char *path) {
+  char *real;
+  char *file = cachePath(path, &real, 0);
+  if (file) {
+    int fd = open(file, O_WRONLY | O_CLOEXEC);
+    if (fd != -1) {
+      int session[CACHE_SESSION];
+      cacheSessionInts(session);
+      pwrite(fd, session, sizeof(session), CACHE_MAGIC_LEN);
+      close(fd);
+    }
+  }
+  free(file);
+  free(real);
+}
+
+void editorCacheFree(struct editorCache *c) {
+  free(c->lens);
+  free(c->open);
+  free(c->words);
+  free(c->chars);
+}
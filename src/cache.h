@@ -0,0 +1,32 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+// metadata cache for big files in ~/.cache/peb
+// keyed by path, size, mtime and a hash of the contents, it holds the length
+// of every line, whether a multiline comment is open at the end of each row,
+// the word and char counts of each row and the last cursor and scroll
+// position, so a reopen can split the rows without scanning, leave rows off
+// screen unhighlighted and show the counts without counting
+#define CACHE_MIN_SIZE (1 << 20) // smaller files load fast enough anyway
+
+struct editorCache {
+  int numrows;
+  int *lens;           // bytes of each line including its line ending
+  unsigned char *open; // bit per row, hl_open_comment
+  int *words, *chars;  // counts of each row, NULL if they weren't counted
+  int cx, cy, rowoff, coloff, wrap;
+};
+
+uint64_t editorCacheHash(const char *buf, long long len);
+int editorCacheRead(const char *path, struct stat *st, uint64_t hash,
+                    struct editorCache *c);
+void editorCacheWrite(const char *path, struct stat *st, uint64_t hash,
+                      const int *lens);
+void editorCacheSession(const char *path);
+void editorCacheFree(struct editorCache *c);
+char *editorCachePath(const char *path, const char *kind);
+
+#endif // CACHE_H
@@ -0,0 +1,70 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "codec.h"
+
+struct codec {
+  const char *name; // program to run
+  const char *ext;
+  const char *magic;
+  int magic_len;
+};
+
+static const struct codec CODECS[] = {
+    {"gzip", ".gz", "\x1f\x8b", 2},
+    {"zstd", ".zst", "\x28\xb5\x2f\xfd", 4},
+};
+
+#define CODEC_ENTRIES (sizeof(CODECS) / sizeof(CODECS[0]))
+
+// codec of the data in fd by its magic bytes, NULL for plain text
+const char *editorCodecDetect(int fd) {
+  char magic[4];
+  ssize_t n = pread(fd, magic, sizeof(magic), 0);
+  for (unsigned int j = 0; j < CODEC_ENTRIES; j++)
+    if (n >= CODECS[j].magic_len &&
+        !memcmp(magic, CODECS[j].magic, CODECS[j].magic_len))
+      return CODECS[j].name;
+  return NULL;
+}
+
+// codec a file should be written with by its extension
+const char *editorCodecOfPath(const char *path) {
+  int len = strlen(path);
+  for (unsigned int j = 0; j < CODEC_ENTRIES; j++) {
+    int elen = strlen(CODECS[j].ext);
+    if (len > elen && !strcmp(&path[len - elen], CODECS[j].ext))
+      return CODECS[j].name;
+  }
+  return NULL;
+}
+
+// run codec reading in and writing out, fds the caller keeps should be
+// close on exec so the pipes see their ends
+pid_t editorCodecSpawn(const char *codec, int decompress, int in, int out) {
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+
+  int null = open("/dev/null", O_WRONLY);
+  if (dup2(in, STDIN_FILENO) == -1 || dup2(out, STDOUT_FILENO) == -1)
+    _exit(127);
+  if (null != -1)
+    dup2(null, STDERR_FILENO); // keep its complaints off the screen
+  execlp(codec, codec, decompress ? "-dc" : "-c", (char *)NULL);
+  _exit(127);
+}
+
+// exit status of a codec, 0 when it worked
+int editorCodecWait(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) == -1)
+    if (errno != EINTR)
+      return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+}
@@ -0,0 +1,13 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <sys/types.h>
+
+// compressed files, gzip and zstd run as filters on pipes so the editor
+// never holds a compressed copy and nothing extra is linked in
+const char *editorCodecDetect(int fd);
+const char *editorCodecOfPath(const char *path);
+pid_t editorCodecSpawn(const char *codec, int decompress, int in, int out);
+int editorCodecWait(pid_t pid);
+
+#endif // CODEC_H
@@ -0,0 +1,528 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "complete.h"
+
+#define COMPLETE_MIN_WORD 3 // shorter words are typed faster than picked
+#define COMPLETE_MAX_WORD 64
+#define COMPLETE_MAX 32 // suggestions per lookup
+
+// a trie node, the children of a node are a list sorted by char and node 0
+// is the root, so 0 also means none
+struct completeNode {
+  int child, next, parent;
+  int count; // times the word ending here is in the buffer
+  int total; // times any word below is, subtrees at 0 are skipped
+  unsigned char c;
+};
+
+// the words of a row, a changed row takes its old ones out first
+struct completeRow {
+  int *ids; // nodes the words end at
+  int *pos; // where they start in the row
+  int n;
+  int dirty; // while replaying, has to be indexed again
+};
+
+struct completeIndex {
+  struct completeNode *node;
+  int nnodes, cap;
+  struct completeRow *rows;
+  int nrows, rowcap;
+};
+
+// row changes made while the worker builds, replayed on its index
+enum { COMPLETE_CHANGED, COMPLETE_INSERTED, COMPLETE_DELETED };
+
+struct completeOp {
+  int op;
+  int at, n;
+};
+
+enum { COMPLETE_OFF, COMPLETE_PENDING, COMPLETE_BUILDING, COMPLETE_READY };
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+  int state;
+  struct completeIndex idx; // belongs to the worker while building
+  pthread_t worker;
+  char *snap; // the rows, each ended by a newline
+  long long snap_len;
+  int done, cancel; // under lock
+  struct completeOp *log;
+  int nlog, logcap;
+
+  // the suggestions cycled through and where the last one went
+  char *words[COMPLETE_MAX];
+  int nwords, sel;
+  int cy, start, len, dirty;
+} C;
+
+/* trie */
+
+static int completeNewNode(struct completeIndex *x, unsigned char c,
+                           int parent) {
+  if (x->nnodes == x->cap) {
+    x->cap = x->cap ? x->cap * 2 : 1024;
+    x->node = realloc(x->node, sizeof(struct completeNode) * x->cap);
+  }
+  struct completeNode *n = &x->node[x->nnodes];
+  memset(n, 0, sizeof(*n));
+  n->c = c;
+  n->parent = parent;
+  return x->nnodes++;
+}
+
+// count one more w, returns the node it ends at
+static int completeAdd(struct completeIndex *x, const char *w, int len) {
+  int at = 0;
+  x->node[0].total++;
+  for (int i = 0; i < len; i++) {
+    unsigned char c = w[i];
+    int prev = 0, ch = x->node[at].child;
+    while (ch && x->node[ch].c < c) {
+      prev = ch;
+      ch = x->node[ch].next;
+    }
+    if (!ch || x->node[ch].c != c) {
+      int id = completeNewNode(x, c, at);
+      x->node[id].next = ch;
+      if (prev)
+        x->node[prev].next = id;
+      else
+        x->node[at].child = id;
+      ch = id;
+    }
+    at = ch;
+    x->node[at].total++;
+  }
+  x->node[at].count++;
+  return at;
+}
+
+// nodes stay when their word is gone, they are just skipped
+static void completeRemove(struct completeIndex *x, int id) {
+  x->node[id].count--;
+  for (int at = id; at; at = x->node[at].parent)
+    x->node[at].total--;
+  x->node[0].total--;
+}
+
+static int completeWordChar(unsigned char c) {
+  return isalnum(c) || c == '_' || c >= 0x80;
+}
+
+// the next word of s from *i worth suggesting, returns its length or 0
+// a dash joins words, so anchors and kebab-case names complete whole
+static int completeNextWord(const char *s, int len, int *i, int *start) {
+  while (*i < len) {
+    while (*i < len && !completeWordChar(s[*i]))
+      (*i)++;
+    *start = *i;
+    while (*i < len && (completeWordChar(s[*i]) ||
+                        (s[*i] == '-' && *i + 1 < len &&
+                         completeWordChar(s[*i + 1]))))
+      (*i)++;
+    int n = *i - *start;
+    if (n >= COMPLETE_MIN_WORD && n <= COMPLETE_MAX_WORD &&
+        !isdigit((unsigned char)s[*start]))
+      return n;
+  }
+  return 0;
+}
+
+static void completeIndexRow(struct completeIndex *x, int at, const char *s,
+                             int len) {
+  struct completeRow *r = &x->rows[at];
+  for (int k = 0; k < r->n; k++)
+    completeRemove(x, r->ids[k]);
+  free(r->ids);
+  free(r->pos);
+  r->ids = r->pos = NULL;
+  r->n = 0;
+  r->dirty = 0;
+
+  int i = 0, start, n = 0;
+  while (completeNextWord(s, len, &i, &start))
+    n++;
+  if (!n)
+    return;
+  r->ids = malloc(sizeof(int) * n);
+  r->pos = malloc(sizeof(int) * n);
+  i = 0;
+  int wl;
+  while ((wl = completeNextWord(s, len, &i, &start))) {
+    r->pos[r->n] = start;
+    r->ids[r->n++] = completeAdd(x, &s[start], wl);
+  }
+}
+
+// first word of a row starting at or after col
+static int completeWordAt(struct completeRow *r, int col) {
+  int lo = 0, hi = r->n;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (r->pos[mid] < col)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// index the words of s in [from, to) again, they were in [from, oldto)
+// before the edit and no word crosses either end, the words after it move
+static void completeIndexSpan(struct completeIndex *x, int at, const char *s,
+                              int from, int to, int oldto) {
+  struct completeRow *r = &x->rows[at];
+  int lo = completeWordAt(r, from), hi = completeWordAt(r, oldto);
+  for (int k = lo; k < hi; k++)
+    completeRemove(x, r->ids[k]);
+
+  int i = from, start, n = 0;
+  while (completeNextWord(s, to, &i, &start))
+    n++;
+  int total = r->n - (hi - lo) + n;
+  if (!total) {
+    completeIndexRow(x, at, "", 0);
+    return;
+  }
+  if (n > hi - lo) {
+    r->ids = realloc(r->ids, sizeof(int) * total);
+    r->pos = realloc(r->pos, sizeof(int) * total);
+  }
+  memmove(&r->ids[lo + n], &r->ids[hi], sizeof(int) * (r->n - hi));
+  memmove(&r->pos[lo + n], &r->pos[hi], sizeof(int) * (r->n - hi));
+  for (int k = lo + n; k < total; k++)
+    r->pos[k] += to - oldto;
+  r->n = total;
+  i = from;
+  int wl;
+  for (int k = lo; (wl = completeNextWord(s, to, &i, &start)); k++) {
+    r->pos[k] = start;
+    r->ids[k] = completeAdd(x, &s[start], wl);
+  }
+}
+
+static void completeRowsReserve(struct completeIndex *x, int n) {
+  if (n <= x->rowcap)
+    return;
+  x->rowcap = x->rowcap ? x->rowcap * 2 : 64;
+  while (x->rowcap < n)
+    x->rowcap *= 2;
+  x->rows = realloc(x->rows, sizeof(struct completeRow) * x->rowcap);
+}
+
+static void completeInsertRows(struct completeIndex *x, int at, int n) {
+  if (at > x->nrows)
+    at = x->nrows;
+  completeRowsReserve(x, x->nrows + n);
+  memmove(&x->rows[at + n], &x->rows[at],
+          sizeof(struct completeRow) * (x->nrows - at));
+  memset(&x->rows[at], 0, sizeof(struct completeRow) * n);
+  x->nrows += n;
+}
+
+static void completeDeleteRows(struct completeIndex *x, int at, int n) {
+  if (at >= x->nrows)
+    return;
+  if (n > x->nrows - at)
+    n = x->nrows - at;
+  for (int j = at; j < at + n; j++)
+    completeIndexRow(x, j, "", 0);
+  memmove(&x->rows[at], &x->rows[at + n],
+          sizeof(struct completeRow) * (x->nrows - at - n));
+  x->nrows -= n;
+}
+
+// rows appended by loading have no insert of their own
+static void completeGrow(struct completeIndex *x, int n) {
+  completeRowsReserve(x, n);
+  while (x->nrows < n)
+    memset(&x->rows[x->nrows++], 0, sizeof(struct completeRow));
+}
+
+static void completeFree(struct completeIndex *x) {
+  for (int j = 0; j < x->nrows; j++) {
+    free(x->rows[j].ids);
+    free(x->rows[j].pos);
+  }
+  free(x->rows);
+  free(x->node);
+  memset(x, 0, sizeof(*x));
+}
+
+/* build */
+
+static void *completeWorker(void *arg) {
+  (void)arg;
+  struct completeIndex *x = &C.idx;
+  const char *p = C.snap;
+  for (int j = 0; j < x->nrows; j++) {
+    if (j % 4096 == 0) {
+      pthread_mutex_lock(&lock);
+      int cancel = C.cancel;
+      pthread_mutex_unlock(&lock);
+      if (cancel)
+        break;
+    }
+    const char *nl = memchr(p, '\n', C.snap + C.snap_len - p);
+    completeIndexRow(x, j, p, nl - p);
+    p = nl + 1;
+  }
+  pthread_mutex_lock(&lock);
+  C.done = 1;
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+// copy the rows and hand them to the worker
+static void completeBuild() {
+  long long len = 0;
+  for (int j = 0; j < E.numrows; j++)
+    len += E.row[j].size + 1;
+  C.snap = malloc(len ? len : 1);
+  C.snap_len = len;
+  char *p = C.snap;
+  for (int j = 0; j < E.numrows; j++) {
+    memcpy(p, E.row[j].chars, E.row[j].size);
+    p += E.row[j].size;
+    *p++ = '\n';
+  }
+
+  completeGrow(&C.idx, E.numrows);
+  completeNewNode(&C.idx, 0, 0); // the root
+  C.done = C.cancel = 0;
+  C.nlog = 0;
+  if (pthread_create(&C.worker, NULL, completeWorker, NULL) != 0) {
+    free(C.snap);
+    C.snap = NULL;
+    completeFree(&C.idx);
+    C.state = COMPLETE_OFF;
+    editorSetStatusMessage("complete: no thread");
+    return;
+  }
+  C.state = COMPLETE_BUILDING;
+}
+
+static void completeLog(int op, int at, int n) {
+  if (C.nlog == C.logcap) {
+    C.logcap = C.logcap ? C.logcap * 2 : 64;
+    C.log = realloc(C.log, sizeof(struct completeOp) * C.logcap);
+  }
+  C.log[C.nlog].op = op;
+  C.log[C.nlog].at = at;
+  C.log[C.nlog++].n = n;
+}
+
+// the rows changed while building are indexed again from what they are now
+static void completeReplay() {
+  struct completeIndex *x = &C.idx;
+  for (int k = 0; k < C.nlog; k++) {
+    int at = C.log[k].at, n = C.log[k].n;
+    switch (C.log[k].op) {
+    case COMPLETE_CHANGED:
+      completeGrow(x, at + 1);
+      x->rows[at].dirty = 1;
+      break;
+    case COMPLETE_INSERTED:
+      completeInsertRows(x, at, n);
+      for (int j = at; j < at + n && j < x->nrows; j++)
+        x->rows[j].dirty = 1;
+      break;
+    case COMPLETE_DELETED:
+      completeDeleteRows(x, at, n);
+      break;
+    }
+  }
+  C.nlog = 0;
+  if (x->nrows > E.numrows)
+    completeDeleteRows(x, E.numrows, x->nrows - E.numrows);
+  for (int j = x->nrows; j < E.numrows; j++) {
+    completeGrow(x, j + 1);
+    x->rows[j].dirty = 1;
+  }
+  for (int j = 0; j < x->nrows; j++)
+    if (x->rows[j].dirty)
+      completeIndexRow(x, j, E.row[j].chars, E.row[j].size);
+}
+
+/* suggestions */
+
+static void completeCollect(struct completeIndex *x, int at, char *w, int n,
+                            int plen) {
+  if (x->node[at].count && n > plen)
+    C.words[C.nwords++] = strndup(w, n);
+  for (int ch = x->node[at].child; ch && C.nwords < COMPLETE_MAX;
+       ch = x->node[ch].next) {
+    if (!x->node[ch].total)
+      continue;
+    w[n] = x->node[ch].c;
+    completeCollect(x, ch, w, n + 1, plen);
+  }
+}
+
+static void completeLookup(const char *prefix, int len) {
+  for (int k = 0; k < C.nwords; k++)
+    free(C.words[k]);
+  C.nwords = 0;
+  if (len > COMPLETE_MAX_WORD)
+    return;
+  struct completeIndex *x = &C.idx;
+  int at = 0;
+  for (int i = 0; i < len && at != -1; i++) {
+    int ch = x->node[at].child;
+    while (ch && x->node[ch].c < (unsigned char)prefix[i])
+      ch = x->node[ch].next;
+    at = (ch && x->node[ch].c == (unsigned char)prefix[i]) ? ch : -1;
+  }
+  if (at == -1 || !x->node[at].total)
+    return;
+  char w[COMPLETE_MAX_WORD + 1];
+  memcpy(w, prefix, len);
+  completeCollect(x, at, w, len, len);
+}
+
+// put the selected word where the prefix or the last pick was
+static void completePick() {
+  erow *row = &E.row[C.cy];
+  const char *w = C.words[C.sel];
+  int wl = strlen(w), end = C.start + C.len;
+  int len = row->size - C.len + wl;
+  char *chars = malloc(len + 1);
+  memcpy(chars, row->chars, C.start);
+  memcpy(&chars[C.start], w, wl);
+  memcpy(&chars[C.start + wl], &row->chars[end], row->size - end);
+  chars[len] = '\0';
+  editorRowSet(row, chars, len);
+
+  C.len = wl;
+  E.cx = C.start + wl;
+  C.dirty = E.dirty;
+  editorSetStatusMessage("%s (%d/%d%s)", w, C.sel + 1, C.nwords,
+                         C.nwords == COMPLETE_MAX ? "+" : "");
+}
+
+/* interface */
+
+void editorCompleteStart() {
+  if (C.state == COMPLETE_OFF)
+    C.state = COMPLETE_PENDING;
+}
+
+// complete the word before the cursor, again steps through the suggestions
+void editorComplete(int dir) {
+  if (C.state != COMPLETE_READY) {
+    editorSetStatusMessage("complete: still reading the words");
+    return;
+  }
+  if (C.nwords && E.cy == C.cy && E.cy < E.numrows &&
+      E.cx == C.start + C.len && E.dirty == C.dirty) {
+    C.sel = (C.sel + dir + C.nwords) % C.nwords;
+    completePick();
+    return;
+  }
+
+  if (E.cy >= E.numrows)
+    return;
+  erow *row = &E.row[E.cy];
+  int start = E.cx;
+  while (start > 0 && (completeWordChar(row->chars[start - 1]) ||
+                       (row->chars[start - 1] == '-' && start - 1 > 0 &&
+                        completeWordChar(row->chars[start - 2]))))
+    start--;
+  if (start == E.cx) {
+    editorSetStatusMessage("complete: no word before the cursor");
+    return;
+  }
+  completeLookup(&row->chars[start], E.cx - start);
+  if (!C.nwords) {
+    editorSetStatusMessage("complete: no words start with %.*s",
+                           E.cx - start, &row->chars[start]);
+    return;
+  }
+  C.cy = E.cy;
+  C.start = start;
+  C.len = E.cx - start;
+  C.sel = dir > 0 ? 0 : C.nwords - 1;
+  completePick();
+}
+
+// before row is updated, a single edit noted in edit_at and edit_len only
+// redoes the words around it
+void editorCompleteRowChanged(erow *row) {
+  if (C.state == COMPLETE_BUILDING) {
+    completeLog(COMPLETE_CHANGED, row->idx, 1);
+    return;
+  }
+  if (C.state != COMPLETE_READY)
+    return;
+  int at = row->edit_at, len = row->edit_len;
+  if (!len || row->idx >= C.idx.nrows) {
+    completeGrow(&C.idx, row->idx + 1);
+    completeIndexRow(&C.idx, row->idx, row->chars, row->size);
+    return;
+  }
+  const char *s = row->chars;
+  int from = at, to = at + (len > 0 ? len : 0);
+  while (from > 0 && (completeWordChar(s[from - 1]) || s[from - 1] == '-'))
+    from--;
+  while (to < row->size && (completeWordChar(s[to]) || s[to] == '-'))
+    to++;
+  completeIndexSpan(&C.idx, row->idx, s, from, to, to - len);
+}
+
+void editorCompleteRowsInserted(int at, int n) {
+  if (C.state == COMPLETE_BUILDING)
+    completeLog(COMPLETE_INSERTED, at, n);
+  else if (C.state == COMPLETE_READY)
+    completeInsertRows(&C.idx, at, n);
+}
+
+void editorCompleteRowsDeleted(int at, int n) {
+  if (C.state == COMPLETE_BUILDING)
+    completeLog(COMPLETE_DELETED, at, n);
+  else if (C.state == COMPLETE_READY)
+    completeDeleteRows(&C.idx, at, n);
+}
+
+// the rows are gone, the index is built again from the new ones
+void editorCompleteReset() {
+  if (C.state == COMPLETE_OFF)
+    return;
+  if (C.state == COMPLETE_BUILDING) {
+    pthread_mutex_lock(&lock);
+    C.cancel = 1;
+    pthread_mutex_unlock(&lock);
+    pthread_join(C.worker, NULL);
+    free(C.snap);
+    C.snap = NULL;
+  }
+  completeFree(&C.idx);
+  C.nlog = 0;
+  C.state = COMPLETE_PENDING;
+}
+
+// start the build once the file is open and take in the finished index
+int editorCompleteTick() {
+  if (C.state == COMPLETE_PENDING) {
+    completeBuild();
+  } else if (C.state == COMPLETE_BUILDING) {
+    pthread_mutex_lock(&lock);
+    int done = C.done;
+    pthread_mutex_unlock(&lock);
+    if (done) {
+      pthread_join(C.worker, NULL);
+      free(C.snap);
+      C.snap = NULL;
+      completeReplay();
+      C.state = COMPLETE_READY;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include "editor.h"
+
+// word completion
+// every word of the buffer goes into a trie that knows how often each word
+// and each prefix occurs, a thread builds it from a copy of the rows after
+// opening and from then on editorUpdateRow swaps a row's old words for its new
+// ones, a lookup walks the prefix and the subtrees that still have words
+void editorCompleteStart();
+void editorComplete(int dir);
+void editorCompleteRowChanged(erow *row);
+void editorCompleteRowsInserted(int at, int n);
+void editorCompleteRowsDeleted(int at, int n);
+void editorCompleteReset();
+int editorCompleteTick();
+
+#endif // COMPLETE_H
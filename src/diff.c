@@ -0,0 +1,541 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "codec.h"
+#include "diff.h"
+#include "window.h"
+
+// gutter marks of a row
+#define DIFF_ADDED 1
+#define DIFF_CHANGED 2
+#define DIFF_DELETED 4 // lines of the file are missing above the row, or
+                       // below it on the last row
+
+static struct {
+  int on;
+  int stale; // rows changed since the last diff
+  int full;  // the matches are no good, diff everything
+
+  // the rows, mark is valid up to the next diff
+  uint64_t *hash;
+  unsigned char *mark;
+  int *match; // line of the file the row was matched to, -1 if none or edited
+  int n, cap;
+
+  // the saved file and what it was when the hashes were taken
+  uint64_t *base;
+  int nbase, basecap;
+  int have_base;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+
+  int added, changed, deleted; // lines
+} D;
+
+// a line hash, 8 bytes at a time
+static uint64_t diffHash(const char *s, int len) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t)len;
+  int i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, &s[i], 8);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  for (; i < len; i++)
+    h = (h ^ (unsigned char)s[i]) * 0x100000001b3ULL;
+  h ^= h >> 29;
+  return h;
+}
+
+/* rows */
+
+static void diffReserve(int n) {
+  if (n <= D.cap)
+    return;
+  D.cap = D.cap ? D.cap * 2 : 1024;
+  while (D.cap < n)
+    D.cap *= 2;
+  D.hash = realloc(D.hash, sizeof(uint64_t) * D.cap);
+  D.mark = realloc(D.mark, D.cap);
+  D.match = realloc(D.match, sizeof(int) * D.cap);
+}
+
+// rows appended by loading have no insert of their own
+static void diffGrow(int n) {
+  diffReserve(n);
+  for (; D.n < n; D.n++) {
+    D.hash[D.n] = diffHash(E.row[D.n].chars, E.row[D.n].size);
+    D.mark[D.n] = DIFF_ADDED;
+    D.match[D.n] = -1;
+  }
+}
+
+/* saved file */
+
+static void diffBaseLines(const char *buf, long long len) {
+  D.nbase = 0;
+  const char *p = buf, *end = buf + len;
+  while (p < end) {
+    const char *nl = memchr(p, '\n', end - p);
+    int n = (nl ? nl : end) - p;
+    while (n > 0 && p[n - 1] == '\r') // like the rows
+      n--;
+    if (D.nbase == D.basecap) {
+      D.basecap = D.basecap ? D.basecap * 2 : 1024;
+      D.base = realloc(D.base, sizeof(uint64_t) * D.basecap);
+    }
+    D.base[D.nbase++] = diffHash(p, n);
+    if (!nl)
+      break;
+    p = nl + 1;
+  }
+}
+
+static void diffKeepStat(struct stat *st) {
+  D.dev = st->st_dev;
+  D.ino = st->st_ino;
+  D.size = st->st_size;
+  D.mtime = st->st_mtim;
+  D.have_base = 1;
+}
+
+// hash the lines of the file unless that was done for it as it is now
+static int diffLoadBase() {
+  struct stat st;
+  int fd = open(E.filename, O_RDONLY | O_CLOEXEC);
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    if (fd != -1)
+      close(fd);
+    return 0;
+  }
+  if (D.have_base && st.st_dev == D.dev && st.st_ino == D.ino &&
+      st.st_size == D.size && st.st_mtim.tv_sec == D.mtime.tv_sec &&
+      st.st_mtim.tv_nsec == D.mtime.tv_nsec) {
+    close(fd);
+    return 1;
+  }
+
+  const char *codec = editorCodecDetect(fd);
+  int ok = 1;
+  if (codec) { // read it through the decompressor
+    int p[2];
+    pid_t pid = -1;
+    if (pipe2(p, O_CLOEXEC) == 0) {
+      pid = editorCodecSpawn(codec, 1, fd, p[1]);
+      close(p[1]);
+    }
+    if (pid == -1) {
+      close(fd);
+      return 0;
+    }
+    long long len = 0, cap = 1 << 16;
+    char *buf = malloc(cap);
+    ssize_t n;
+    while ((n = read(p[0], &buf[len], cap - len)) > 0) {
+      len += n;
+      if (len == cap)
+        buf = realloc(buf, cap *= 2);
+    }
+    close(p[0]);
+    ok = editorCodecWait(pid) == 0 && n == 0;
+    if (ok)
+      diffBaseLines(buf, len);
+    free(buf);
+  } else if (st.st_size > 0) {
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      ok = 0;
+    } else {
+      diffBaseLines(map, st.st_size);
+      munmap(map, st.st_size);
+    }
+  } else {
+    D.nbase = 0;
+  }
+  close(fd);
+  if (!ok)
+    return 0;
+  diffKeepStat(&st);
+  return 1;
+}
+
+/* diff */
+
+static int *vf, *vb; // furthest x on each diagonal, forward and backward
+static int vcap;
+
+// the middle snake of a[0, n) and b[0, m), from (x0, y0) to (x1, y1)
+// the ends are compared before, so there is at least one difference
+static void diffSnake(const uint64_t *a, int n, const uint64_t *b, int m,
+                      int *x0, int *y0, int *x1, int *y1) {
+  int max = (n + m + 1) / 2, off = max + 1;
+  int delta = n - m, odd = delta & 1;
+  vf[off + 1] = 0;
+  vb[off + 1] = 0;
+  for (int d = 0; d <= max; d++) {
+    for (int k = -d; k <= d; k += 2) {
+      int x = (k == -d || (k != d && vf[off + k - 1] < vf[off + k + 1]))
+                  ? vf[off + k + 1]
+                  : vf[off + k - 1] + 1;
+      int y = x - k, sx = x, sy = y;
+      while (x < n && y < m && a[x] == b[y])
+        x++, y++;
+      vf[off + k] = x;
+      int c = delta - k; // the same diagonal going backward
+      if (odd && c >= -(d - 1) && c <= d - 1 && x + vb[off + c] >= n) {
+        *x0 = sx, *y0 = sy, *x1 = x, *y1 = y;
+        return;
+      }
+    }
+    for (int k = -d; k <= d; k += 2) {
+      int x = (k == -d || (k != d && vb[off + k - 1] < vb[off + k + 1]))
+                  ? vb[off + k + 1]
+                  : vb[off + k - 1] + 1;
+      int y = x - k, sx = x, sy = y;
+      while (x < n && y < m && a[n - 1 - x] == b[m - 1 - y])
+        x++, y++;
+      vb[off + k] = x;
+      int c = delta - k;
+      if (!odd && c >= -d && c <= d && x + vf[off + c] >= n) {
+        *x0 = n - x, *y0 = m - y, *x1 = n - sx, *y1 = m - sy;
+        return;
+      }
+    }
+  }
+}
+
+// set ma and mb for the lines of a[a0, a1) and b[b0, b1) that stay
+static void diffMyers(const uint64_t *a, int a0, int a1, const uint64_t *b,
+                      int b0, int b1, char *ma, char *mb) {
+  while (a0 < a1 && b0 < b1 && a[a0] == b[b0])
+    ma[a0++] = mb[b0++] = 1;
+  while (a0 < a1 && b0 < b1 && a[a1 - 1] == b[b1 - 1])
+    ma[--a1] = mb[--b1] = 1;
+  if (a0 == a1 || b0 == b1)
+    return;
+
+  int need = (a1 - a0 + b1 - b0 + 1) / 2 * 2 + 3;
+  if (need > vcap) {
+    vcap = need;
+    vf = realloc(vf, sizeof(int) * vcap);
+    vb = realloc(vb, sizeof(int) * vcap);
+  }
+  int x0, y0, x1, y1;
+  diffSnake(&a[a0], a1 - a0, &b[b0], b1 - b0, &x0, &y0, &x1, &y1);
+  for (int i = 0; i < x1 - x0; i++)
+    ma[a0 + x0 + i] = mb[b0 + y0 + i] = 1;
+  diffMyers(a, a0, a0 + x0, b, b0, b0 + y0, ma, mb);
+  diffMyers(a, a0 + x1, a1, b, b0 + y1, b1, ma, mb);
+}
+
+// a line of either side, -1 if it isn't there, -2 if it is more than once
+struct diffLine {
+  uint64_t h;
+  int pa, pb;
+};
+
+static struct diffLine *diffSlot(struct diffLine *t, int mask, uint64_t h) {
+  for (int i = h & mask;; i = (i + 1) & mask)
+    if (t[i].h == h || (t[i].pa == -1 && t[i].pb == -1))
+      return &t[i];
+}
+
+// lines once in a and once in b that keep their order anchor the diff, so
+// Myers only sees the stretches between them
+static void diffAnchored(const uint64_t *a, int na, const uint64_t *b, int nb,
+                         char *ma, char *mb) {
+  int a0 = 0, b0 = 0, a1 = na, b1 = nb;
+  while (a0 < a1 && b0 < b1 && a[a0] == b[b0])
+    ma[a0++] = mb[b0++] = 1;
+  while (a0 < a1 && b0 < b1 && a[a1 - 1] == b[b1 - 1])
+    ma[--a1] = mb[--b1] = 1;
+  if (a0 == a1 || b0 == b1)
+    return;
+
+  int size = 1024;
+  while (size < (a1 - a0 + b1 - b0) * 3 / 2)
+    size *= 2;
+  struct diffLine *t = malloc(sizeof(struct diffLine) * size);
+  memset(t, 0xff, sizeof(struct diffLine) * size);
+  for (int i = a0; i < a1; i++) {
+    struct diffLine *l = diffSlot(t, size - 1, a[i]);
+    l->h = a[i];
+    l->pa = l->pa == -1 ? i : -2;
+  }
+  for (int j = b0; j < b1; j++) {
+    struct diffLine *l = diffSlot(t, size - 1, b[j]);
+    l->h = b[j];
+    l->pb = l->pb == -1 ? j : -2;
+  }
+
+  // longest increasing run of b positions over the unique pairs
+  int *pa = malloc(sizeof(int) * (a1 - a0)), *pb = malloc(sizeof(int) * (a1 - a0));
+  int np = 0;
+  for (int i = a0; i < a1; i++) {
+    struct diffLine *l = diffSlot(t, size - 1, a[i]);
+    if (l->pa == i && l->pb >= 0) {
+      pa[np] = i;
+      pb[np++] = l->pb;
+    }
+  }
+  free(t);
+  int *tail = malloc(sizeof(int) * (np + 1)), *prev = malloc(sizeof(int) * (np + 1));
+  int len = 0;
+  for (int k = 0; k < np; k++) {
+    int lo = 0, hi = len;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (pb[tail[mid]] < pb[k])
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    prev[k] = lo ? tail[lo - 1] : -1;
+    tail[lo] = k;
+    if (lo == len)
+      len++;
+  }
+  int *chain = malloc(sizeof(int) * (len + 1));
+  for (int k = len ? tail[len - 1] : -1, c = len; k != -1; k = prev[k])
+    chain[--c] = k;
+
+  int ia = a0, ib = b0;
+  for (int c = 0; c < len; c++) {
+    int i = pa[chain[c]], j = pb[chain[c]];
+    diffMyers(a, ia, i, b, ib, j, ma, mb);
+    ma[i] = mb[j] = 1;
+    ia = i + 1;
+    ib = j + 1;
+  }
+  diffMyers(a, ia, a1, b, ib, b1, ma, mb);
+  free(chain);
+  free(tail);
+  free(prev);
+  free(pa);
+  free(pb);
+}
+
+// diff the rows against the saved file and mark them
+// after edits the rows still matched to the same lines stay, only the
+// stretches between them are diffed again
+static void diffRun() {
+  if (D.n > E.numrows)
+    D.n = E.numrows;
+  diffGrow(E.numrows);
+  char *ma = calloc(D.nbase + 1, 1), *mb = calloc(D.n + 1, 1);
+  if (D.full) {
+    diffAnchored(D.base, D.nbase, D.hash, D.n, ma, mb);
+  } else {
+    int ia = 0, ib = 0;
+    for (int j = 0; j <= D.n; j++) {
+      if (j < D.n && D.match[j] < 0)
+        continue;
+      int i = j < D.n ? D.match[j] : D.nbase;
+      diffMyers(D.base, ia, i, D.hash, ib, j, ma, mb);
+      if (j < D.n)
+        ma[i] = mb[j] = 1;
+      ia = i + 1;
+      ib = j + 1;
+    }
+  }
+  D.stale = 0;
+  D.full = 0;
+
+  memset(D.mark, 0, D.n);
+  D.added = D.changed = D.deleted = 0;
+  int i = 0, j = 0;
+  while (i < D.nbase || j < D.n) {
+    if (i < D.nbase && j < D.n && ma[i] && mb[j]) {
+      D.match[j++] = i++;
+      continue;
+    }
+    int del = 0, ins = 0;
+    while (i + del < D.nbase && !ma[i + del])
+      del++;
+    while (j + ins < D.n && !mb[j + ins])
+      ins++;
+    int changed = del < ins ? del : ins;
+    for (int k = 0; k < ins; k++) {
+      D.mark[j + k] = k < changed ? DIFF_CHANGED : DIFF_ADDED;
+      D.match[j + k] = -1;
+    }
+    if (del > ins) {
+      if (j + ins < D.n)
+        D.mark[j + ins] |= DIFF_DELETED;
+      else if (D.n)
+        D.mark[D.n - 1] |= DIFF_DELETED;
+    }
+    D.changed += changed;
+    D.added += ins - changed;
+    D.deleted += del - changed;
+    i += del;
+    j += ins;
+  }
+  free(ma);
+  free(mb);
+}
+
+static void diffFree() {
+  free(D.hash);
+  free(D.mark);
+  free(D.match);
+  D.hash = NULL;
+  D.mark = NULL;
+  D.match = NULL;
+  D.n = D.cap = 0;
+}
+
+/* interface */
+
+// turn the gutter on, or diff again
+void editorDiffStart() {
+  if (!E.filename) {
+    editorSetStatusMessage("diff: the buffer has no file");
+    return;
+  }
+  if (!diffLoadBase()) {
+    editorSetStatusMessage("diff: can't read %.40s", E.filename);
+    return;
+  }
+  if (!D.on) {
+    D.on = 1;
+    D.n = 0;
+    editorWindowRelayout();
+  }
+  D.full = 1;
+  diffRun();
+  editorSetStatusMessage("diff: %d added, %d changed, %d deleted", D.added,
+                         D.changed, D.deleted);
+}
+
+void editorDiffStop() {
+  if (!D.on)
+    return;
+  D.on = 0;
+  diffFree();
+  editorWindowRelayout();
+}
+
+int editorDiffGutter() { return D.on ? DIFF_GUTTER : 0; }
+
+// the mark of row in the gutter, blank for -1 or further lines of a row
+void editorDiffDrawGutter(struct abuf *ab, int row) {
+  if (!D.on)
+    return;
+  int m = (row >= 0 && row < D.n) ? D.mark[row] : 0;
+  if (m & DIFF_ADDED)
+    abAppend(ab, "\x1b[32m+\x1b[39m ", 12);
+  else if (m & DIFF_CHANGED)
+    abAppend(ab, "\x1b[34m~\x1b[39m ", 12);
+  else if (m & DIFF_DELETED)
+    abAppend(ab, "\x1b[31m_\x1b[39m ", 12);
+  else
+    abAppend(ab, "  ", 2);
+}
+
+// a changed row shows as changed until the next diff says more
+void editorDiffRowChanged(erow *row) {
+  if (!D.on)
+    return;
+  if (row->idx >= D.n) {
+    diffGrow(row->idx + 1);
+    D.stale = 1;
+    return;
+  }
+  uint64_t h = diffHash(row->chars, row->size);
+  if (h == D.hash[row->idx]) // rendered for the first time
+    return;
+  D.hash[row->idx] = h;
+  D.match[row->idx] = -1;
+  if (!(D.mark[row->idx] & DIFF_ADDED))
+    D.mark[row->idx] |= DIFF_CHANGED;
+  D.stale = 1;
+}
+
+void editorDiffRowsInserted(int at, int n) {
+  if (!D.on || at > D.n)
+    return;
+  diffReserve(D.n + n);
+  memmove(&D.hash[at + n], &D.hash[at], sizeof(uint64_t) * (D.n - at));
+  memmove(&D.mark[at + n], &D.mark[at], D.n - at);
+  memmove(&D.match[at + n], &D.match[at], sizeof(int) * (D.n - at));
+  for (int j = at; j < at + n; j++) {
+    D.hash[j] = 0; // hashed when the row is updated
+    D.mark[j] = DIFF_ADDED;
+    D.match[j] = -1;
+  }
+  D.n += n;
+  D.stale = 1;
+}
+
+void editorDiffRowsDeleted(int at, int n) {
+  if (!D.on || at >= D.n)
+    return;
+  if (n > D.n - at)
+    n = D.n - at;
+  memmove(&D.hash[at], &D.hash[at + n], sizeof(uint64_t) * (D.n - at - n));
+  memmove(&D.mark[at], &D.mark[at + n], D.n - at - n);
+  memmove(&D.match[at], &D.match[at + n], sizeof(int) * (D.n - at - n));
+  D.n -= n;
+  D.stale = 1;
+}
+
+// the rows are gone, the ones read again get hashed as they come
+void editorDiffReset() {
+  D.n = 0;
+  D.stale = 1;
+  D.full = 1;
+}
+
+// the rows are the file now
+void editorDiffSaved() {
+  struct stat st;
+  if (!D.on || stat(E.filename, &st) == -1) {
+    D.have_base = 0;
+    return;
+  }
+  if (D.n > E.numrows)
+    D.n = E.numrows;
+  diffGrow(E.numrows);
+  if (D.basecap < D.n) {
+    D.basecap = D.n;
+    D.base = realloc(D.base, sizeof(uint64_t) * D.basecap);
+  }
+  memcpy(D.base, D.hash, sizeof(uint64_t) * D.n);
+  D.nbase = D.n;
+  diffKeepStat(&st);
+  // every row is its own line, nothing to diff
+  memset(D.mark, 0, D.n);
+  for (int j = 0; j < D.n; j++)
+    D.match[j] = j;
+  D.added = D.changed = D.deleted = 0;
+  D.stale = 0;
+  D.full = 0;
+}
+
+// the file changed under the edits, hash it again
+void editorDiffReload() {
+  if (!D.on || !diffLoadBase())
+    return;
+  D.stale = 1;
+  D.full = 1;
+}
+
+// diff again once the edits pause, returns whether marks may have changed
+int editorDiffTick() {
+  if (!D.on || !D.stale)
+    return 0;
+  diffRun();
+  return 1;
+}
@@ -0,0 +1,25 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include "editor.h"
+
+// changes against the file on disk
+// every row keeps a hash of its line, updated as rows change, and the hashes
+// of the saved file are kept until it changes on disk, the diff matches the
+// lines unique to both sides first and runs the linear space Myers diff only
+// on the stretches between them, marks go in a gutter left of the text
+#define DIFF_GUTTER 2 // columns of the gutter, the mark and a space
+
+void editorDiffStart();
+void editorDiffStop();
+int editorDiffGutter();
+void editorDiffDrawGutter(struct abuf *ab, int row);
+void editorDiffRowChanged(erow *row);
+void editorDiffRowsInserted(int at, int n);
+void editorDiffRowsDeleted(int at, int n);
+void editorDiffReset();
+void editorDiffSaved();
+void editorDiffReload();
+int editorDiffTick();
+
+#endif // DIFF_H
@@ -0,0 +1,169 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stddef.h>
+#include <termios.h>
+#include <time.h>
+
+#include "utility.h"
+
+// long rows keep their chars in one buffer like any other row, every module
+// and the spell worker read row->chars directly, a keystroke only moves the
+// tail of the row, a few ms for 20 MB, the render and highlight were the cost
+#define LONG_ROW_THRESHOLD (1 << 16) // rows this long only render a window
+#define LONG_ROW_CHUNK 4096          // chars between highlight checkpoints
+#define LONG_ROW_MARGIN 1024         // columns rendered beyond the screen
+
+struct hlState;
+
+struct editorSyntax {
+  char *filetype;
+  char **filematch;
+  char **keywords;
+  char *singleline_comment_start;
+  char *multiline_comment_start;
+  char *multiline_comment_end;
+  int flags;
+  // scanner generated from syntax/*.syn, same contract as editorHighlightSpan
+  int (*scan)(struct hlState *st, const char *s, int len, int i, int to,
+              unsigned char *hl, int base, int cap);
+};
+
+// the filetypes, generated from syntax/*.syn by tools/syngen.c
+extern struct editorSyntax HLDB[];
+extern const unsigned int HLDB_ENTRIES;
+
+// highlighter state between two chars of a row
+struct hlState {
+  char in_string;    // quote char of the open string or 0
+  char in_comment;   // inside a multiline comment
+  char line_comment; // rest of the row is a singleline comment
+  char prev_sep;     // previous char was a seperator
+  unsigned char prev_hl;
+};
+
+// highlighter state at chars[cx], long rows keep one every LONG_ROW_CHUNK
+// chars, the last one is at the end of the row
+struct hlCheckpoint {
+  int cx;
+  int rx;
+  int tabs; // tabs in chars[0..cx)
+  struct hlState st;
+};
+
+#define ROW_INLINE 16 // rows shorter than this keep their chars in the erow
+
+// erow flags
+#define ROW_INLINE_CHARS (1 << 0) // chars is u.inl
+#define ROW_RENDER_CHARS (1 << 1) // no tabs, render is chars itself
+#define ROW_LONG (1 << 2)         // u.lr holds checkpoints, see longrow.c
+#define ROW_DEFERRED (1 << 3)     // changed by a macro replay, not rendered yet
+
+typedef struct erow {
+  int idx;
+  int size;
+  int rsize;
+  unsigned char flags;
+  unsigned char hl_open_comment;
+  unsigned char spell_state; // see spell.c
+  char *chars;
+  char *render;
+  unsigned char *hl; // 4 bits per render column, NULL if all HL_NORMAL
+
+  // long rows, render and hl only hold the columns [roff, roff + rsize)
+  int roff;
+  int rwidth; // render width of the whole row
+  union {
+    struct {
+      struct hlCheckpoint *cps;
+      int ncps;
+      int cps_size; // size when the checkpoints were built
+    } lr;
+    char inl[ROW_INLINE];
+  } u;
+  int edit_at;  // first char changed since the last update
+  int edit_len; // chars inserted (> 0) or removed (< 0) there, 0 if unknown
+
+  unsigned char *spell; // 1 for the chars of misspelled words, NULL if none
+} erow;
+
+// cursor and scroll position of a window, see window.c
+struct editorView {
+  int cx, cy, rx;
+  int rowoff, coloff;
+  int wrap, wrapoff;
+  int screenrows, screencols;
+};
+
+struct editorConfig {
+  int mode;
+  int cx, cy; // cursor x,y
+  int rx;     // render x
+  int rowoff;
+  int coloff;
+  int wrap;    // soft wrap long rows instead of scrolling sideways
+  int wrapoff; // visual line of row rowoff at the top of the screen
+  int screenrows;
+  int screencols;
+  int numrows;
+  int rowcap; // rows allocated in row
+  erow *row;
+  int dirty; // flag for unsaved changes
+  char *filename;
+  const char *codec; // gzip or zstd if the file is compressed
+  char statusmsg[80];
+  time_t statusmsg_time;
+  struct editorSyntax *syntax;
+  struct termios orig_termios;
+};
+
+extern struct editorConfig E;
+
+/* main.c */
+void editorHlStart(erow *row, struct hlState *st);
+int editorHighlightSpan(struct hlState *st, const char *s, int len, int i, int to,
+                        unsigned char *hl, int base, int cap);
+void editorUpdateSyntax(erow *row);
+int editorRowHl(erow *row, int i);
+void editorRowSetHl(erow *row, const unsigned char *hl, int n);
+void editorRowFreeRender(erow *row);
+int editorRowCxToRx(erow *row, int cx);
+int editorRowRxToCx(erow *row, int rx);
+void editorRowEdited(erow *row, int at, int len);
+void editorRowRender(erow *row);
+void editorRowsRenderDeferred();
+void editorInsertRow(int at, char *s, size_t len);
+void editorInsertRows(int at, const char *buf, long long len);
+void editorDelRow(int at);
+void editorDelRows(int at, int n);
+void editorRowInsertChar(erow *row, int at, int c);
+void editorRowAppendString(erow *row, char *s, size_t len);
+void editorRowDelChar(erow *row, int at);
+void editorRowTruncate(erow *row, int size);
+void editorRowSet(erow *row, char *chars, int len);
+int editorSetRows(int at, const char *buf, long long len);
+int editorLoadRows(const char *buf, int len, int partial);
+void editorLoadRowsDone(int partial);
+long long editorReadRows(int fd, int *partial);
+void editorOpen(char *filename);
+void editorCloseFile();
+void editorFreeRows();
+void editorSetStatusMessage(const char *fmt, ...);
+void editorRefreshScreen();
+void editorScroll();
+void editorDrawRows(void (*emit)(int y, struct abuf *line, int cols));
+void editorDrawStatusBar(struct abuf *ab, int active);
+void editorDrawMessageBar(struct abuf *ab, int cols);
+char *editorPrompt(char *prompt, void (*callback)(char *, int));
+char *editorPromptAccept(char *prompt, void (*callback)(char *, int),
+                         int (*accept)(char *));
+void editorProcessKeypress();
+
+/* longrow.c */
+void editorLongRowUpdate(erow *row);
+void editorLongRowWindow(erow *row, int col, int width);
+void editorLongRowFree(erow *row);
+int editorLongRowCxToRx(erow *row, int cx);
+int editorLongRowRxToCx(erow *row, int rx);
+
+#endif // EDITOR_H
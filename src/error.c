@@ -2,7 +2,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "output.h"
+
 void die(const char *s) {
+  editorOutputFlush(); // no frame may land after the message
   write(STDOUT_FILENO, "\x1b[H", 3); // place cursor top left corner
   perror(s);
   exit(1);
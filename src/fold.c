@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "fold.h"
+#include "layout.h"
+#include "outline.h"
+
+// rows start + 1 to end are hidden, start stays as the fold line
+struct fold {
+  int start;
+  int end;
+};
+
+static struct {
+  struct fold *f; // by start, outer folds first
+  int n;
+  int cap;
+} F = {NULL, 0, 0};
+
+int editorFolds() { return F.n > 0; }
+
+// first fold starting at or after row
+static int foldFind(int row) {
+  int lo = 0, hi = F.n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (F.f[mid].start < row)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void foldRemove(int j) {
+  editorLayoutCover(F.f[j].start + 1, F.f[j].end, -1);
+  memmove(&F.f[j], &F.f[j + 1], sizeof(struct fold) * (F.n - j - 1));
+  F.n--;
+}
+
+static void foldAdd(int start, int end) {
+  int j = foldFind(start);
+  while (j < F.n && F.f[j].start == start && F.f[j].end > end)
+    j++;
+  if (F.n == F.cap) {
+    F.cap = F.cap ? F.cap * 2 : 16;
+    F.f = realloc(F.f, sizeof(struct fold) * F.cap);
+  }
+  memmove(&F.f[j + 1], &F.f[j], sizeof(struct fold) * (F.n - j));
+  F.f[j].start = start;
+  F.f[j].end = end;
+  F.n++;
+  editorLayoutCover(start + 1, end, 1);
+}
+
+// rows hidden by a fold on row, 0 if there is none
+int editorFoldAt(int row) {
+  int j = foldFind(row);
+  if (j < F.n && F.f[j].start == row)
+    return F.f[j].end - F.f[j].start;
+  return 0;
+}
+
+// fold the section or code block around the cursor, or open the fold on it
+void editorFoldToggle() {
+  if (E.cy >= E.numrows)
+    return;
+  int j = foldFind(E.cy);
+  if (j < F.n && F.f[j].start == E.cy) {
+    foldRemove(j);
+    return;
+  }
+
+  int start, end;
+  if (!editorOutlineSection(E.cy, &start, &end) || end <= start) {
+    editorSetStatusMessage("Nothing to fold");
+    return;
+  }
+  foldAdd(start, end);
+  E.cy = start;
+  E.cx = 0;
+}
+
+// open every fold hiding row
+void editorFoldOpen(int row) {
+  for (int j = foldFind(row) - 1; j >= 0; j--)
+    if (F.f[j].start < row && row <= F.f[j].end)
+      foldRemove(j);
+}
+
+void editorFoldOpenAll() {
+  while (F.n)
+    foldRemove(F.n - 1);
+}
+
+static void foldCover(int delta) {
+  for (int j = 0; j < F.n; j++)
+    editorLayoutCover(F.f[j].start + 1, F.f[j].end, delta);
+}
+
+// the rows hidden by fold j, 0 past the last one, for a layout being built
+int editorFoldRange(int j, int *from, int *to) {
+  if (j >= F.n)
+    return 0;
+  *from = F.f[j].start + 1;
+  *to = F.f[j].end;
+  return 1;
+}
+
+// n rows were inserted at at, rows inserted inside a fold grow it
+// the folds come off the layouts while their leaves move, O(folds log n)
+void editorFoldRowsInserted(int at, int n) {
+  foldCover(-1);
+  editorLayoutRowsInserted(at, n);
+  for (int j = 0; j < F.n; j++) {
+    if (F.f[j].start >= at)
+      F.f[j].start += n;
+    if (F.f[j].end >= at)
+      F.f[j].end += n;
+  }
+  foldCover(1);
+}
+
+// deleting the fold line or every hidden row drops the fold
+void editorFoldRowsDeleted(int at, int n) {
+  foldCover(-1);
+  editorLayoutRowsDeleted(at, n);
+  int kept = 0;
+  for (int j = 0; j < F.n; j++) {
+    struct fold f = F.f[j];
+    if (f.start >= at && f.start < at + n)
+      continue;
+    if (f.start > at)
+      f.start -= n;
+    if (f.end >= at) // less the deleted rows up to it
+      f.end -= (f.end < at + n ? f.end + 1 : at + n) - at;
+    if (f.end > f.start)
+      F.f[kept++] = f;
+  }
+  F.n = kept;
+  foldCover(1);
+}
+
+void editorFoldReset() { F.n = 0; }
@@ -0,0 +1,18 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+// folds hide the rows after a markdown heading up to the next heading of the
+// same or a higher level, or the inside of a fenced code block
+// a fold is a row range that moves with inserted and deleted rows, the layout
+// tree hides the ranges so drawing and moving never look at folded rows
+int editorFolds();
+int editorFoldAt(int row);
+void editorFoldToggle();
+void editorFoldOpen(int row);
+void editorFoldOpenAll();
+int editorFoldRange(int j, int *from, int *to);
+void editorFoldRowsInserted(int at, int n);
+void editorFoldRowsDeleted(int at, int n);
+void editorFoldReset();
+
+#endif // FOLD_H
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "diff.h"
+#include "editor.h"
+#include "follow.h"
+#include "journal.h"
+
+#define FOLLOW_EVENTS                                                          \
+  (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+
+static struct {
+  int fd; // inotify instance, -1 when not following
+  int wd; // watch on the file, -1 while it is gone
+  char *path;
+  long long offset; // bytes of the file that are in the buffer
+  int partial;      // the last row is still waiting for its newline
+  dev_t dev;
+  ino_t ino;
+} F = {-1, -1, NULL, 0, 0, 0, 0};
+
+int editorFollowing() { return F.fd != -1; }
+
+static void followWatch() {
+  F.wd = inotify_add_watch(F.fd, F.path, FOLLOW_EVENTS);
+}
+
+// the cursor sits on the last row, keep it there as rows come in
+static int followPinned() { return E.cy >= E.numrows - 1; }
+
+static void followClampCursor(int pinned) {
+  if (pinned && E.numrows)
+    E.cy = E.numrows - 1;
+  if (E.cy > E.numrows)
+    E.cy = E.numrows;
+  int size = (E.cy < E.numrows) ? E.row[E.cy].size : 0;
+  if (E.cx > size)
+    E.cx = size;
+}
+
+// read the whole file again, for when it was truncated or replaced
+static int followReload() {
+  int fd = open(F.path, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return 0;
+  }
+  F.dev = st.st_dev;
+  F.ino = st.st_ino;
+
+  int pinned = followPinned();
+  editorFreeRows();
+  F.partial = 0;
+  F.offset = editorReadRows(fd, &F.partial);
+  close(fd);
+  E.dirty = 0;
+  followClampCursor(pinned);
+  editorJournalReset(); // the journal is relative to the new contents
+  editorDiffSaved();
+  return 1;
+}
+
+// read only what was appended since the last read
+static int followAppend() {
+  int fd = open(F.path, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  if (lseek(fd, F.offset, SEEK_SET) == -1) {
+    close(fd);
+    return 0;
+  }
+  int pinned = followPinned();
+  long long n = editorReadRows(fd, &F.partial);
+  close(fd);
+  F.offset += n;
+  followClampCursor(pinned);
+  if (n <= 0)
+    return 0;
+  if (E.dirty) // the appended lines are in the file too
+    editorDiffReload();
+  else
+    editorDiffSaved();
+  return 1;
+}
+
+void editorFollowStop() {
+  if (F.fd == -1)
+    return;
+  close(F.fd);
+  F.fd = -1;
+  F.wd = -1;
+}
+
+void editorFollowStart() {
+  if (E.filename == NULL) {
+    editorSetStatusMessage("No file to follow");
+    return;
+  }
+  if (E.codec) {
+    editorSetStatusMessage("Can't follow a compressed file");
+    return;
+  }
+  if (E.dirty) {
+    editorSetStatusMessage("File has unsaved changes. Save before following.");
+    return;
+  }
+  editorFollowStop();
+  F.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (F.fd == -1) {
+    editorSetStatusMessage("Can't follow: %s", strerror(errno));
+    return;
+  }
+  free(F.path);
+  F.path = strdup(E.filename);
+  followWatch();
+  // start from a known offset, the file may have grown since it was opened
+  if (!followReload()) {
+    editorSetStatusMessage("Can't follow: %s", strerror(errno));
+    editorFollowStop();
+    return;
+  }
+  editorSetStatusMessage("Following %s", F.path);
+}
+
+// our own save rewrote the file, the buffer is all of it now
+void editorFollowSaved(long long size) {
+  if (F.fd == -1)
+    return;
+  struct stat st;
+  if (stat(F.path, &st) == 0) {
+    F.dev = st.st_dev;
+    F.ino = st.st_ino;
+  }
+  F.offset = size;
+  F.partial = 0;
+}
+
+// called from the idle loop, returns 1 if the rows changed
+int editorFollowTick() {
+  if (F.fd == -1)
+    return 0;
+
+  long buf[1024]; // aligned for struct inotify_event
+  int changed = 0;
+  ssize_t n;
+  while ((n = read(F.fd, buf, sizeof(buf))) > 0) {
+    char *p = (char *)buf;
+    while (p < (char *)buf + n) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+      if (ev->wd == F.wd) {
+        if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+          // rotated or deleted, watch the path again once it exists
+          if (!(ev->mask & IN_IGNORED))
+            inotify_rm_watch(F.fd, F.wd);
+          F.wd = -1;
+        }
+        changed = 1;
+      }
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+  if (F.wd == -1) {
+    followWatch();
+    if (F.wd == -1)
+      return 0;
+    changed = 1;
+  }
+  if (!changed)
+    return 0;
+
+  struct stat st;
+  if (stat(F.path, &st) == -1)
+    return 0;
+  if (st.st_dev != F.dev || st.st_ino != F.ino || st.st_size < F.offset) {
+    if (E.dirty) { // do not throw away edits
+      editorSetStatusMessage("%s changed on disk, stopped following", F.path);
+      editorFollowStop();
+      return 1;
+    }
+    if (followReload())
+      editorSetStatusMessage("%s was truncated or replaced, reloaded", F.path);
+    return 1;
+  }
+  if (st.st_size > F.offset)
+    return followAppend();
+  return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+// follow mode, the file is watched with inotify and whatever gets appended to
+// it is read from the last offset and added as rows, a truncated or replaced
+// file is read again from scratch
+void editorFollowStart();
+void editorFollowStop();
+int editorFollowing();
+void editorFollowSaved(long long size);
+int editorFollowTick();
+
+#endif // FOLLOW_H
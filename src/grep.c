@@ -0,0 +1,446 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "grep.h"
+#include "pool.h"
+#include "regex.h"
+#include "stream.h"
+
+#define GREP_MAX_MATCHES 100000 // the search stops there
+#define GREP_MAX_TEXT 200       // chars of the matching line in a result
+#define GREP_BINARY_PEEK 8192   // files with a 0 byte in here are skipped
+#define GREP_FLUSH (64 << 10)   // results a thread collects before handing over
+
+// results of one thread for the file it is searching
+struct grepOut {
+  char *b;
+  int len, cap;
+  int n; // matches in b
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t more = PTHREAD_COND_INITIALIZER; // a path or the end
+
+static struct {
+  // the search, shared with the threads under lock
+  struct regex *re;
+  const char *lit; // every match starts with it
+  int litlen;
+  char *dir;
+  char **paths; // listed so far, the threads take them in order
+  int npaths, pathcap, next;
+  int walking; // the tree is still being listed
+  int running; // threads not done yet
+  int cancel;
+  char *out; // results the idle loop hasn't taken yet
+  int outlen, outcap;
+  int matches, files, searched;
+
+  // main thread
+  pthread_t *threads;
+  int nthreads;
+  int active; // threads to join
+  char *pattern;
+  char *text; // every result so far, for showing them again
+  long long len, cap;
+  int shown; // the buffer is the results
+  int pick;  // result row last opened
+} G;
+
+/* search */
+
+static void grepAppend(char **b, int *len, int *cap, const char *s, int n) {
+  if (*len + n > *cap) {
+    *cap = *cap ? *cap * 2 : 4096;
+    while (*cap < *len + n)
+      *cap *= 2;
+    *b = realloc(*b, *cap);
+  }
+  memcpy(&(*b)[*len], s, n);
+  *len += n;
+}
+
+static void grepFlush(struct grepOut *o, int found) {
+  pthread_mutex_lock(&lock);
+  grepAppend(&G.out, &G.outlen, &G.outcap, o->b, o->len);
+  G.matches += o->n;
+  if (G.matches >= GREP_MAX_MATCHES)
+    G.cancel = 1;
+  G.files += found;
+  pthread_mutex_unlock(&lock);
+  o->len = 0;
+  o->n = 0;
+}
+
+static void grepEmit(struct grepOut *o, const char *path, int line, int col,
+                     const char *s, int len) {
+  char head[32];
+  if (len > GREP_MAX_TEXT)
+    len = GREP_MAX_TEXT;
+  grepAppend(&o->b, &o->len, &o->cap, path, strlen(path));
+  int hlen = snprintf(head, sizeof(head), ":%d:%d: ", line, col);
+  grepAppend(&o->b, &o->len, &o->cap, head, hlen);
+  grepAppend(&o->b, &o->len, &o->cap, s, len);
+  grepAppend(&o->b, &o->len, &o->cap, "\n", 1);
+  o->n++;
+}
+
+static int grepCountLines(const char *p, const char *end) {
+  int n = 0;
+  while ((p = memchr(p, '\n', end - p))) {
+    n++;
+    p++;
+  }
+  return n;
+}
+
+// with a literal, memmem jumps from hit to hit over the whole map and only
+// the lines it lands in are matched, otherwise every line is
+static void grepFile(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return;
+  }
+  char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return;
+
+  struct grepOut o = {NULL, 0, 0, 0};
+  int found = 0;
+  const char *end = map + st.st_size;
+  if (!memchr(map, '\0', st.st_size < GREP_BINARY_PEEK ? st.st_size
+                                                        : GREP_BINARY_PEEK)) {
+    const char *p = map, *counted = map;
+    int line = 1;
+    while (p < end) {
+      const char *ls = p;
+      if (G.litlen) {
+        const char *hit = memmem(p, end - p, G.lit, G.litlen);
+        if (!hit)
+          break;
+        ls = memrchr(p, '\n', hit - p);
+        ls = ls ? ls + 1 : p;
+      }
+      const char *le = memchr(ls, '\n', end - ls);
+      if (!le)
+        le = end;
+      int len = le - ls, at;
+      if (len && ls[len - 1] == '\r')
+        len--;
+      if (regexSearch(G.re, ls, len, 0, &at, NULL)) {
+        line += grepCountLines(counted, ls);
+        counted = ls;
+        grepEmit(&o, path, line, at + 1, ls, len);
+        found = 1;
+        if (o.len >= GREP_FLUSH)
+          grepFlush(&o, 0);
+      }
+      p = le + 1;
+    }
+  }
+  munmap(map, st.st_size);
+  grepFlush(&o, found);
+  free(o.b);
+  pthread_mutex_lock(&lock);
+  G.searched++;
+  pthread_mutex_unlock(&lock);
+}
+
+static char *grepJoin(const char *dir, const char *name) {
+  if (!strcmp(dir, "."))
+    return strdup(name);
+  int dlen = strlen(dir), nlen = strlen(name);
+  int slash = dlen && dir[dlen - 1] != '/';
+  char *path = malloc(dlen + slash + nlen + 1);
+  memcpy(path, dir, dlen);
+  if (slash)
+    path[dlen] = '/';
+  memcpy(&path[dlen + slash], name, nlen + 1);
+  return path;
+}
+
+// list the files under dir, hidden ones and symlinks are left out
+static void grepWalk(const char *dir) {
+  DIR *d = opendir(dir);
+  if (!d)
+    return;
+  struct dirent *e;
+  while ((e = readdir(d))) {
+    if (e->d_name[0] == '.')
+      continue;
+    char *path = grepJoin(dir, e->d_name);
+    int type = e->d_type;
+    if (type == DT_UNKNOWN) {
+      struct stat st;
+      type = lstat(path, &st) == -1 ? DT_UNKNOWN
+             : S_ISDIR(st.st_mode)  ? DT_DIR
+             : S_ISREG(st.st_mode)  ? DT_REG
+                                    : DT_UNKNOWN;
+    }
+    if (type == DT_DIR) {
+      grepWalk(path);
+      free(path);
+    } else if (type == DT_REG) {
+      pthread_mutex_lock(&lock);
+      if (G.npaths == G.pathcap) {
+        G.pathcap = G.pathcap ? G.pathcap * 2 : 256;
+        G.paths = realloc(G.paths, sizeof(char *) * G.pathcap);
+      }
+      G.paths[G.npaths++] = path;
+      pthread_cond_signal(&more);
+      pthread_mutex_unlock(&lock);
+    } else {
+      free(path);
+    }
+
+    pthread_mutex_lock(&lock);
+    int cancel = G.cancel;
+    pthread_mutex_unlock(&lock);
+    if (cancel)
+      break;
+  }
+  closedir(d);
+}
+
+// the first thread lists the tree before it searches too
+static void *grepWorker(void *walker) {
+  if (walker) {
+    grepWalk(G.dir);
+    pthread_mutex_lock(&lock);
+    G.walking = 0;
+    pthread_cond_broadcast(&more);
+    pthread_mutex_unlock(&lock);
+  }
+  pthread_mutex_lock(&lock);
+  while (1) {
+    while (!G.cancel && G.next == G.npaths && G.walking)
+      pthread_cond_wait(&more, &lock);
+    if (G.cancel || G.next == G.npaths)
+      break;
+    char *path = G.paths[G.next++];
+    pthread_mutex_unlock(&lock);
+    grepFile(path);
+    pthread_mutex_lock(&lock);
+  }
+  G.running--;
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+// wait for the threads of the last search and let go of it
+static void grepFinish() {
+  for (int t = 0; t < G.nthreads; t++)
+    pthread_join(G.threads[t], NULL);
+  free(G.threads);
+  G.threads = NULL;
+  G.nthreads = 0;
+  for (int j = 0; j < G.npaths; j++)
+    free(G.paths[j]);
+  free(G.paths);
+  G.paths = NULL;
+  G.npaths = G.pathcap = G.next = 0;
+  free(G.out);
+  G.out = NULL;
+  G.outlen = G.outcap = 0;
+  regexFree(G.re);
+  G.re = NULL;
+  free(G.dir);
+  G.dir = NULL;
+  G.active = 0;
+}
+
+static void grepStop() {
+  if (!G.active)
+    return;
+  pthread_mutex_lock(&lock);
+  G.cancel = 1;
+  pthread_cond_broadcast(&more);
+  pthread_mutex_unlock(&lock);
+  grepFinish();
+}
+
+/* results buffer */
+
+int editorGrepShown() { return G.shown && !E.filename; }
+
+// the buffer may only be replaced when nothing would be lost
+static int grepCanLeave() {
+  if (editorStreaming()) {
+    editorSetStatusMessage("grep: still reading the input");
+    return 0;
+  }
+  if (E.dirty && !editorGrepShown()) {
+    editorSetStatusMessage("grep: save the file first");
+    return 0;
+  }
+  return 1;
+}
+
+static void grepShow() {
+  editorCloseFile();
+  G.shown = 1;
+  editorLoadRows(G.text, G.len, 0);
+  E.cy = G.pick < E.numrows ? G.pick : 0;
+}
+
+/* interface */
+
+// :grep pattern [dir], without a pattern the last results come back
+void editorGrep(char *args) {
+  while (*args == ' ')
+    args++;
+  if (!*args) {
+    if (!G.pattern)
+      editorSetStatusMessage("grep: no search yet");
+    else if (!editorGrepShown() && grepCanLeave())
+      grepShow();
+    return;
+  }
+  char *dir = strchr(args, ' ');
+  if (dir) {
+    *dir++ = '\0';
+    while (*dir == ' ')
+      dir++;
+    char *e = dir + strlen(dir);
+    while (e > dir && e[-1] == ' ')
+      *--e = '\0';
+  }
+  if (!dir || !*dir)
+    dir = ".";
+
+  struct stat st;
+  if (stat(dir, &st) == -1 || !S_ISDIR(st.st_mode)) {
+    editorSetStatusMessage("grep: %.40s is no directory", dir);
+    return;
+  }
+  const char *err;
+  struct regex *re = regexCompile(args, &err);
+  if (!re) {
+    editorSetStatusMessage("grep: %s", err);
+    return;
+  }
+  if (!grepCanLeave()) {
+    regexFree(re);
+    return;
+  }
+
+  grepStop();
+  G.re = re;
+  G.litlen = regexLiteral(re, &G.lit);
+  G.dir = strdup(dir);
+  G.walking = 1;
+  G.cancel = 0;
+  G.matches = G.files = G.searched = 0;
+  free(G.pattern);
+  G.pattern = strdup(args);
+  G.len = 0;
+  G.pick = 0;
+  grepShow();
+
+  int n = poolThreads();
+  G.threads = malloc(sizeof(pthread_t) * n);
+  G.running = n;
+  for (int t = 0; t < n; t++) {
+    if (pthread_create(&G.threads[t], NULL, grepWorker, t ? NULL : G.dir)) {
+      pthread_mutex_lock(&lock);
+      G.running -= n - t;
+      if (t == 0)
+        G.walking = 0;
+      pthread_cond_broadcast(&more);
+      pthread_mutex_unlock(&lock);
+      break;
+    }
+    G.nthreads++;
+  }
+  G.active = 1;
+  editorSetStatusMessage("grep: searching %.40s for %.30s", dir, args);
+}
+
+// open the file of the result under the cursor at its match
+int editorGrepOpen() {
+  if (!editorGrepShown() || E.cy >= E.numrows)
+    return 0;
+  erow *row = &E.row[E.cy];
+  int line = 0, col = 0, i;
+  for (i = 0; i < row->size; i++) { // path:line:col:
+    int n;
+    if (row->chars[i] == ':' &&
+        sscanf(&row->chars[i], ":%d:%d:%n", &line, &col, &n) == 2)
+      break;
+  }
+  if (i == row->size || line < 1) {
+    editorSetStatusMessage("grep: no result on this line");
+    return 1;
+  }
+  char *path = strndup(row->chars, i);
+  if (access(path, R_OK) == -1) {
+    editorSetStatusMessage("grep: can't open %.40s", path);
+    free(path);
+    return 1;
+  }
+
+  G.pick = E.cy;
+  G.shown = 0;
+  editorCloseFile();
+  editorOpen(path);
+  free(path);
+  E.cy = line - 1 < E.numrows ? line - 1 : E.numrows;
+  int size = E.cy < E.numrows ? E.row[E.cy].size : 0;
+  E.cx = col - 1 < size ? col - 1 : size;
+  editorSetStatusMessage(":grep goes back to the results");
+  return 1;
+}
+
+// take in what the threads found, returns whether rows were added
+int editorGrepTick() {
+  if (!G.active)
+    return 0;
+  pthread_mutex_lock(&lock);
+  char *out = G.out;
+  int len = G.outlen;
+  G.out = NULL;
+  G.outlen = G.outcap = 0;
+  int running = G.running, matches = G.matches, files = G.files,
+      searched = G.searched, npaths = G.npaths;
+  pthread_mutex_unlock(&lock);
+
+  if (len) {
+    if (G.len + len > G.cap) {
+      G.cap = G.cap ? G.cap * 2 : 65536;
+      while (G.cap < G.len + len)
+        G.cap *= 2;
+      G.text = realloc(G.text, G.cap);
+    }
+    memcpy(&G.text[G.len], out, len);
+    G.len += len;
+    if (editorGrepShown())
+      editorLoadRows(out, len, 0);
+    free(out);
+  }
+  if (!running) {
+    grepFinish();
+    editorSetStatusMessage("grep: %d%s matches in %d files, %d searched",
+                           matches, matches >= GREP_MAX_MATCHES ? "+" : "",
+                           files, searched);
+    return 1;
+  }
+  if (len)
+    editorSetStatusMessage("grep: %d matches, %d of %d files searched",
+                           matches, searched, npaths);
+  return len > 0;
+}
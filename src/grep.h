@@ -0,0 +1,14 @@
+#ifndef GREP_H
+#define GREP_H
+
+// search the files under a directory
+// one thread lists the tree while all of them map the files and search them,
+// big files are scanned whole for the pattern's literal with memmem and only
+// the lines it hits go through the regex, matches show up as path:line:col
+// rows of a results buffer while the search goes on, Enter opens one
+void editorGrep(char *args);
+int editorGrepOpen();
+int editorGrepShown();
+int editorGrepTick();
+
+#endif // GREP_H
@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "journal.h"
+#include "term.h"
+
+#define JOURNAL_MAGIC "PEBJ\x01"
+#define JOURNAL_MAGIC_LEN 5
+#define JOURNAL_SYNC_MS 1000       // fdatasync at most this often
+#define JOURNAL_FLUSH_BYTES 65536 // write out once this much is buffered
+
+static struct {
+  int fd;     // -1 until the first edit
+  int armed;  // journal the edits of J.path
+  int paused; // replaying or loading, do not record
+  char *path;
+  struct stat base; // the file the edits apply to, for the header
+  int have_base;
+  unsigned char *buf; // records not yet written
+  int len;
+  int cap;
+  int unsynced; // written but not fdatasynced
+  struct timespec last_sync;
+} J = {-1, 0, 0, NULL, {0}, 0, NULL, 0, 0, 0, {0, 0}};
+
+static void journalCreate();
+
+/* encoding */
+
+static void journalPut(const void *s, int n) {
+  if (J.len + n > J.cap) {
+    while (J.len + n > J.cap)
+      J.cap = J.cap ? J.cap * 2 : 4096;
+    J.buf = realloc(J.buf, J.cap);
+  }
+  memcpy(&J.buf[J.len], s, n);
+  J.len += n;
+}
+
+// unsigned LEB128, small row and column numbers take one or two bytes
+static void journalPutNum(uint64_t v) {
+  unsigned char b[10];
+  int n = 0;
+  do {
+    b[n] = v & 0x7f;
+    v >>= 7;
+    if (v)
+      b[n] |= 0x80;
+    n++;
+  } while (v);
+  journalPut(b, n);
+}
+
+static int journalGetNum(const unsigned char **p, const unsigned char *end,
+                         uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; *p < end && shift < 64; shift += 7) {
+    unsigned char b = *(*p)++;
+    *v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return 1;
+  }
+  return 0;
+}
+
+/* writing */
+
+static long journalMsSince(struct timespec *t) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - t->tv_sec) * 1000 + (now.tv_nsec - t->tv_nsec) / 1000000;
+}
+
+static void journalWrite() {
+  int off = 0;
+  while (off < J.len) {
+    ssize_t n = write(J.fd, &J.buf[off], J.len - off);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      break; // keep going without the journal rather than dying
+    }
+    off += n;
+  }
+  J.len = 0;
+  J.unsynced = 1;
+}
+
+void editorJournalFlush() {
+  if (J.fd == -1)
+    return;
+  if (J.len)
+    journalWrite();
+  if (J.unsynced) {
+    fdatasync(J.fd);
+    J.unsynced = 0;
+    clock_gettime(CLOCK_MONOTONIC, &J.last_sync);
+  }
+}
+
+// called from the idle loop, batches the fdatasync calls
+void editorJournalTick() {
+  if (J.fd == -1 || (!J.len && !J.unsynced))
+    return;
+  if (journalMsSince(&J.last_sync) >= JOURNAL_SYNC_MS)
+    editorJournalFlush();
+}
+
+void editorJournalRecord(int op, int row, int arg, const char *s, int len) {
+  if (J.paused)
+    return;
+  if (J.fd == -1 && J.armed)
+    journalCreate();
+  if (J.fd == -1)
+    return;
+  unsigned char c = op;
+  journalPut(&c, 1);
+  journalPutNum(row);
+  switch (op) {
+  case JOURNAL_INSERT_CHAR:
+    journalPutNum(arg);
+    c = s[0];
+    journalPut(&c, 1);
+    break;
+  case JOURNAL_DEL_CHAR:
+  case JOURNAL_TRUNCATE:
+    journalPutNum(arg);
+    break;
+  case JOURNAL_INSERT_ROW:
+  case JOURNAL_APPEND:
+  case JOURNAL_SET_ROW:
+  case JOURNAL_SET_ROWS:
+    journalPutNum(len);
+    journalPut(s, len);
+    break;
+  }
+  if (J.len >= JOURNAL_FLUSH_BYTES)
+    journalWrite();
+}
+
+static char *journalPath(const char *filename) {
+  const char *slash = strrchr(filename, '/');
+  int dirlen = slash ? slash - filename + 1 : 0;
+  const char *base = slash ? slash + 1 : filename;
+  char *path = malloc(dirlen + strlen(base) + 16);
+  sprintf(path, "%.*s.%s.peb-swap", dirlen, filename, base);
+  return path;
+}
+
+static void journalHeader(struct stat *st) {
+  journalPut(JOURNAL_MAGIC, JOURNAL_MAGIC_LEN);
+  journalPutNum(getpid());
+  journalPutNum(st ? (uint64_t)st->st_size : 0);
+  journalPutNum(st ? (uint64_t)st->st_mtime : 0);
+}
+
+// nothing to recover any more, the next edit starts a new journal
+static void journalDrop() {
+  if (J.fd == -1)
+    return;
+  close(J.fd);
+  unlink(J.path);
+  J.fd = -1;
+  J.len = 0;
+  J.unsynced = 0;
+}
+
+// the file was saved or read again, the rows match it now
+void editorJournalReset() {
+  if (!E.filename)
+    return;
+  journalDrop();
+  if (!J.path || !J.armed) { // saved for the first time
+    free(J.path);
+    J.path = journalPath(E.filename);
+    J.armed = 1;
+  }
+  J.have_base = (stat(E.filename, &J.base) == 0);
+}
+
+// quitting cleanly, nothing left to recover
+void editorJournalClose() {
+  journalDrop();
+  J.armed = 0;
+}
+
+// flush what we have when the terminal goes away
+static void journalSignal(int sig) {
+  if (J.fd != -1) {
+    if (J.len)
+      write(J.fd, J.buf, J.len);
+    fdatasync(J.fd);
+  }
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+static void journalHandlers() {
+  static int handlers = 0;
+  if (!handlers) {
+    atexit(editorJournalFlush);
+    signal(SIGHUP, journalSignal);
+    signal(SIGTERM, journalSignal);
+    handlers = 1;
+  }
+}
+
+// pid of the peb that wrote the journal in fd, 0 if it has none
+static uint64_t journalOwner(int fd) {
+  unsigned char head[JOURNAL_MAGIC_LEN + 10];
+  int n = read(fd, head, sizeof(head));
+  const unsigned char *p = head + JOURNAL_MAGIC_LEN;
+  uint64_t pid;
+  if (n <= JOURNAL_MAGIC_LEN || memcmp(head, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) ||
+      !journalGetNum(&p, head + n, &pid))
+    return 0;
+  return pid;
+}
+
+// the first edit since the file was opened or saved, a journal that showed
+// up since then belongs to somebody else and is left alone
+static void journalCreate() {
+  J.fd = open(J.path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+  if (J.fd == -1) {
+    int fd = open(J.path, O_RDONLY);
+    uint64_t pid = fd != -1 ? journalOwner(fd) : 0;
+    if (fd != -1)
+      close(fd);
+    if (pid && kill(pid, 0) == 0)
+      editorSetStatusMessage("%s is being edited by pid %d, not journaling",
+                             E.filename, (int)pid);
+    else
+      editorSetStatusMessage("Can't create %s, not journaling", J.path);
+    J.armed = 0;
+    return;
+  }
+  journalHeader(J.have_base ? &J.base : NULL);
+  journalWrite();
+  editorJournalFlush();
+  journalHandlers();
+}
+
+/* recovery */
+
+// apply the records in [*pp, end), *pp is left after the last complete one
+static int journalReplay(const unsigned char **pp, const unsigned char *end) {
+  const unsigned char *p = *pp;
+  int applied = 0;
+  while (p < end) {
+    int op = *p++;
+    uint64_t row, arg = 0, len = 0;
+    const unsigned char *s = NULL;
+    if (!journalGetNum(&p, end, &row))
+      break;
+    if (op == JOURNAL_INSERT_CHAR || op == JOURNAL_DEL_CHAR ||
+        op == JOURNAL_TRUNCATE) {
+      if (!journalGetNum(&p, end, &arg))
+        break;
+    }
+    if (op == JOURNAL_INSERT_CHAR) {
+      if (p == end)
+        break;
+      s = p++;
+    }
+    if (op == JOURNAL_INSERT_ROW || op == JOURNAL_APPEND ||
+        op == JOURNAL_SET_ROW || op == JOURNAL_SET_ROWS) {
+      if (!journalGetNum(&p, end, &len) || len > (uint64_t)(end - p))
+        break; // torn record at the end
+      s = p;
+      p += len;
+    }
+
+    // rows must exist except for an insert at the end
+    if (row > (uint64_t)E.numrows ||
+        (row == (uint64_t)E.numrows && op != JOURNAL_INSERT_ROW))
+      break;
+    erow *r = (row < (uint64_t)E.numrows) ? &E.row[row] : NULL;
+    switch (op) {
+    case JOURNAL_INSERT_CHAR:
+      editorRowInsertChar(r, arg, *s);
+      break;
+    case JOURNAL_DEL_CHAR:
+      editorRowDelChar(r, arg);
+      break;
+    case JOURNAL_INSERT_ROW:
+      editorInsertRow(row, (char *)s, len);
+      break;
+    case JOURNAL_DEL_ROW:
+      editorDelRow(row);
+      break;
+    case JOURNAL_APPEND:
+      editorRowAppendString(r, (char *)s, len);
+      break;
+    case JOURNAL_TRUNCATE:
+      if (arg <= (uint64_t)r->size)
+        editorRowTruncate(r, arg);
+      break;
+    case JOURNAL_SET_ROW: {
+      char *chars = malloc(len + 1);
+      memcpy(chars, s, len);
+      chars[len] = '\0';
+      editorRowSet(r, chars, len);
+    } break;
+    case JOURNAL_SET_ROWS:
+      editorSetRows(row, (const char *)s, len);
+      break;
+    default:
+      return applied;
+    }
+    applied++;
+    *pp = p;
+  }
+  return applied;
+}
+
+// look for a journal left behind by a crash and offer to replay it, edits
+// are journaled from the first one on
+void editorJournalOpen(const char *filename) {
+  editorJournalClose();
+  free(J.path);
+  J.path = journalPath(filename);
+  J.have_base = (stat(filename, &J.base) == 0);
+  struct stat *st = J.have_base ? &J.base : NULL;
+
+  int fd = open(J.path, O_RDWR);
+  if (fd != -1) {
+    struct stat jst;
+    unsigned char *data = NULL;
+    if (fstat(fd, &jst) == 0 && jst.st_size > JOURNAL_MAGIC_LEN) {
+      data = malloc(jst.st_size);
+      if (read(fd, data, jst.st_size) != jst.st_size) {
+        free(data);
+        data = NULL;
+      }
+    }
+
+    const unsigned char *p = data, *end = data ? data + jst.st_size : NULL;
+    uint64_t pid = 0, size = 0, mtime = 0;
+    int recovered = 0;
+    if (data && !memcmp(p, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN)) {
+      p += JOURNAL_MAGIC_LEN;
+      if (journalGetNum(&p, end, &pid) && journalGetNum(&p, end, &size) &&
+          journalGetNum(&p, end, &mtime) && p < end) {
+        if (pid != (uint64_t)getpid() && kill(pid, 0) == 0) {
+          // somebody is still editing, leave their journal alone
+          editorSetStatusMessage("%s is being edited by pid %d, not journaling",
+                                 filename, (int)pid);
+          free(data);
+          close(fd);
+          return;
+        }
+        int changed = !st || (uint64_t)st->st_size != size ||
+                      (uint64_t)st->st_mtime != mtime;
+        editorSetStatusMessage("Found unsaved changes for %s%s. Recover? (y/n)",
+                               filename,
+                               changed ? " (file changed since)" : "");
+        editorRefreshScreen();
+        int c;
+        while ((c = editorReadKey()) != 'y' && c != 'n' && c != '\x1b')
+          ;
+        if (c == 'y') {
+          J.paused = 1;
+          const unsigned char *q = p;
+          int applied = journalReplay(&q, end);
+          J.paused = 0;
+          // drop a torn record so new ones can follow the good ones
+          ftruncate(fd, q - data);
+          E.dirty = applied ? 1 : E.dirty;
+          editorSetStatusMessage("Recovered %d changes, :w to keep them",
+                                 applied);
+          recovered = 1;
+        } else {
+          editorSetStatusMessage("");
+        }
+      }
+    }
+    free(data);
+    close(fd);
+    if (recovered) { // keep appending so another crash still recovers all
+      J.fd = open(J.path, O_WRONLY | O_APPEND);
+      if (J.fd != -1)
+        journalHandlers();
+    } else { // turned down or unreadable
+      unlink(J.path);
+    }
+  }
+  J.armed = 1;
+}
@@ -0,0 +1,25 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// swap journal for crash recovery
+// every change to the rows is appended to .<file>.peb-swap as a compact
+// binary record, records are buffered and fdatasynced from the idle loop
+enum journalOp {
+  JOURNAL_INSERT_CHAR = 'i',
+  JOURNAL_DEL_CHAR = 'x',
+  JOURNAL_INSERT_ROW = 'r',
+  JOURNAL_DEL_ROW = 'd',
+  JOURNAL_APPEND = 'a',
+  JOURNAL_TRUNCATE = 't',
+  JOURNAL_SET_ROW = 's',
+  JOURNAL_SET_ROWS = 'S' // lines ended by newlines over the rows from row
+};
+
+void editorJournalOpen(const char *filename);
+void editorJournalRecord(int op, int row, int arg, const char *s, int len);
+void editorJournalTick();
+void editorJournalFlush();
+void editorJournalReset();
+void editorJournalClose();
+
+#endif // JOURNAL_H
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fold.h"
+#include "layout.h"
+
+// visual lines of a row at the width of a layout
+struct layoutRow {
+  int lines;   // 0 if the row changed since they were found
+  int *breaks; // render column where each visual line after the first starts
+};
+
+struct layout {
+  int valid; // tree matches the rows, the width and wrap mode are its own
+  int wrap;  // leaves hold visual lines, otherwise 1 per row
+  int width;
+  int n;                  // rows in the tree
+  int size;               // leaves, power of two
+  int *sum;               // display lines per node, not counting its own cover
+  int *cover;             // folds hiding the whole node
+  struct layoutRow *rows; // of every leaf, wrapped layouts only
+  struct layout *next;
+};
+
+static struct layout *L;       // layout of the view in E
+static struct layout *layouts; // every window's, they all follow the rows
+
+static int layoutWidth() { return E.screencols > 0 ? E.screencols : 1; }
+
+// display lines of a node, nothing if a fold hides it
+static int layoutLines(struct layout *l, int node) {
+  return l->cover[node] ? 0 : l->sum[node];
+}
+
+static void layoutPull(struct layout *l, int node) {
+  l->sum[node] = layoutLines(l, 2 * node) + layoutLines(l, 2 * node + 1);
+}
+
+static void layoutSet(struct layout *l, int i, int lines) {
+  int node = l->size + i;
+  l->sum[node] = lines;
+  for (node /= 2; node >= 1; node /= 2)
+    layoutPull(l, node);
+}
+
+// sum the leaves [from, to) into their ancestors again
+static void layoutPullRange(struct layout *l, int from, int to) {
+  if (from >= to)
+    return;
+  int lo = (l->size + from) / 2, hi = (l->size + to - 1) / 2;
+  for (; lo >= 1; lo /= 2, hi /= 2)
+    for (int node = lo; node <= hi; node++)
+      layoutPull(l, node);
+}
+
+// the visual line breaks of a row at the width of l, found again after the
+// row changed, breaks go after the last space that fits, or hard at the width
+static struct layoutRow *layoutWrapRow(struct layout *l, erow *row) {
+  editorRowRender(row); // may find the row changed
+  struct layoutRow *r = &l->rows[row->idx];
+  if (r->lines)
+    return r;
+  int w = l->width;
+  free(r->breaks);
+  r->breaks = NULL;
+  r->lines = 1;
+
+  if (row->flags & ROW_LONG) { // long rows only have a window rendered, wrap hard
+    r->lines = row->rwidth > 0 ? (row->rwidth + w - 1) / w : 1;
+    return r;
+  }
+
+  int start = 0, cap = 0;
+  while (row->rsize - start > w) {
+    int brk = start + w;
+    for (int j = start + w; j > start; j--) {
+      if (row->render[j - 1] == ' ') {
+        brk = j;
+        break;
+      }
+    }
+    if (r->lines == cap + 1) {
+      cap = cap ? cap * 2 : 4;
+      r->breaks = realloc(r->breaks, sizeof(int) * cap);
+    }
+    r->breaks[r->lines - 1] = brk;
+    r->lines++;
+    start = brk;
+  }
+  return r;
+}
+
+// visual lines of a row in l, its leaf is put right if it was counted before
+// the row was rendered
+static struct layoutRow *layoutRow(struct layout *l, erow *row) {
+  struct layoutRow *r = layoutWrapRow(l, row);
+  if (l->sum[l->size + row->idx] != r->lines)
+    layoutSet(l, row->idx, r->lines);
+  return r;
+}
+
+static void layoutFreeRows(struct layout *l) {
+  for (int i = 0; l->rows && i < l->n; i++)
+    free(l->rows[i].breaks);
+  free(l->rows);
+  l->rows = NULL;
+}
+
+static int layoutValid() {
+  return L->valid && L->wrap == E.wrap && L->n == E.numrows &&
+         (!E.wrap || L->width == layoutWidth());
+}
+
+static void layoutCover(struct layout *l, int node, int lo, int hi, int from,
+                        int to, int delta) {
+  if (to < lo || hi < from)
+    return;
+  if (from <= lo && hi <= to) {
+    l->cover[node] += delta;
+    return;
+  }
+  int mid = (lo + hi) / 2;
+  layoutCover(l, 2 * node, lo, mid, from, to, delta);
+  layoutCover(l, 2 * node + 1, mid + 1, hi, from, to, delta);
+  layoutPull(l, node);
+}
+
+// lay the rows out again for the view in E, its width and wrap mode
+static void layoutBuild() {
+  if (layoutValid())
+    return;
+  layoutFreeRows(L);
+  L->n = E.numrows;
+  L->wrap = E.wrap;
+  L->width = layoutWidth();
+  L->size = 1;
+  while (L->size < L->n)
+    L->size *= 2;
+  free(L->sum);
+  free(L->cover);
+  L->sum = calloc(2 * L->size, sizeof(int));
+  L->cover = calloc(2 * L->size, sizeof(int));
+  if (L->wrap)
+    L->rows = calloc(L->size, sizeof(struct layoutRow));
+  for (int i = 0; i < L->n; i++)
+    L->sum[L->size + i] = L->wrap ? layoutWrapRow(L, &E.row[i])->lines : 1;
+  for (int node = L->size - 1; node >= 1; node--)
+    layoutPull(L, node);
+  L->valid = 1;
+  int from, to;
+  for (int j = 0; editorFoldRange(j, &from, &to); j++)
+    layoutCover(L, 1, 0, L->size - 1, from, to, 1);
+}
+
+/* layouts */
+
+// a layout for a window of its own, laid out when it is first used
+struct layout *editorLayoutNew() {
+  struct layout *l = calloc(1, sizeof(struct layout));
+  l->next = layouts;
+  layouts = l;
+  return l;
+}
+
+void editorLayoutFree(struct layout *l) {
+  struct layout **p = &layouts;
+  while (*p != l)
+    p = &(*p)->next;
+  *p = l->next;
+  if (L == l)
+    L = NULL;
+  layoutFreeRows(l);
+  free(l->sum);
+  free(l->cover);
+  free(l);
+}
+
+// the view in E is now the one of a window with layout l
+void editorLayoutUse(struct layout *l) { L = l; }
+
+/* rows */
+
+int editorLayoutRowLines(erow *row) {
+  layoutBuild();
+  if (!L->wrap || row->idx >= L->n)
+    return 1;
+  return layoutRow(L, row)->lines;
+}
+
+// render column where visual line sub of row starts
+int editorLayoutLineStart(erow *row, int sub) {
+  int lines = editorLayoutRowLines(row);
+  if (sub <= 0 || lines == 1)
+    return 0;
+  if (row->flags & ROW_LONG)
+    return sub * L->width;
+  if (sub >= lines)
+    sub = lines - 1;
+  return L->rows[row->idx].breaks[sub - 1];
+}
+
+// visual line of row holding render column rx
+int editorLayoutSubOfRx(erow *row, int rx) {
+  int lines = editorLayoutRowLines(row);
+  if (lines == 1)
+    return 0;
+  if (row->flags & ROW_LONG) {
+    int sub = rx / L->width;
+    return sub < lines ? sub : lines - 1;
+  }
+  int *breaks = L->rows[row->idx].breaks, sub = 0;
+  while (sub + 1 < lines && breaks[sub] <= rx)
+    sub++;
+  return sub;
+}
+
+// the rows were replaced, every layout is built again when it is next used
+void editorLayoutInvalidate() {
+  for (struct layout *l = layouts; l; l = l->next)
+    l->valid = 0;
+}
+
+// every layout of the row lays it out again for its own width
+void editorLayoutRowChanged(erow *row) {
+  for (struct layout *l = layouts; l; l = l->next) {
+    if (l->valid && l->wrap && row->idx < l->n) {
+      l->rows[row->idx].lines = 0;
+      layoutRow(l, row);
+    }
+  }
+}
+
+// n rows were inserted at at, the leaves after them move up like the rows,
+// O(n - at), the new ones count one line until they are rendered
+// no fold may cover the moving rows, see editorFoldRowsInserted
+void editorLayoutRowsInserted(int at, int n) {
+  for (struct layout *l = layouts; l; l = l->next) {
+    if (!l->valid || at > l->n)
+      continue;
+    if (l->n + n > l->size) { // the tree doubles like the rows
+      l->valid = 0;
+      continue;
+    }
+    int *leaf = &l->sum[l->size];
+    memmove(&leaf[at + n], &leaf[at], sizeof(int) * (l->n - at));
+    for (int i = at; i < at + n; i++)
+      leaf[i] = 1;
+    if (l->rows) {
+      memmove(&l->rows[at + n], &l->rows[at],
+              sizeof(struct layoutRow) * (l->n - at));
+      memset(&l->rows[at], 0, sizeof(struct layoutRow) * n);
+    }
+    l->n += n;
+    layoutPullRange(l, at, l->n);
+  }
+}
+
+// the rows [at, at + n) went away, the leaves after them move down
+void editorLayoutRowsDeleted(int at, int n) {
+  for (struct layout *l = layouts; l; l = l->next) {
+    if (!l->valid || at >= l->n)
+      continue;
+    int del = n < l->n - at ? n : l->n - at;
+    int *leaf = &l->sum[l->size];
+    memmove(&leaf[at], &leaf[at + del], sizeof(int) * (l->n - at - del));
+    memset(&leaf[l->n - del], 0, sizeof(int) * del);
+    if (l->rows) {
+      for (int i = at; i < at + del; i++)
+        free(l->rows[i].breaks);
+      memmove(&l->rows[at], &l->rows[at + del],
+              sizeof(struct layoutRow) * (l->n - at - del));
+      memset(&l->rows[l->n - del], 0, sizeof(struct layoutRow) * del);
+    }
+    layoutPullRange(l, at, l->n);
+    l->n -= del;
+  }
+}
+
+// hide (delta 1) or show again (delta -1) the rows [from, to] in every
+// layout, O(log n) each, a stale one picks up every fold when it is rebuilt
+// instead, rows being inserted or deleted may not be in E.numrows yet
+void editorLayoutCover(int from, int to, int delta) {
+  for (struct layout *l = layouts; l; l = l->next)
+    if (l->valid && from <= to && to < l->n)
+      layoutCover(l, 1, 0, l->size - 1, from, to, delta);
+}
+
+/* display lines */
+
+int editorLayoutHidden(int row) {
+  if (!editorFolds() || row < 0 || row >= E.numrows)
+    return 0;
+  layoutBuild();
+  for (int node = L->size + row; node >= 1; node /= 2)
+    if (L->cover[node])
+      return 1;
+  return 0;
+}
+
+int editorLayoutLines() {
+  layoutBuild();
+  return layoutLines(L, 1);
+}
+
+// first display line of row, the line after the fold for a hidden row
+int editorLayoutLineOfRow(int row) {
+  layoutBuild();
+  if (row >= L->n)
+    return layoutLines(L, 1) + (row - L->n);
+  int line = 0;
+  for (int node = L->size + row; node > 1; node /= 2)
+    if (node & 1)
+      line += layoutLines(L, node - 1);
+  return line;
+}
+
+// row holding display line, sub gets the visual line within it
+int editorLayoutRowOfLine(int line, int *sub) {
+  layoutBuild();
+  if (line < 0)
+    line = 0;
+  if (line >= layoutLines(L, 1)) {
+    *sub = 0;
+    return L->n + (line - layoutLines(L, 1));
+  }
+  int node = 1;
+  while (node < L->size) {
+    if (line < layoutLines(L, 2 * node)) {
+      node = 2 * node;
+    } else {
+      line -= layoutLines(L, 2 * node);
+      node = 2 * node + 1;
+    }
+  }
+  *sub = line;
+  return node - L->size;
+}
+
+// next row that isn't folded away
+int editorLayoutNextRow(int row) {
+  if (!editorFolds() || row + 1 >= E.numrows)
+    return row + 1;
+  int sub;
+  return editorLayoutRowOfLine(editorLayoutLineOfRow(row + 1), &sub);
+}
+
+// previous row that isn't folded away, row itself if there is none
+int editorLayoutPrevRow(int row) {
+  if (!editorFolds() || row > E.numrows)
+    return row > 0 ? row - 1 : row;
+  int line = editorLayoutLineOfRow(row);
+  if (line == 0)
+    return row;
+  int sub;
+  return editorLayoutRowOfLine(line - 1, &sub);
+}
+
+static int layoutCursorLine() {
+  if (E.cy >= E.numrows)
+    return editorLayoutLineOfRow(E.cy);
+  return editorLayoutLineOfRow(E.cy) + editorLayoutSubOfRx(&E.row[E.cy], E.rx);
+}
+
+static int layoutTopLine() {
+  if (E.rowoff >= E.numrows)
+    return editorLayoutLineOfRow(E.rowoff);
+  int lines = editorLayoutRowLines(&E.row[E.rowoff]);
+  int sub = E.wrapoff < lines ? E.wrapoff : lines - 1;
+  return editorLayoutLineOfRow(E.rowoff) + sub;
+}
+
+// keep the cursor line on screen, scrolling by display lines
+void editorLayoutScroll() {
+  int cur = layoutCursorLine();
+  int top = layoutTopLine();
+  if (cur < top)
+    top = cur;
+  if (cur >= top + E.screenrows)
+    top = cur - E.screenrows + 1;
+  E.rowoff = editorLayoutRowOfLine(top, &E.wrapoff);
+  E.coloff = 0;
+}
+
+// scroll so the cursor line is screen line y
+void editorLayoutAnchor(int y) {
+  int top = layoutCursorLine() - y;
+  E.rowoff = editorLayoutRowOfLine(top < 0 ? 0 : top, &E.wrapoff);
+}
+
+// screen position of the cursor, 0 based
+void editorLayoutCursor(int *y, int *x) {
+  *y = layoutCursorLine() - layoutTopLine();
+  *x = 0;
+  if (E.cy < E.numrows) {
+    erow *row = &E.row[E.cy];
+    *x = E.rx - editorLayoutLineStart(row, editorLayoutSubOfRx(row, E.rx));
+  }
+  if (*x >= layoutWidth())
+    *x = layoutWidth() - 1;
+}
+
+// scroll a screen of display lines up (dir < 0) or down and put the cursor
+// on the top row
+void editorLayoutPage(int dir) {
+  int top = layoutTopLine() + dir * E.screenrows;
+  int last = editorLayoutLines() - 1;
+  if (top > last)
+    top = last;
+  if (top < 0)
+    top = 0;
+  E.rowoff = editorLayoutRowOfLine(top, &E.wrapoff);
+  E.cy = E.rowoff;
+  if (E.cy < E.numrows) {
+    erow *row = &E.row[E.cy];
+    E.cx = editorRowRxToCx(row, editorLayoutLineStart(row, E.wrapoff));
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "editor.h"
+
+// soft wrap layout, maps file rows to display lines
+// every window has a layout of its own, for its width and wrap mode, that
+// keeps the visual line breaks of every row and a segment tree over the rows
+// summing their visual lines, so mapping between rows and display lines is
+// O(log n) and windows of different widths don't lay out each other's rows
+// folds add a cover count to the O(log n) nodes spanning their rows, a
+// covered node counts no lines, without wrap every row is one line
+// inserted and deleted rows move the leaves after them, O(n - at), changed
+// rows are wrapped again for every layout
+struct layout;
+
+struct layout *editorLayoutNew();
+void editorLayoutFree(struct layout *l);
+void editorLayoutUse(struct layout *l);
+void editorLayoutInvalidate();
+void editorLayoutRowsInserted(int at, int n);
+void editorLayoutRowsDeleted(int at, int n);
+void editorLayoutCover(int from, int to, int delta);
+int editorLayoutHidden(int row);
+int editorLayoutNextRow(int row);
+int editorLayoutPrevRow(int row);
+void editorLayoutRowChanged(erow *row);
+
+int editorLayoutRowLines(erow *row);
+int editorLayoutLineStart(erow *row, int sub);
+int editorLayoutSubOfRx(erow *row, int rx);
+
+int editorLayoutLines();
+int editorLayoutLineOfRow(int row);
+int editorLayoutRowOfLine(int line, int *sub);
+
+void editorLayoutScroll();
+void editorLayoutAnchor(int y);
+void editorLayoutCursor(int *y, int *x);
+void editorLayoutPage(int dir);
+
+#endif // LAYOUT_H
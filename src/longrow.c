@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "term.h"
+#include "utility.h"
+
+// chars before an edit the highlighter may have looked at while deciding
+// the state at a checkpoint, keywords and comment delimiters are shorter
+#define LONG_ROW_LOOKAHEAD 64
+
+static int longRowTabWidth(int rx) { return PEB_TAB_STOP - (rx % PEB_TAB_STOP); }
+
+// advance rx and tabs over chars[from..to)
+static void longRowColumns(erow *row, int from, int to, int *rx, int *tabs) {
+  while (from < to) {
+    char *tab = memchr(&row->chars[from], '\t', to - from);
+    int stop = tab ? tab - row->chars : to;
+    *rx += stop - from;
+    from = stop;
+    if (tab) {
+      *rx += longRowTabWidth(*rx);
+      (*tabs)++;
+      from++;
+    }
+  }
+}
+
+static int longRowStateEqual(struct hlState *a, struct hlState *b) {
+  return a->in_string == b->in_string && a->in_comment == b->in_comment &&
+         a->line_comment == b->line_comment && a->prev_sep == b->prev_sep &&
+         a->prev_hl == b->prev_hl;
+}
+
+// last checkpoint at or before cx (by_rx == 0) or rx (by_rx == 1)
+static int longRowFindCheckpoint(erow *row, int pos, int by_rx) {
+  int lo = 0, hi = row->u.lr.ncps - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    int at = by_rx ? row->u.lr.cps[mid].rx : row->u.lr.cps[mid].cx;
+    if (at <= pos)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+void editorLongRowFree(erow *row) {
+  if (!(row->flags & ROW_LONG))
+    return;
+  free(row->u.lr.cps);
+  row->u.lr.cps = NULL;
+  row->u.lr.ncps = 0;
+  row->flags &= ~ROW_LONG;
+}
+
+// bring the checkpoints up to date after an edit
+// checkpoints before the edit are kept, the ones after it are shifted and
+// rescanning stops at the first one whose state and tab alignment came out
+// the same, so a keystroke only rescans about one chunk of the row
+void editorLongRowUpdate(erow *row) {
+  struct hlState start;
+  editorHlStart(row, &start);
+
+  if (!(row->flags & ROW_LONG)) { // just got long, drop the full render
+    editorRowFreeRender(row);
+    row->u.lr.cps = NULL;
+    row->u.lr.ncps = 0;
+    row->edit_at = 0;
+    row->edit_len = 0;
+  } else if (!longRowStateEqual(&start, &row->u.lr.cps[0].st)) {
+    // the row above opened or closed a comment
+    row->edit_at = 0;
+    row->edit_len = 0;
+  } else if (row->edit_at == INT_MAX) {
+    return;
+  }
+  if (row->edit_len && row->u.lr.cps_size + row->edit_len != row->size)
+    row->edit_len = 0;
+
+  struct hlCheckpoint *old = row->u.lr.cps;
+  int nold = row->u.lr.ncps;
+  int delta = row->edit_len;
+
+  int nkeep = 0;
+  while (nkeep < nold - 1 && old[nkeep].cx <= row->edit_at - LONG_ROW_LOOKAHEAD)
+    nkeep++;
+
+  // old checkpoints past the edited text can be reused once shifted
+  int oi = nold;
+  if (delta) {
+    int unchanged = row->edit_at + (delta < 0 ? -delta : 0);
+    for (oi = nkeep; oi < nold && old[oi].cx < unchanged; oi++)
+      ;
+  }
+  int old_tabs = nold ? old[nold - 1].tabs : 0;
+
+  int cap = nkeep + row->size / LONG_ROW_CHUNK + (nold - oi) + 2;
+  struct hlCheckpoint *cps = malloc(sizeof(struct hlCheckpoint) * cap);
+  int n = nkeep;
+  if (nkeep)
+    memcpy(cps, old, sizeof(struct hlCheckpoint) * nkeep);
+  else {
+    cps[0].cx = 0;
+    cps[0].rx = 0;
+    cps[0].tabs = 0;
+    cps[0].st = start;
+    n = 1;
+  }
+  struct hlCheckpoint cur = cps[n - 1];
+
+  while (1) {
+    while (oi < nold && old[oi].cx + delta < cur.cx)
+      oi++;
+    if (oi < nold && old[oi].cx + delta == cur.cx &&
+        longRowStateEqual(&old[oi].st, &cur.st)) {
+      // same state from here on, the columns only shift if no tab gets
+      // realigned
+      int rdelta = cur.rx - old[oi].rx;
+      int tdelta = cur.tabs - old[oi].tabs;
+      if (rdelta % PEB_TAB_STOP == 0 || old[oi].tabs == old_tabs) {
+        if (n + nold - oi > cap) {
+          cap = n + nold - oi;
+          cps = realloc(cps, sizeof(struct hlCheckpoint) * cap);
+        }
+        for (oi++; oi < nold; oi++) {
+          cps[n] = old[oi];
+          cps[n].cx += delta;
+          cps[n].rx += rdelta;
+          cps[n].tabs += tdelta;
+          n++;
+        }
+        break;
+      }
+    }
+    if (cur.cx >= row->size)
+      break;
+
+    int target = cur.cx + LONG_ROW_CHUNK;
+    if (oi < nold && old[oi].cx + delta > cur.cx && old[oi].cx + delta < target)
+      target = old[oi].cx + delta;
+    if (target > row->size)
+      target = row->size;
+
+    int i = editorHighlightSpan(&cur.st, row->chars, row->size, cur.cx, target,
+                                NULL, 0, 0);
+    if (i > row->size)
+      i = row->size;
+    longRowColumns(row, cur.cx, i, &cur.rx, &cur.tabs);
+    cur.cx = i;
+    if (n == cap) {
+      cap *= 2;
+      cps = realloc(cps, sizeof(struct hlCheckpoint) * cap);
+    }
+    cps[n++] = cur;
+  }
+
+  free(old);
+  row->u.lr.cps = cps;
+  row->u.lr.ncps = n;
+  row->u.lr.cps_size = row->size;
+  row->flags |= ROW_LONG;
+  row->rwidth = cps[n - 1].rx;
+  row->edit_at = INT_MAX;
+  row->edit_len = 0;
+
+  // the render window is stale now
+  row->roff = 0;
+  row->rsize = 0;
+}
+
+// render and highlight the columns [col, col + width) plus a margin
+void editorLongRowWindow(erow *row, int col, int width) {
+  if (!(row->flags & ROW_LONG))
+    return;
+  int end = col + width;
+  if (end > row->rwidth)
+    end = row->rwidth;
+  if (row->render && col >= row->roff && end <= row->roff + row->rsize)
+    return;
+
+  int wstart = col - LONG_ROW_MARGIN;
+  if (wstart < 0)
+    wstart = 0;
+  int wend = col + width + LONG_ROW_MARGIN;
+  if (wend > row->rwidth)
+    wend = row->rwidth;
+
+  struct hlCheckpoint *cp =
+      &row->u.lr.cps[longRowFindCheckpoint(row, wstart, 1)];
+  int cx = cp->cx, rx = cp->rx;
+  while (cx < row->size) { // first char reaching into the window
+    int w = (row->chars[cx] == '\t') ? longRowTabWidth(rx) : 1;
+    if (rx + w > wstart)
+      break;
+    rx += w;
+    cx++;
+  }
+  int wcx = cx, roff = rx;
+  while (cx < row->size && rx < wend) {
+    rx += (row->chars[cx] == '\t') ? longRowTabWidth(rx) : 1;
+    cx++;
+  }
+
+  // highlight per char from the checkpoint, then expand tabs
+  unsigned char *chl = malloc(cx - wcx + 1);
+  memset(chl, HL_NORMAL, cx - wcx);
+  struct hlState st = cp->st;
+  editorHighlightSpan(&st, row->chars, row->size, cp->cx, cx, chl, wcx,
+                      cx - wcx);
+
+  row->render = realloc(row->render, rx - roff + 1);
+  unsigned char *hl = malloc(rx - roff + 1);
+  int idx = 0;
+  for (int j = wcx; j < cx; j++) {
+    if (row->chars[j] == '\t') {
+      int w = longRowTabWidth(roff + idx);
+      memset(&row->render[idx], ' ', w);
+      memset(&hl[idx], chl[j - wcx], w);
+      idx += w;
+    } else {
+      row->render[idx] = row->chars[j];
+      hl[idx++] = chl[j - wcx];
+    }
+  }
+  row->render[idx] = '\0';
+  row->rsize = idx;
+  row->roff = roff;
+  editorRowSetHl(row, hl, idx);
+  free(hl);
+  free(chl);
+}
+
+int editorLongRowCxToRx(erow *row, int cx) {
+  struct hlCheckpoint *cp =
+      &row->u.lr.cps[longRowFindCheckpoint(row, cx, 0)];
+  int rx = cp->rx, tabs = cp->tabs;
+  if (cx > row->size)
+    cx = row->size;
+  longRowColumns(row, cp->cx, cx, &rx, &tabs);
+  return rx;
+}
+
+int editorLongRowRxToCx(erow *row, int rx) {
+  struct hlCheckpoint *cp =
+      &row->u.lr.cps[longRowFindCheckpoint(row, rx, 1)];
+  int cur_rx = cp->rx;
+  int cx;
+  for (cx = cp->cx; cx < row->size; cx++) {
+    cur_rx += (row->chars[cx] == '\t') ? longRowTabWidth(cur_rx) : 1;
+    if (cur_rx > rx)
+      return cx;
+  }
+  return cx;
+}
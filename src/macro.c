@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "macro.h"
+#include "term.h"
+
+#define MACRO_REGS 26 // a to z
+#define MACRO_DEPTH 8 // macros playing macros, deeper is taken as a loop
+
+struct macro {
+  int *keys;
+  int len, cap;
+};
+
+static struct {
+  struct macro reg[MACRO_REGS];
+  int recording; // register keys go into, -1 if none
+  int last;      // register played last, for @@
+  int depth;     // replays running, each called from the keys of the one before
+  const struct macro *play; // keys of the innermost replay
+  int pos;
+} M = {{{NULL, 0, 0}}, -1, -1, 0, NULL, 0};
+
+/* recording */
+
+// next key for editorProcessKeypress and the prompts, from the replay if one
+// is running, a replay running out inside a prompt cancels it
+int editorMacroKey() {
+  if (M.depth)
+    return M.pos < M.play->len ? M.play->keys[M.pos++] : '\x1b';
+  int c = editorReadKey();
+  if (M.recording != -1) {
+    struct macro *m = &M.reg[M.recording];
+    if (m->len == m->cap) {
+      m->cap = m->cap ? m->cap * 2 : 64;
+      m->keys = realloc(m->keys, sizeof(int) * m->cap);
+    }
+    m->keys[m->len++] = c;
+  }
+  return c;
+}
+
+int editorMacroReplaying() { return M.depth > 0; }
+
+// register being recorded into, 0 if none
+int editorMacroRecording() { return M.recording != -1 ? 'a' + M.recording : 0; }
+
+// q in normal mode, stops recording or starts it in the register typed next
+void editorMacroRecord() {
+  if (M.depth) // replays don't record
+    return;
+  if (M.recording != -1) {
+    struct macro *m = &M.reg[M.recording];
+    m->len--; // the q that stopped it
+    editorSetStatusMessage("Recorded %d keys into @%c", m->len,
+                           'a' + M.recording);
+    M.recording = -1;
+    return;
+  }
+  int c = editorMacroKey();
+  if (c == '\x1b')
+    return;
+  if (c < 'a' || c > 'z') {
+    editorSetStatusMessage("Registers are a to z");
+    return;
+  }
+  M.recording = c - 'a';
+  M.reg[M.recording].len = 0;
+}
+
+/* replay */
+
+// the keys of register reg, @ for the one played last, NULL if there is
+// nothing to play
+static const struct macro *macroBegin(int reg) {
+  if (reg == '@' && M.last != -1)
+    reg = 'a' + M.last;
+  if (reg < 'a' || reg > 'z') {
+    editorSetStatusMessage("No register to play");
+    return NULL;
+  }
+  if (M.reg[reg - 'a'].len == 0) {
+    editorSetStatusMessage("Register @%c is empty", reg);
+    return NULL;
+  }
+  if (M.depth == MACRO_DEPTH) {
+    editorSetStatusMessage("Macros nest too deep");
+    return NULL;
+  }
+  M.last = reg - 'a';
+  M.depth++;
+  return &M.reg[reg - 'a'];
+}
+
+// the outermost replay renders what all of them changed
+static void macroEnd() {
+  if (--M.depth == 0)
+    editorRowsRenderDeferred();
+}
+
+// run the keys of m once, whether that changed the buffer or moved the cursor
+static int macroPass(const struct macro *m) {
+  const struct macro *play = M.play; // of the replay that called this one
+  int pos = M.pos;
+  int dirty = E.dirty, cx = E.cx, cy = E.cy;
+  M.play = m;
+  M.pos = 0;
+  while (M.pos < m->len)
+    editorProcessKeypress();
+  M.play = play;
+  M.pos = pos;
+  return E.dirty != dirty || E.cx != cx || E.cy != cy;
+}
+
+// play register reg times times, stopping early once a pass does nothing,
+// like j on the last line
+void editorMacroPlay(int reg, int times) {
+  const struct macro *m = macroBegin(reg);
+  if (!m)
+    return;
+  int n = 0;
+  while (n < times && macroPass(m))
+    n++;
+  macroEnd();
+  if (!M.depth && times > 1)
+    editorSetStatusMessage("Played @%c %d times", 'a' + M.last, n);
+}
+
+// play register reg once on each of the rows [first, last], starting in
+// normal mode at the start of the row, rows a pass adds or removes move the
+// rest of the range along
+void editorMacroPlayRows(int reg, int first, int last) {
+  const struct macro *m = macroBegin(reg);
+  if (!m)
+    return;
+  if (last >= E.numrows) // so rows a pass adds can move it along
+    last = E.numrows - 1;
+  int n = 0;
+  for (int row = first; row <= last && row < E.numrows; row++, n++) {
+    int numrows = E.numrows;
+    E.cy = row;
+    E.cx = 0;
+    E.mode = NORMAL;
+    macroPass(m);
+    row += E.numrows - numrows;
+    last += E.numrows - numrows;
+  }
+  macroEnd();
+  if (!M.depth)
+    editorSetStatusMessage("Played @%c on %d lines", 'a' + M.last, n);
+}
+
+// :@a, :@a count, :%@a and :first,last@a, 0 if query is another command
+int editorMacroCommand(const char *query) {
+  const char *p = query;
+  char *end;
+  int first = -1, last = -1;
+  if (*p == '%') {
+    first = 0;
+    last = INT_MAX;
+    p++;
+  } else if (isdigit((unsigned char)*p)) {
+    first = last = strtol(p, &end, 10) - 1;
+    p = end;
+    if (*p == ',') {
+      if (!isdigit((unsigned char)p[1]))
+        return 0;
+      last = strtol(p + 1, &end, 10) - 1;
+      p = end;
+    }
+  }
+  if (p[0] != '@' || !p[1])
+    return 0;
+  int reg = p[1];
+  p += 2;
+  while (*p == ' ')
+    p++;
+  int times = 1;
+  if (isdigit((unsigned char)*p) && first == -1) {
+    times = strtol(p, &end, 10);
+    p = end;
+  }
+  if (*p)
+    return 0;
+
+  if (first == -1) {
+    editorMacroPlay(reg, times);
+    return 1;
+  }
+  if (first > last) {
+    int t = first;
+    first = last;
+    last = t;
+  }
+  editorMacroPlayRows(reg, first < 0 ? 0 : first, last);
+  return 1;
+}
@@ -0,0 +1,17 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+// keyboard macros, q<a-z> records the keys typed into a register until the
+// next q in normal mode, @<a-z> plays it back and @@ plays the last one again
+// a replay feeds the keys to editorProcessKeypress without drawing, rows it
+// changes are rendered and highlighted once when it is over, so replaying
+// thousands of times costs about as much as the edits themselves
+int editorMacroKey();
+int editorMacroReplaying();
+int editorMacroRecording();
+void editorMacroRecord();
+void editorMacroPlay(int reg, int times);
+void editorMacroPlayRows(int reg, int first, int last);
+int editorMacroCommand(const char *query);
+
+#endif // MACRO_H
@@ -5,87 +5,65 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
 
 // own header  files
+#include "cache.h"
+#include "codec.h"
+#include "complete.h"
+#include "diff.h"
+#include "editor.h"
 #include "error.h"
+#include "fold.h"
+#include "follow.h"
+#include "grep.h"
+#include "journal.h"
+#include "layout.h"
+#include "macro.h"
+#include "outline.h"
+#include "output.h"
+#include "pool.h"
+#include "preview.h"
+#include "regex.h"
+#include "spell.h"
+#include "stats.h"
+#include "stream.h"
+#include "table.h"
 #include "term.h"
 #include "utility.h"
+#include "window.h"
+#include "yank.h"
 
 /* defines */
 /* data */
-struct editorSyntax {
-  char *filetype;
-  char **filematch;
-  char **keywords;
-  char *singleline_comment_start;
-  char *multiline_comment_start;
-  char *multiline_comment_end;
-  int flags;
-};
-
-typedef struct erow {
-  int idx;
-  int size;
-  int rsize;
-  char *chars;
-  char *render;
-  unsigned char *hl;
-  int hl_open_comment;
-} erow;
-
-struct editorConfig {
-  int mode;
-  int cx, cy; // cursor x,y
-  int rx;     // render x
-  int rowoff;
-  int coloff;
-  int screenrows;
-  int screencols;
-  int numrows;
-  erow *row;
-  int dirty; // flag for unsaved changes
-  char *filename;
-  char statusmsg[80];
-  time_t statusmsg_time;
-  struct editorSyntax *syntax;
-  struct termios orig_termios;
-};
-
 struct editorConfig E;
 
-/* filetypes */
-char *C_HL_EXTENSIONS[] = {".c", ".h", ".cpp", NULL}; // c highlight extension
-char *C_HL_KEYWORDS[] = {
-    "switch",  "if",    "while",   "for",      "break",   "continue",
-    "return",  "else",  "struct",  "union",    "typedef", "static",
-    "enum",    "class", "case",
-
-    "int|",    "long|", "double|", "float|",   "char|",   "unsigned|",
-    "signed|", "void|", "#define", "#include", NULL};
-
-// HLDB = highlight database
-struct editorSyntax HLDB[] = {
-    {"c", C_HL_EXTENSIONS, C_HL_KEYWORDS, "//", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS},
-};
-
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
-
 /* prototypes */
 void editorSetStatusMessage(const char *fmt, ...);
 void editorRefreshScreen();
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
 void editorMoveCursor(int key);
+void editorScroll();
+void editorUpdateRow(erow *row);
 void editorSave();
+void editorSaveTo(char *filename);
+void editorReplace(char *cmd, int first, int nrows);
+void editorHlBench();
+void editorMemReport();
 
 /* terminal */
 void disableRawMode() {
@@ -117,19 +95,109 @@ void enableRawMode() {
 }
 
 /* editor command */
+// clean up before exiting
+void editorQuit() {
+  editorOutputFlush(); // the last frame before the screen is cleared
+  editorJournalClose();
+  if (E.filename)
+    editorCacheSession(E.filename);
+}
+
+
 void editorCommandCallback(char *query, int key) {
   if (key == '\r') {
+    if (!strcmp(query, "wrap") || !strcmp(query, "nowrap")) {
+      E.wrap = (query[0] == 'w');
+      E.wrapoff = 0;
+      E.coloff = 0;
+      return;
+    }
+    if (!strcmp(query, "split") || !strcmp(query, "vsplit")) {
+      editorWindowSplit(query[0] == 'v');
+      return;
+    }
+    if (!strcmp(query, "close")) {
+      if (!editorWindowClose())
+        editorSetStatusMessage("Can't close the last window");
+      return;
+    }
+    if (!strcmp(query, "unfold")) {
+      editorFoldOpenAll();
+      return;
+    }
+    if (!strcmp(query, "outline")) {
+      editorOutline();
+      return;
+    }
+    if (!strcmp(query, "table")) {
+      editorTableAlign();
+      return;
+    }
+    if (!strcmp(query, "diff") || !strcmp(query, "nodiff")) {
+      if (query[0] == 'd')
+        editorDiffStart();
+      else
+        editorDiffStop();
+      return;
+    }
+    if (!strcmp(query, "preview") || !strcmp(query, "nopreview")) {
+      if (query[0] == 'p')
+        editorPreviewStart();
+      else
+        editorPreviewStop();
+      return;
+    }
+    if (!strncmp(query, "grep", 4) && (query[4] == ' ' || !query[4])) {
+      editorGrep(&query[4]);
+      return;
+    }
+    if (!strcmp(query, "mem")) {
+      editorMemReport();
+      return;
+    }
+    if (!strcmp(query, "hlbench")) {
+      editorHlBench();
+      return;
+    }
+    if (!strcmp(query, "spell") || !strcmp(query, "nospell")) {
+      if (query[0] == 's')
+        editorSpellStart(0);
+      else
+        editorSpellStop();
+      return;
+    }
+    if (!strcmp(query, "follow")) {
+      editorFollowStart();
+      return;
+    }
+    if (!strcmp(query, "nofollow")) {
+      editorFollowStop();
+      return;
+    }
+    if (editorMacroCommand(query))
+      return;
+
     switch (query[0]) {
     case 'w': { // save actions
-      editorSave();
-      if (query[1] == 'q') {
+      char *name = strchr(query, ' ');
+      while (name && *name == ' ')
+        name++;
+      if (name && *name)
+        editorSaveTo(name);
+      else
+        editorSave();
+      if (query[1] == 'q' && !E.dirty) {
+        editorQuit();
         write(STDOUT_FILENO, "\x1b[2J", 4); // clear screen
         write(STDOUT_FILENO, "\x1b[H", 3);  // reset curser
         exit(0);
       }
     } break;
     case 'q': { // quit actions
+      if (editorWindowClose()) // the buffer stays open in the others
+        break;
       if (!E.dirty || query[1] == '!') {
+        editorQuit();
         write(STDOUT_FILENO, "\x1b[2J", 4); // clear screen
         write(STDOUT_FILENO, "\x1b[H", 3);  // reset curser
         exit(0);
@@ -137,6 +205,16 @@ void editorCommandCallback(char *query, int key) {
         editorSetStatusMessage("File has unsaved changes. Use :q! to ignore.");
       }
     } break;
+    case '%': // substitute in the whole buffer
+      if (query[1] == 's') {
+        editorReplace(&query[2], 0, E.numrows);
+        break;
+      }
+      editorSetStatusMessage("Unknown command!");
+      break;
+    case 's': // substitute in the current line
+      editorReplace(&query[1], E.cy, 1);
+      break;
     default:
       editorSetStatusMessage("Unknown command!");
       break;
@@ -152,13 +230,30 @@ void editorCommandPrompt() {
 
 /* syntax highlighting */
 
-void editorUpdateSyntax(erow *row) {
-  row->hl = realloc(row->hl, row->rsize); // realloc size for the hl buf
-  memset(row->hl, HL_NORMAL, row->size);  // setting the mem for the hl buf
-
-  if (E.syntax == NULL) // if no syntax return
+// write v to the hl of chars [i, i + n), clamped to the window [base, base + cap)
+static void editorHlFill(unsigned char *hl, int base, int cap, int i, int v,
+                         int n) {
+  if (!hl)
     return;
+  int lo = (i < base) ? base : i;
+  int hi = (i + n > base + cap) ? base + cap : i + n;
+  if (hi > lo)
+    memset(&hl[lo - base], v, hi - lo);
+}
+
+// state at the start of a row
+void editorHlStart(erow *row, struct hlState *st) {
+  st->in_string = 0;
+  st->in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+  st->line_comment = 0;
+  st->prev_sep = 1;
+  st->prev_hl = HL_NORMAL;
+}
 
+// the table driven highlighter, works off the strings of E.syntax
+static int editorHighlightInterpreted(struct hlState *st, const char *s,
+                                      int len, int i, int to,
+                                      unsigned char *hl, int base, int cap) {
   // make local references to the syntax stuff
   char **keywords = E.syntax->keywords;
 
@@ -171,66 +266,71 @@ void editorUpdateSyntax(erow *row) {
   int mcs_len = mcs ? strlen(mcs) : 0;
   int mce_len = mce ? strlen(mce) : 0;
 
-  int prev_sep = 1;
-  int in_string = 0;
-  int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+  if (st->line_comment) {
+    editorHlFill(hl, base, cap, i, HL_COMMENT, to - i);
+    return to;
+  }
 
-  int i = 0;
-  // loop through all the chars in the row
-  while (i < row->size) {
-    char c = row->render[i]; // current char
-    unsigned char prev_hl =
-        (i > 0) ? row->hl[i - 1] : HL_NORMAL; // get prev hihglight
+  // loop through all the chars in the span
+  while (i < to) {
+    char c = s[i];                   // current char
+    unsigned char prev_hl = st->prev_hl; // get prev hihglight
 
     // highlight singleline comments
     // if not in string and not in comment
-    if (scs_len && !in_string && !in_comment) {
-      if (!strncmp(&row->render[i], scs, scs_len)) {
-        memset(&row->hl[i], HL_COMMENT, row->size - i);
-        break;
+    if (scs_len && !st->in_string && !st->in_comment) {
+      if (!strncmp(&s[i], scs, scs_len)) {
+        editorHlFill(hl, base, cap, i, HL_COMMENT, to - i);
+        st->line_comment = 1;
+        st->prev_hl = HL_COMMENT;
+        return to;
       }
     }
 
     // highlight multiline comment
-    if (mcs_len && mce_len && !in_string) {
-      if (in_comment) {
-        row->hl[i] = HL_MLCOMMENT;
-        if (!strncmp(&row->render[i], mce, mce_len)) {
-          memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+    if (mcs_len && mce_len && !st->in_string) {
+      if (st->in_comment) {
+        editorHlFill(hl, base, cap, i, HL_MLCOMMENT, 1);
+        st->prev_hl = HL_MLCOMMENT;
+        if (!strncmp(&s[i], mce, mce_len)) {
+          editorHlFill(hl, base, cap, i, HL_MLCOMMENT, mce_len);
           i += mce_len;
-          in_comment = 0;
-          prev_sep = 1;
+          st->in_comment = 0;
+          st->prev_sep = 1;
           continue;
         } else {
           i++;
           continue;
         }
-      } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-        memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+      } else if (!strncmp(&s[i], mcs, mcs_len)) {
+        editorHlFill(hl, base, cap, i, HL_MLCOMMENT, mcs_len);
+        st->prev_hl = HL_MLCOMMENT;
         i += mcs_len;
-        in_comment = 1;
+        st->in_comment = 1;
         continue;
       }
     }
 
     // highlight strings
     if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
-      if (in_string) {
-        row->hl[i] = HL_STRING;
-        if (c == '\\' && i + 1 < row->size) {
-          row->hl[i + 1] = HL_STRING;
+      if (st->in_string) {
+        editorHlFill(hl, base, cap, i, HL_STRING, 1);
+        st->prev_hl = HL_STRING;
+        if (c == '\\' && i + 1 < len) {
+          editorHlFill(hl, base, cap, i + 1, HL_STRING, 1);
           i += 2;
           continue;
         }
-        if (c == in_string)
-          in_string = 0;
+        if (c == st->in_string)
+          st->in_string = 0;
         i++;
-        prev_sep = 1;
+        st->prev_sep = 1;
         continue;
       } else {
         if (c == '"' || c == '\'') {
-          in_string = c;
-          row->hl[i] = HL_STRING;
+          st->in_string = c;
+          editorHlFill(hl, base, cap, i, HL_STRING, 1);
+          st->prev_hl = HL_STRING;
           i++;
           continue;
         }
@@ -239,16 +339,17 @@ void editorUpdateSyntax(erow *row) {
 
     // highlight numbers
     if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-      if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
+      if ((isdigit(c) && (st->prev_sep || prev_hl == HL_NUMBER)) ||
           (c == '.' && prev_hl == HL_NUMBER)) {
-        row->hl[i] = HL_NUMBER;
+        editorHlFill(hl, base, cap, i, HL_NUMBER, 1);
+        st->prev_hl = HL_NUMBER;
         i++;
-        prev_sep = 0;
+        st->prev_sep = 0;
         continue;
       }
     }
 
-    if (prev_sep) {
+    if (st->prev_sep) {
       int j;
       for (j = 0; keywords[j]; j++) {
         int klen = strlen(keywords[j]);
@@ -256,26 +357,167 @@ void editorUpdateSyntax(erow *row) {
         if (kw2)
           klen--;
 
-        if (!strncmp(&row->render[i], keywords[j], klen) &&
-            is_seperator(row->render[i + klen])) {
-          memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+        if (!strncmp(&s[i], keywords[j], klen) && is_seperator(s[i + klen])) {
+          st->prev_hl = kw2 ? HL_KEYWORD2 : HL_KEYWORD1;
+          editorHlFill(hl, base, cap, i, st->prev_hl, klen);
           i += klen;
           break;
         }
       }
       if (keywords[j] != NULL) {
-        prev_sep = 0;
+        st->prev_sep = 0;
         continue;
       }
     }
 
-    prev_sep = is_seperator(c);
+    st->prev_sep = is_seperator(c);
+    st->prev_hl = HL_NORMAL;
     i++;
   }
+  return i;
+}
+
+// highlight s[i..to) starting from state st, s holds len chars
+// hl gets the highlight of the chars [base, base + cap) or is NULL to only
+// advance the state, returns where scanning stopped which can be past to if a
+// token crosses it
+int editorHighlightSpan(struct hlState *st, const char *s, int len, int i,
+                        int to, unsigned char *hl, int base, int cap) {
+  if (E.syntax == NULL) // if no syntax return
+    return to;
+  if (E.syntax->scan)
+    return E.syntax->scan(st, s, len, i, to, hl, base, cap);
+  return editorHighlightInterpreted(st, s, len, i, to, hl, base, cap);
+}
+
+typedef int (*hlScanner)(struct hlState *, const char *, int, int, int,
+                         unsigned char *, int, int);
+
+// highlight every row with scan, returns the best time of a few runs in ms
+static double editorHlBenchRun(hlScanner scan, unsigned char **out) {
+  double best = -1;
+  for (int rep = 0; rep < 5; rep++) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    struct hlState st = {0, 0, 0, 1, HL_NORMAL};
+    for (int j = 0; j < E.numrows; j++) {
+      erow *row = &E.row[j];
+      st.in_string = 0;
+      st.line_comment = 0;
+      st.prev_sep = 1;
+      st.prev_hl = HL_NORMAL;
+      scan(&st, row->chars, row->size, 0, row->size, out[j], 0, row->size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+    if (best < 0 || ms < best)
+      best = ms;
+  }
+  return best;
+}
+
+// time the generated scanner of the filetype against the interpreted one
+void editorHlBench() {
+  if (E.syntax == NULL || E.syntax->scan == NULL) {
+    editorSetStatusMessage("hlbench: no generated scanner for this file");
+    return;
+  }
+  unsigned char **gen = malloc(sizeof(unsigned char *) * (E.numrows + 1));
+  unsigned char **interp = malloc(sizeof(unsigned char *) * (E.numrows + 1));
+  long long chars = 0;
+  for (int j = 0; j < E.numrows; j++) {
+    gen[j] = calloc(E.row[j].size + 1, 1);
+    interp[j] = calloc(E.row[j].size + 1, 1);
+    chars += E.row[j].size;
+  }
+
+  double tg = editorHlBenchRun(E.syntax->scan, gen);
+  double ti = editorHlBenchRun(editorHighlightInterpreted, interp);
+
+  int same = 1;
+  for (int j = 0; j < E.numrows; j++) {
+    same = same && !memcmp(gen[j], interp[j], E.row[j].size);
+    free(gen[j]);
+    free(interp[j]);
+  }
+  free(gen);
+  free(interp);
+  editorSetStatusMessage("hlbench: %lld chars, generated %.1f ms, interpreted "
+                         "%.1f ms, %s",
+                         chars, tg, ti, same ? "same" : "DIFFERENT");
+}
+
+// highlight of render column i of row
+int editorRowHl(erow *row, int i) {
+  if (!row->hl)
+    return HL_NORMAL;
+  return (row->hl[i >> 1] >> ((i & 1) * 4)) & 0xf;
+}
+
+// store the highlight of n render columns, one byte each, packed 4 bits per
+// column, rows that are all HL_NORMAL keep none
+void editorRowSetHl(erow *row, const unsigned char *hl, int n) {
+  int j = 0;
+  while (j < n && hl[j] == HL_NORMAL)
+    j++;
+  if (j == n) {
+    free(row->hl);
+    row->hl = NULL;
+    return;
+  }
+  row->hl = realloc(row->hl, (n + 1) / 2);
+  memset(row->hl, 0, (n + 1) / 2);
+  for (; j < n; j++)
+    row->hl[j >> 1] |= hl[j] << ((j & 1) * 4);
+}
+
+// unpack the highlight of row into hl, one byte per render column
+static void editorRowGetHl(erow *row, unsigned char *hl) {
+  for (int j = 0; j < row->rsize; j++)
+    hl[j] = editorRowHl(row, j);
+}
+
+// bytes to highlight a row into before it is packed
+static unsigned char *editorHlScratch(int n) {
+  static unsigned char *buf = NULL;
+  static int cap = 0;
+  if (n > cap) {
+    cap = n > 2 * cap ? n : 2 * cap;
+    buf = realloc(buf, cap);
+  }
+  return buf;
+}
+
+void editorUpdateSyntax(erow *row) {
+  int in_comment;
+
+  // not rendered yet, see editorRowRender, a row that just got long has no
+  // render either and is checkpointed below
+  if (!row->render && !(row->flags & ROW_LONG) &&
+      row->size < LONG_ROW_THRESHOLD) {
+    editorRowRender(row);
+    return;
+  }
+
+  if (row->size >= LONG_ROW_THRESHOLD) { // checkpointed, see longrow.c
+    editorLongRowUpdate(row);
+    in_comment = row->u.lr.cps[row->u.lr.ncps - 1].st.in_comment;
+  } else {
+    unsigned char *hl = editorHlScratch(row->rsize);
+    memset(hl, HL_NORMAL, row->rsize);
+
+    struct hlState st;
+    editorHlStart(row, &st);
+    editorHighlightSpan(&st, row->render, row->rsize, 0, row->rsize, hl, 0,
+                        row->rsize);
+    editorRowSetHl(row, hl, row->rsize);
+    in_comment = st.in_comment;
+  }
 
   int chagned = (row->hl_open_comment != in_comment);
   row->hl_open_comment = in_comment;
-  if (chagned && row->idx + 1 < E.numrows)
+  if (chagned && row->idx + 1 < E.numrows &&
+      !(E.row[row->idx + 1].flags & ROW_DEFERRED)) // gets there in order
     editorUpdateSyntax(&E.row[row->idx + 1]);
 }
 
@@ -318,6 +560,9 @@ void editorSelectSyntaxHighlight() {
 
         int filerow;
         for (filerow = 0; filerow < E.numrows; filerow++) {
+          // highlight all of it again, the chars and a yank of them stay
+          E.row[filerow].edit_at = 0;
+          E.row[filerow].edit_len = 0;
           editorUpdateSyntax(&E.row[filerow]);
         }
 
@@ -333,6 +578,8 @@ void editorSelectSyntaxHighlight() {
 // convert cursor position to render position
 // only for tabs rn
 int editorRowCxToRx(erow *row, int cx) {
+  if (row->flags & ROW_LONG)
+    return editorLongRowCxToRx(row, cx);
   int rx = 0;
   int j;
   for (j = 0; j < cx; j++) {
@@ -346,6 +593,8 @@ int editorRowCxToRx(erow *row, int cx) {
 
 // convert render position to cursor pos by reversing the added chars for tabs
 int editorRowRxToCx(erow *row, int rx) {
+  if (row->flags & ROW_LONG)
+    return editorLongRowRxToCx(row, rx);
   int cur_rx = 0;
   int cx;
   for (cx = 0; cx < row->size; cx++) {
@@ -359,7 +608,60 @@ int editorRowRxToCx(erow *row, int rx) {
   return cx;
 }
 
+// note an edit of row before it is updated, len chars were inserted (> 0) or
+// removed (< 0) at at, 0 if the change is not a single insert or delete
+void editorRowEdited(erow *row, int at, int len) {
+  editorYankRowChanging(row->idx);
+  if (row->edit_at != INT_MAX) { // second edit before an update
+    if (at < row->edit_at)
+      row->edit_at = at;
+    row->edit_len = 0;
+    return;
+  }
+  editorStatsRowEditing(row, at, len);
+  row->edit_at = at;
+  row->edit_len = len;
+}
+
+static void editorRowUpdateRender(erow *row);
+
 void editorUpdateRow(erow *row) {
+  if (row->edit_at == INT_MAX) { // changed without saying where
+    row->edit_at = 0;
+    row->edit_len = 0;
+  }
+  if (editorOutlineRowChanged(row))
+    editorSpellFenceChanged(row->idx);
+  editorSpellRowChanged(row);
+  editorCompleteRowChanged(row);
+  editorDiffRowChanged(row);
+  editorPreviewRowChanged(row);
+  editorStatsRowChanged(row);
+
+  // a macro replay renders each row it changed once, when it is over, and
+  // rows inserted together are rendered together
+  if ((row->flags & ROW_DEFERRED) ||
+      (editorMacroReplaying() && row->size < LONG_ROW_THRESHOLD &&
+       !(row->flags & ROW_LONG))) {
+    editorRowFreeRender(row);
+    row->flags |= ROW_DEFERRED;
+    row->edit_at = INT_MAX;
+    row->edit_len = 0;
+    return;
+  }
+  editorRowUpdateRender(row);
+}
+
+// render and highlight row, the hooks above already know about the change
+static void editorRowUpdateRender(erow *row) {
+  row->flags &= ~ROW_DEFERRED;
+  if (row->size >= LONG_ROW_THRESHOLD) { // render only the visible window
+    editorUpdateSyntax(row);
+    editorLayoutRowChanged(row);
+    return;
+  }
+  editorLongRowFree(row);
+
   int tabs = 0;
   int j;
   // loop through tabs to know how much mem to allocate
@@ -367,67 +669,337 @@ void editorUpdateRow(erow *row) {
     if (row->chars[j] == '\t')
       tabs++;
 
-  free(row->render); // free mem off prev render
-  // allocate new mem for render
-  row->render = malloc(row->size + tabs * (PEB_TAB_STOP - 1) + 1);
+  editorRowFreeRender(row);
 
   int idx = 0;
-  for (j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t') { // if tab print TAB_STOP chars
-      row->render[idx++] = ' ';
-      while (idx % PEB_TAB_STOP != 0)
+  if (!tabs) { // renders as is
+    row->render = row->chars;
+    row->flags |= ROW_RENDER_CHARS;
+    idx = row->size;
+  } else {
+    row->render = malloc(row->size + tabs * (PEB_TAB_STOP - 1) + 1);
+    for (j = 0; j < row->size; j++) {
+      if (row->chars[j] == '\t') { // if tab print TAB_STOP chars
         row->render[idx++] = ' ';
-    } else {
-      row->render[idx++] = row->chars[j];
+        while (idx % PEB_TAB_STOP != 0)
+          row->render[idx++] = ' ';
+      } else {
+        row->render[idx++] = row->chars[j];
+      }
     }
+    row->render[idx] = '\0';
   }
-  row->render[idx] = '\0';
   row->rsize = idx;
+  row->roff = 0;
+  row->rwidth = idx;
+  row->edit_at = INT_MAX;
 
   editorUpdateSyntax(row);
+  editorLayoutRowChanged(row);
+}
+
+// the render of a row goes away, with the highlight of its columns
+void editorRowFreeRender(erow *row) {
+  if (!(row->flags & ROW_RENDER_CHARS))
+    free(row->render);
+  row->render = NULL;
+  row->flags &= ~ROW_RENDER_CHARS;
+  free(row->hl);
+  row->hl = NULL;
+}
+
+// short rows keep their chars inside the erow, which moves whenever E.row is
+// reallocated or rows are inserted before it
+static void editorRowsMoved(int from, int to) {
+  for (int j = from; j < to; j++) {
+    erow *row = &E.row[j];
+    if (row->flags & ROW_INLINE_CHARS) {
+      row->chars = row->u.inl;
+      if (row->flags & ROW_RENDER_CHARS)
+        row->render = row->chars;
+    }
+  }
+}
+
+// room for n rows, E.row grows by doubling
+static void editorRowsReserve(int n) {
+  if (n <= E.rowcap)
+    return;
+  E.rowcap = E.rowcap ? E.rowcap * 2 : 64;
+  while (E.rowcap < n)
+    E.rowcap *= 2;
+  E.row = realloc(E.row, sizeof(erow) * E.rowcap);
+  editorRowsMoved(0, E.numrows);
+}
+
+// room for size chars and the terminating 0 in row
+static void editorRowReserve(erow *row, int size) {
+  if (!(row->flags & ROW_INLINE_CHARS)) {
+    row->chars = realloc(row->chars, size + 1);
+  } else if (size >= ROW_INLINE) { // outgrew the erow
+    char *chars = malloc(size + 1);
+    memcpy(chars, row->u.inl, row->size + 1);
+    row->chars = chars;
+    row->flags &= ~ROW_INLINE_CHARS;
+    row->u.lr.cps = NULL;
+    row->u.lr.ncps = 0;
+    row->u.lr.cps_size = 0;
+  }
+  if (row->flags & ROW_RENDER_CHARS)
+    row->render = row->chars;
+}
+
+static void editorRowInit(erow *row, int idx, const char *s, size_t len) {
+  row->idx = idx;
+  row->flags = 0;
+
+  row->size = len; // lenth of new row
+  if (len < ROW_INLINE) {
+    row->chars = row->u.inl;
+    row->flags |= ROW_INLINE_CHARS;
+  } else {
+    row->chars = malloc(len + 1); // alloc mem for new text
+    row->u.lr.cps = NULL;
+    row->u.lr.ncps = 0;
+    row->u.lr.cps_size = 0;
+  }
+  memcpy(row->chars, s, len); // cpy the s chars to the erow
+  row->chars[len] = '\0';     // terminate the row
+
+  // init render
+  row->rsize = 0;
+  row->render = NULL;
+  row->hl = NULL;
+  row->hl_open_comment = 0;
+  row->roff = 0;
+  row->rwidth = 0;
+  row->edit_at = INT_MAX;
+  row->edit_len = 0;
+  row->spell_state = SPELL_UNCHECKED;
+  row->spell = NULL;
+}
+
+// rows loaded with a cached comment state are rendered and highlighted
+// only once something needs to look at them
+void editorRowRender(erow *row) {
+  if (!(row->flags & ROW_DEFERRED) && !row->render && !(row->flags & ROW_LONG))
+    editorUpdateRow(row);
+  if (row->flags & ROW_DEFERRED) // needed before the replay is over
+    editorRowUpdateRender(row);
+}
+
+// a macro replay is over, render what it changed in order so an opened or
+// closed comment carries on to the rows after it
+void editorRowsRenderDeferred() {
+  for (int j = 0; j < E.numrows; j++)
+    if (E.row[j].flags & ROW_DEFERRED)
+      editorRowUpdateRender(&E.row[j]);
+}
+
+// the modules keep their own per row state in step, n rows came in at at
+static void editorRowsInserted(int at, int n) {
+  editorOutlineRowsInserted(at, n);
+  editorFoldRowsInserted(at, n); // and the layout tree
+  editorWindowRowsInserted(at, n);
+  editorSpellRowsInserted(at, n);
+  editorCompleteRowsInserted(at, n);
+  editorDiffRowsInserted(at, n);
+  editorPreviewRowsInserted(at, n);
+  editorStatsRowsInserted(at, n);
+}
+
+// the rows [at, at + n) went away
+static void editorRowsDeleted(int at, int n) {
+  if (editorOutlineRowsDeleted(at, n))
+    editorSpellFenceChanged(at);
+  editorFoldRowsDeleted(at, n); // and the layout tree
+  editorWindowRowsDeleted(at, n);
+  editorSpellRowsDeleted(at, n);
+  editorCompleteRowsDeleted(at, n);
+  editorDiffRowsDeleted(at, n);
+  editorPreviewRowsDeleted(at, n);
+  editorStatsRowsDeleted(at, n);
 }
 
 void editorInsertRow(int at, char *s, size_t len) {
   if (at < 0 || at > E.numrows)
     return;
+  editorYankRowsInserting(at, 1);
+  editorJournalRecord(JOURNAL_INSERT_ROW, at, 0, s, len);
 
-  E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
+  erow added; // s may be the chars of a row that is about to move
+  editorRowInit(&added, at, s, len);
+  editorRowsReserve(E.numrows + 1);
   memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
   for (int j = at + 1; j <= E.numrows; j++)
     E.row[j].idx++;
-
-  E.row[at].idx = at;
-
-  E.row[at].size = len;              // lenth of new row
-  E.row[at].chars = malloc(len + 1); // alloc mem for new text
-  memcpy(E.row[at].chars, s, len);   // cpy the s chars to the erow
-  E.row[at].chars[len] = '\0';       // terminate the row
-
-  // init render
-  E.row[at].rsize = 0;
-  E.row[at].render = NULL;
-  E.row[at].hl = NULL;
-  E.row[at].hl_open_comment = 0;
+  E.row[at] = added;
+  editorRowsMoved(at, E.numrows + 1);
+  editorRowsInserted(at, 1);
   editorUpdateRow(&E.row[at]); // update the row at
 
   E.numrows++;
   E.dirty++;
 }
 
+// insert the lines of buf, each ended by a newline, at at in one go, the
+// modules hear about them once and they are highlighted in one pass, with
+// the row after them, which may be in a comment now or no longer
+void editorInsertRows(int at, const char *buf, long long len) {
+  if (at < 0 || at > E.numrows)
+    return;
+  int n = 0;
+  for (const char *q = buf; (q = memchr(q, '\n', buf + len - q)); q++)
+    n++;
+  if (!n)
+    return;
+  editorYankRowsInserting(at, n);
+  editorRowsReserve(E.numrows + n);
+  memmove(&E.row[at + n], &E.row[at], sizeof(erow) * (E.numrows - at));
+  for (int j = at + n; j < E.numrows + n; j++)
+    E.row[j].idx += n;
+  const char *p = buf;
+  for (int j = at; j < at + n; j++) {
+    const char *nl = memchr(p, '\n', buf + len - p);
+    editorJournalRecord(JOURNAL_INSERT_ROW, j, 0, p, nl - p);
+    editorRowInit(&E.row[j], j, p, nl - p);
+    E.row[j].flags |= ROW_DEFERRED;
+    p = nl + 1;
+  }
+  E.numrows += n;
+  editorRowsMoved(at, E.numrows);
+  editorRowsInserted(at, n);
+  for (int j = at; j < at + n; j++) // the hooks, rendering waits
+    editorUpdateRow(&E.row[j]);
+  if (at + n < E.numrows)
+    E.row[at + n].flags |= ROW_DEFERRED;
+  if (!editorMacroReplaying())
+    for (int j = at; j <= at + n && j < E.numrows; j++)
+      editorRowRender(&E.row[j]);
+  E.dirty++;
+}
+
+// drop the \r of a \r\n line ending
+static int editorRowStripCR(erow *row) {
+  int n = row->size;
+  while (n > 0 && row->chars[n - 1] == '\r')
+    n--;
+  if (n == row->size)
+    return 0;
+  editorRowEdited(row, n, n - row->size);
+  row->size = n;
+  row->chars[n] = '\0';
+  return 1;
+}
+
+// append text read from the file as rows, if partial the first line continues
+// the last row, returns whether the new last row still waits for its newline
+// the rows are highlighted once each in order and this is not an edit, so
+// nothing is journaled or marked dirty
+int editorLoadRows(const char *buf, int len, int partial) {
+  const char *p = buf, *end = buf + len;
+  if (p == end)
+    return partial;
+
+  if (partial && E.numrows) {
+    erow *row = &E.row[E.numrows - 1];
+    const char *nl = memchr(p, '\n', end - p);
+    int n = (nl ? nl : end) - p;
+    editorRowEdited(row, row->size, n);
+    editorRowReserve(row, row->size + n);
+    memcpy(&row->chars[row->size], p, n);
+    row->size += n;
+    row->chars[row->size] = '\0';
+    if (nl)
+      editorRowStripCR(row);
+    editorUpdateRow(row);
+    if (!nl)
+      return 1;
+    p = nl + 1;
+  }
+
+  int lines = (p < end && end[-1] != '\n');
+  for (const char *q = p; (q = memchr(q, '\n', end - q)); q++)
+    lines++;
+  if (!lines)
+    return 0;
+  editorRowsReserve(E.numrows + lines);
+  editorLayoutRowsInserted(E.numrows, lines); // nothing after them is folded
+
+  while (p < end) {
+    const char *nl = memchr(p, '\n', end - p);
+    int n = (nl ? nl : end) - p;
+    if (nl)
+      while (n > 0 && p[n - 1] == '\r')
+        n--;
+    editorRowInit(&E.row[E.numrows], E.numrows, p, n);
+    E.numrows++; // last row, so highlighting never runs ahead
+    editorUpdateRow(&E.row[E.numrows - 1]);
+    if (!nl)
+      return 1;
+    p = nl + 1;
+  }
+  return 0;
+}
+
+// the input ended, a last line without a newline is complete now
+void editorLoadRowsDone(int partial) {
+  if (partial && E.numrows && editorRowStripCR(&E.row[E.numrows - 1]))
+    editorUpdateRow(&E.row[E.numrows - 1]);
+}
+
 void editorFreeRow(erow *row) {
-  free(row->render);
-  free(row->chars);
-  free(row->hl);
+  editorLongRowFree(row);
+  editorRowFreeRender(row);
+  if (!(row->flags & ROW_INLINE_CHARS))
+    free(row->chars);
+  free(row->spell);
 }
 
-void editorDelRow(int at) {
-  if (at < 0 || at >= E.numrows)
+// drop every row, for reading the file again from scratch
+void editorFreeRows() {
+  editorYankRowsFreeing();
+  for (int j = 0; j < E.numrows; j++)
+    editorFreeRow(&E.row[j]);
+  free(E.row);
+  E.row = NULL;
+  E.numrows = 0;
+  E.rowcap = 0;
+  editorLayoutInvalidate();
+  editorOutlineReset();
+  editorFoldReset();
+  editorSpellReset();
+  editorCompleteReset();
+  editorDiffReset();
+  editorPreviewReset();
+  editorStatsReset();
+}
+
+void editorDelRow(int at) { editorDelRows(at, 1); }
+
+// delete the rows [at, at + n) in one go, the row after them is highlighted
+// again as it may be in a comment now or no longer
+void editorDelRows(int at, int n) {
+  if (at < 0 || at >= E.numrows || n <= 0)
     return;
-  editorFreeRow(&E.row[at]);
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-  for (int j = at; j < E.numrows - 1; j++)
-    E.row[j].idx--;
-  E.numrows--;
+  if (n > E.numrows - at)
+    n = E.numrows - at;
+  editorYankRowsDeleting(at, n);
+  for (int j = at; j < at + n; j++) {
+    editorJournalRecord(JOURNAL_DEL_ROW, at, 0, NULL, 0);
+    editorFreeRow(&E.row[j]);
+  }
+  memmove(&E.row[at], &E.row[at + n], sizeof(erow) * (E.numrows - at - n));
+  for (int j = at; j < E.numrows - n; j++)
+    E.row[j].idx -= n;
+  editorRowsMoved(at, E.numrows - n);
+  editorRowsDeleted(at, n);
+  E.numrows -= n;
+  if (at < E.numrows) {
+    E.row[at].flags |= ROW_DEFERRED;
+    if (!editorMacroReplaying())
+      editorRowRender(&E.row[at]);
+  }
   E.dirty++;
 }
 
@@ -435,8 +1007,10 @@ void editorRowInsertChar(erow *row, int at, int c) {
   // if at is neg or beyond end of line set it to line size
   if (at < 0 || at > row->size)
     at = row->size;
-  // realloc mem for new char
-  row->chars = realloc(row->chars, row->size + 2);
+  char ch = c;
+  editorJournalRecord(JOURNAL_INSERT_CHAR, row->idx, at, &ch, 1);
+  editorRowEdited(row, at, 1);
+  editorRowReserve(row, row->size + 1); // room for the new char
   // move mem to new dest
   memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
   row->size++;          // add to rowsize
@@ -446,8 +1020,9 @@ void editorRowInsertChar(erow *row, int at, int c) {
 }
 
 void editorRowAppendString(erow *row, char *s, size_t len) {
-  // realloc mem for row and new row plus null char
-  row->chars = realloc(row->chars, row->size + len + 1);
+  editorJournalRecord(JOURNAL_APPEND, row->idx, 0, s, len);
+  editorRowEdited(row, row->size, len);
+  editorRowReserve(row, row->size + len); // room for the new chars
   memcpy(&row->chars[row->size], s, len); // copy mem
   row->size += len;                       // add len
   row->chars[row->size] = '\0';
@@ -459,12 +1034,124 @@ void editorRowAppendString(erow *row, char *s, size_t len) {
 void editorRowDelChar(erow *row, int at) {
   if (at < 0 || at >= row->size)
     return;
+  editorJournalRecord(JOURNAL_DEL_CHAR, row->idx, at, NULL, 0);
+  editorRowEdited(row, at, -1);
   memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
   row->size--;
   editorUpdateRow(row);
   E.dirty++;
 }
 
+// cut the row off after size chars
+void editorRowTruncate(erow *row, int size) {
+  if (size < 0 || size > row->size)
+    return;
+  editorJournalRecord(JOURNAL_TRUNCATE, row->idx, size, NULL, 0);
+  editorRowEdited(row, size, size - row->size);
+  row->size = size;
+  row->chars[size] = '\0';
+  editorUpdateRow(row);
+  E.dirty++;
+}
+
+// swap in new contents for row, takes ownership of chars
+static void editorRowReplace(erow *row, char *chars, int len) {
+  editorRowEdited(row, 0, 0);
+  if (row->flags & ROW_INLINE_CHARS) {
+    row->flags &= ~ROW_INLINE_CHARS;
+    row->u.lr.cps = NULL;
+    row->u.lr.ncps = 0;
+    row->u.lr.cps_size = 0;
+  } else {
+    free(row->chars);
+  }
+  row->chars = chars;
+  if (row->flags & ROW_RENDER_CHARS)
+    row->render = chars;
+  row->size = len;
+  editorUpdateRow(row);
+}
+
+// replace the contents of row, takes ownership of chars
+void editorRowSet(erow *row, char *chars, int len) {
+  editorJournalRecord(JOURNAL_SET_ROW, row->idx, 0, chars, len);
+  editorRowReplace(row, chars, len);
+  E.dirty++;
+}
+
+// replace the rows from at with the lines of buf, each ended by a newline,
+// as one edit, the rows that come out the same are left alone, returns the
+// number of rows changed
+int editorSetRows(int at, const char *buf, long long len) {
+  const char *p = buf, *end = buf + len, *nl;
+  int changed = 0;
+  for (int j = at; j < E.numrows && (nl = memchr(p, '\n', end - p)); j++) {
+    changed += nl - p != E.row[j].size || memcmp(p, E.row[j].chars, nl - p);
+    p = nl + 1;
+  }
+  if (!changed)
+    return 0;
+  editorJournalRecord(JOURNAL_SET_ROWS, at, 0, buf, len);
+  p = buf;
+  for (int j = at; j < E.numrows && (nl = memchr(p, '\n', end - p)); j++) {
+    int n = nl - p;
+    if (n != E.row[j].size || memcmp(p, E.row[j].chars, n)) {
+      char *chars = malloc(n + 1);
+      memcpy(chars, p, n);
+      chars[n] = '\0';
+      editorRowReplace(&E.row[j], chars, n);
+    }
+    p = nl + 1;
+  }
+  E.dirty++;
+  return changed;
+}
+
+// bytes malloc takes for a block of n, glibc adds an 8 byte header, rounds
+// up to 16 and hands out at least 32
+static long long editorHeapBlock(long long n) {
+  long long b = (n + 8 + 15) & ~15LL;
+  return b < 32 ? 32 : b;
+}
+
+#define EROW_SIZE_BEFORE 112 // sizeof(erow) with its own chars, render and hl
+
+// memory the rows take per line, and what they took before every row had a
+// render and a byte of highlight per column in blocks of their own
+void editorMemReport() {
+  if (E.numrows == 0) {
+    editorSetStatusMessage("mem: no lines");
+    return;
+  }
+  long long file = 0, now = (long long)sizeof(erow) * E.numrows, before = 0;
+  for (int j = 0; j < E.numrows; j++) {
+    erow *row = &E.row[j];
+    long long extra = 0; // the same either way
+    if (row->spell)
+      extra += editorHeapBlock(row->size);
+    if (row->flags & ROW_LONG)
+      extra += editorHeapBlock(sizeof(struct hlCheckpoint) * row->u.lr.ncps);
+
+    file += row->size + 1;
+    now += extra;
+    if (!(row->flags & ROW_INLINE_CHARS))
+      now += editorHeapBlock(row->size + 1);
+    if (row->render && !(row->flags & ROW_RENDER_CHARS))
+      now += editorHeapBlock(row->rsize + 1);
+    if (row->hl)
+      now += editorHeapBlock((row->rsize + 1) / 2);
+
+    before += EROW_SIZE_BEFORE + extra + editorHeapBlock(row->size + 1);
+    if (row->render)
+      before += editorHeapBlock(row->rsize + 1) +
+                (row->rsize ? editorHeapBlock(row->rsize) : 0);
+  }
+  editorSetStatusMessage("mem: %d lines, file %lld B/line, rows %lld B/line, "
+                         "before %lld",
+                         E.numrows, file / E.numrows, now / E.numrows,
+                         before / E.numrows);
+}
+
 /* editor operations */
 void editorInsertChar(int c) {
   if (E.cy == E.numrows) // append row if on new row
@@ -481,10 +1168,7 @@ void editorInsertNewline(int context) {
   } else {
     erow *row = &E.row[E.cy];
     editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-    row = &E.row[E.cy];
-    row->size = E.cx;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
+    editorRowTruncate(&E.row[E.cy], E.cx);
   }
   E.cy++;
   E.cx = 0;
@@ -509,47 +1193,273 @@ void editorDelChar() {
 }
 
 /* file i/o */
-char *editorRowsToString(int *buflen) {
-  int totlen = 0;
-  int j;
-  for (j = 0; j < E.numrows; j++)
-    totlen += E.row[j].size + 1; // get the total length of row
-  *buflen = totlen;              // return the totlen
-
-  char *buf = malloc(totlen); // alloc mem for buf
-  char *p = buf;
-  for (j = 0; j < E.numrows; j++) {
-    memcpy(p, E.row[j].chars, E.row[j].size); // cpy rows to buf
-    p += E.row[j].size;
-    *p = '\n';
-    p++;
+// write every row followed by a newline to fd without copying the buffer
+// into one string first, returns the bytes written or -1
+long long editorWriteRows(int fd) {
+  struct iovec iov[512];
+  long long total = 0;
+  int j = 0;
+  while (j < E.numrows) {
+    int n = 0;
+    for (; j < E.numrows && n + 2 <= 512; j++) {
+      iov[n].iov_base = E.row[j].chars;
+      iov[n++].iov_len = E.row[j].size;
+      iov[n].iov_base = "\n";
+      iov[n++].iov_len = 1;
+    }
+    int k = 0;
+    while (k < n) {
+      ssize_t w = writev(fd, &iov[k], n - k);
+      if (w == -1) {
+        if (errno == EINTR)
+          continue;
+        return -1;
+      }
+      total += w;
+      // skip what went out, a short write leaves part of an iovec
+      while (k < n && (size_t)w >= iov[k].iov_len)
+        w -= iov[k++].iov_len;
+      if (k < n) {
+        iov[k].iov_base = (char *)iov[k].iov_base + w;
+        iov[k].iov_len -= w;
+      }
+    }
   }
-  return buf;
+  return total;
+}
+
+// read fd to the end into rows after the last one, returns the bytes read
+// *partial says whether the last row is still waiting for its newline
+long long editorReadRows(int fd, int *partial) {
+  char buf[65536];
+  long long total = 0;
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) != 0) {
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    *partial = editorLoadRows(buf, n, *partial);
+    total += n;
+  }
+  editorLoadRowsDone(*partial);
+  return total;
+}
+
+// big files, split the rows at the cached line lengths and restore the
+// session if the cache knows the file, otherwise load them and remember them
+int editorOpenMapped(int fd, struct stat *st) {
+  char *map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    return 0;
+  uint64_t hash = editorCacheHash(map, st->st_size);
+
+  struct editorCache c;
+  if (editorCacheRead(E.filename, st, hash, &c)) {
+    E.rowcap = c.numrows ? c.numrows : 1;
+    E.row = malloc(sizeof(erow) * E.rowcap);
+    const char *p = map;
+    for (int j = 0; j < c.numrows; j++) {
+      int n = c.lens[j];
+      if (n && p[n - 1] == '\n')
+        n--;
+      while (n && p[n - 1] == '\r')
+        n--;
+      editorRowInit(&E.row[j], j, p, n);
+      E.row[j].hl_open_comment = (c.open[j / 8] >> (j % 8)) & 1;
+      editorOutlineRowChanged(&E.row[j]); // the row isn't updated until shown
+      p += c.lens[j];
+    }
+    E.numrows = c.numrows;
+    editorStatsLoad(c.words, c.chars, c.numrows); // counted when cached
+    editorLayoutInvalidate();
+
+    E.cy = (c.cy >= 0 && c.cy <= E.numrows) ? c.cy : 0;
+    E.cx = (E.cy < E.numrows && c.cx >= 0 && c.cx <= E.row[E.cy].size) ? c.cx
+                                                                      : 0;
+    E.rowoff = (c.rowoff >= 0 && c.rowoff <= E.cy) ? c.rowoff : E.cy;
+    E.coloff = c.coloff >= 0 ? c.coloff : 0;
+    E.wrap = c.wrap ? 1 : 0;
+    editorCacheFree(&c);
+  } else {
+    editorLoadRowsDone(editorLoadRows(map, st->st_size, 0));
+
+    // line lengths in the file, the rows lost their line endings
+    int *lens = malloc(sizeof(int) * (E.numrows ? E.numrows : 1));
+    const char *p = map, *end = map + st->st_size;
+    for (int j = 0; j < E.numrows; j++) {
+      const char *q = p + E.row[j].size;
+      while (q < end && *q == '\r')
+        q++;
+      if (q < end && *q == '\n')
+        q++;
+      lens[j] = q - p;
+      p = q;
+    }
+    editorCacheWrite(E.filename, st, hash, lens);
+    free(lens);
+  }
+  munmap(map, st->st_size);
+  return 1;
+}
+
+// a big file was just written, cache it as it is now
+void editorCacheSaved(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return;
+  struct stat st;
+  char *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= CACHE_MIN_SIZE)
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return;
+
+  int *lens = malloc(sizeof(int) * (E.numrows ? E.numrows : 1));
+  for (int j = 0; j < E.numrows; j++)
+    lens[j] = E.row[j].size + 1;
+  editorCacheWrite(path, &st, editorCacheHash(map, st.st_size), lens);
+  free(lens);
+  munmap(map, st.st_size);
 }
 
+// the last row of a compressed file is in
+static void editorOpenDone() { editorJournalOpen(E.filename); }
+
 void editorOpen(char *filename) {
   free(E.filename);              // free the filename if there is any saved
   E.filename = strdup(filename); // set the new filename
 
   editorSelectSyntaxHighlight();
 
-  FILE *fp = fopen(filename, "r");
-  if (!fp)
-    die("fopen");
+  editorSpellFiletype();
+
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    die("open");
+
+  E.codec = editorCodecDetect(fd);
+  if (E.codec) { // decompress in the background, rows show up as they come
+    int p[2];
+    pid_t pid = -1;
+    if (pipe2(p, O_CLOEXEC) == 0) {
+      pid = editorCodecSpawn(E.codec, 1, fd, p[1]);
+      close(p[1]);
+    }
+    close(fd);
+    if (pid == -1 || editorStreamStart(p[0], pid, editorOpenDone) == -1)
+      die("decompress");
+    editorStreamWait(E.screenrows);
+    E.dirty = 0;
+    return;
+  }
 
-  char *line = NULL;
-  size_t linecap = 0; // linecapacity
-  ssize_t linelen;
-  while ((linelen = getline(&line, &linecap, fp)) != -1) {
-    while (linelen > 0 &&
-           (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-      linelen--;
-    editorInsertRow(E.numrows, line, linelen);
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= CACHE_MIN_SIZE &&
+      editorOpenMapped(fd, &st)) {
+    close(fd);
+    E.dirty = 0;
+    editorJournalOpen(filename);
+    return;
   }
 
-  free(line);
-  fclose(fp);
+  int partial = 0;
+  editorReadRows(fd, &partial);
+  close(fd);
+  E.dirty = 0;
+
+  editorJournalOpen(filename); // offers to recover after a crash
+}
+
+// leave the file for another one, the caller made sure it is saved
+void editorCloseFile() {
+  editorJournalClose();
+  if (E.filename)
+    editorCacheSession(E.filename);
+  editorFollowStop();
+  editorDiffStop();
+  editorFreeRows();
+  free(E.filename);
+  E.filename = NULL;
+  E.codec = NULL;
+  E.cx = E.cy = E.rx = 0;
+  E.rowoff = E.coloff = E.wrapoff = 0;
   E.dirty = 0;
+  editorSelectSyntaxHighlight();
+  editorSpellFiletype();
+}
+
+// pipe the rows through codec into a temporary file next to path and move
+// it over path once the codec is done, a codec that is missing or fails
+// leaves path as it was, returns the compressed size or -1
+long long editorWriteCompressed(const char *path, const char *codec) {
+  const char *slash = strrchr(path, '/');
+  int dirlen = slash ? slash - path + 1 : 0;
+  char *tmp = malloc(strlen(path) + 16);
+  sprintf(tmp, "%.*s.%s.XXXXXX", dirlen, path, slash ? slash + 1 : path);
+  int fd = mkostemp(tmp, O_CLOEXEC);
+  if (fd == -1) {
+    free(tmp);
+    return -1;
+  }
+  struct stat st;
+  fchmod(fd, stat(path, &st) == 0 ? st.st_mode & 07777 : 0644);
+
+  int p[2];
+  pid_t pid = -1;
+  if (pipe2(p, O_CLOEXEC) == 0) {
+    pid = editorCodecSpawn(codec, 0, p[0], fd);
+    close(p[0]);
+    if (pid == -1)
+      close(p[1]);
+  }
+  long long len = -1;
+  if (pid != -1) {
+    void (*old)(int) = signal(SIGPIPE, SIG_IGN); // a dying codec is an error
+    long long written = editorWriteRows(p[1]);
+    close(p[1]);
+    signal(SIGPIPE, old);
+
+    int status = editorCodecWait(pid);
+    if (status != 0)
+      errno = EIO;
+    else if (written != -1 && fsync(fd) == 0 && fstat(fd, &st) == 0)
+      len = st.st_size;
+  }
+  close(fd);
+  if (len == -1 || rename(tmp, path) == -1) {
+    int err = errno;
+    unlink(tmp);
+    errno = err;
+    len = -1;
+  }
+  free(tmp);
+  return len;
+}
+
+// write the buffer to path, compressed if the name or the file it came from
+// says so, returns the bytes written or -1
+long long editorWriteFile(const char *path) {
+  const char *codec = editorCodecOfPath(path);
+  if (!codec && E.filename && !strcmp(path, E.filename))
+    codec = E.codec;
+  if (codec)
+    return editorWriteCompressed(path, codec);
+
+  long long len = 0;
+  for (int j = 0; j < E.numrows; j++)
+    len += E.row[j].size + 1; // get the total length of row
+
+  // open/create
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1)
+    return -1;
+  if (ftruncate(fd, len) == -1 || editorWriteRows(fd) != len)
+    len = -1;
+  close(fd);
+  return len;
 }
 
 void editorSave() {
@@ -561,45 +1471,158 @@ void editorSave() {
       return;
     }
     editorSelectSyntaxHighlight();
+    editorSpellFiletype();
+  }
+  if (E.codec && editorStreaming()) { // it is still being read
+    editorSetStatusMessage("Still decompressing, save again when done");
+    return;
   }
-  int len;
-  char *buf = editorRowsToString(&len);
 
-  // open/create
-  int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-  if (fd != -1) {
-    if (ftruncate(fd, len) != -1) {     // truncate file buf
-      if (write(fd, buf, len) == len) { // write to file
-        close(fd);
-        free(buf);
-        E.dirty = 0;
-        editorSetStatusMessage("%d bytes written to disk", len);
+  long long len = editorWriteFile(E.filename);
+  if (len == -1) {
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    return;
+  }
+  E.dirty = 0;
+  editorJournalReset();
+  editorFollowSaved(len);
+  editorDiffSaved();
+  if (!E.codec && len >= CACHE_MIN_SIZE)
+    editorCacheSaved(E.filename);
+  editorSetStatusMessage("%lld bytes written to disk%s", len,
+                         editorStreaming() ? ", more input is arriving" : "");
+}
+
+// :w file, names an unnamed buffer or writes a copy
+void editorSaveTo(char *filename) {
+  if (E.filename == NULL) {
+    E.filename = strdup(filename);
+    editorSelectSyntaxHighlight();
+    editorSpellFiletype();
+    editorSave();
+    return;
+  }
+  long long len = editorWriteFile(filename);
+  if (len == -1)
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+  else
+    editorSetStatusMessage("%lld bytes written to %s", len, filename);
+}
+
+/* find */
+#define FIND_PARALLEL_ROWS 20000 // buffers this big are scanned on the pool
+#define FIND_CHUNK_ROWS 4096     // rows per scan job
+#define FIND_POLL_ROWS 1024      // rows between checks for cancellation
+
+struct findScan {
+  struct regex *re;
+  int start;     // row at scan offset 0
+  int direction; // 1 forwards, -1 backwards
+  int nrows;     // rows to scan
+  int chunk;     // rows per job
+  int *result;   // first matching offset per job or -1
+  int found;     // lowest job that found a match
+  int cancel;    // set once a key is waiting, the query is about to change
+};
+
+// scan one range of rows, ranges later in scan order give up as soon as an
+// earlier one has found a match
+void editorFindJob(void *arg, int job) {
+  struct findScan *fs = arg;
+  int begin = job * fs->chunk;
+  int end = begin + fs->chunk;
+  if (end > fs->nrows)
+    end = fs->nrows;
+  fs->result[job] = -1;
+
+  for (int off = begin; off < end; off++) {
+    if ((off - begin) % FIND_POLL_ROWS == 0) {
+      struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+      if (poll(&pfd, 1, 0) > 0)
+        __atomic_store_n(&fs->cancel, 1, __ATOMIC_RELAXED);
+      if (__atomic_load_n(&fs->cancel, __ATOMIC_RELAXED) ||
+          __atomic_load_n(&fs->found, __ATOMIC_RELAXED) < job)
         return;
-      }
     }
-    close(fd);
+
+    int current = (fs->start + fs->direction * off) % E.numrows;
+    if (current < 0)
+      current += E.numrows;
+    erow *row = &E.row[current];
+    if (regexSearch(fs->re, row->chars, row->size, 0, NULL, NULL)) {
+      fs->result[job] = off;
+      int seen = __atomic_load_n(&fs->found, __ATOMIC_RELAXED);
+      while (job < seen &&
+             !__atomic_compare_exchange_n(&fs->found, &seen, job, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+      return;
+    }
   }
-  free(buf);
-  editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
 
-/* find */
+// find the next row after last_match matching re, -1 if there is none or the
+// scan was cancelled by pending input
+int editorFindRow(struct regex *re, int last_match, int direction) {
+  if (E.numrows == 0)
+    return -1;
+
+  struct findScan fs;
+  fs.re = re;
+  fs.direction = direction;
+  fs.start = last_match + direction;
+  fs.nrows = E.numrows;
+  fs.found = INT_MAX;
+  fs.cancel = 0;
+
+  int njobs = 1;
+  fs.chunk = E.numrows;
+  if (E.numrows >= FIND_PARALLEL_ROWS && poolThreads() > 1) {
+    fs.chunk = FIND_CHUNK_ROWS;
+    njobs = (E.numrows + FIND_CHUNK_ROWS - 1) / FIND_CHUNK_ROWS;
+  }
+  int results[njobs];
+  fs.result = results;
+
+  poolRun(njobs, editorFindJob, &fs);
+
+  if (fs.cancel || fs.found == INT_MAX)
+    return -1;
+  int current = (fs.start + direction * results[fs.found]) % E.numrows;
+  return current < 0 ? current + E.numrows : current;
+}
+
 void editorFindCallback(char *query, int key) {
   static int last_match = -1;
   static int direction = 1;
 
-  static int saved_hl_line;
-  static char *saved_hl = NULL;
+  static int saved_hl_line = -1; // row showing the match, -1 if none
+  static int saved_hl_len;
+  static int saved_hl_off;
+  static unsigned char *saved_hl = NULL;
+
+  static struct regex *re = NULL;
+  static char *re_query = NULL;
 
-  if (saved_hl) {
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-    free(saved_hl);
+  if (saved_hl_line != -1) {
+    erow *row = &E.row[saved_hl_line];
+    if (row->rsize == saved_hl_len && row->roff == saved_hl_off) {
+      free(row->hl);
+      row->hl = saved_hl;
+    } else {
+      free(saved_hl);
+    }
     saved_hl = NULL;
+    saved_hl_line = -1;
   }
 
   if (key == '\r' || key == '\x1b') {
     last_match = -1;
     direction = 1;
+    regexFree(re);
+    re = NULL;
+    free(re_query);
+    re_query = NULL;
     return;
   } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
     direction = 1;
@@ -610,43 +1633,50 @@ void editorFindCallback(char *query, int key) {
     direction = 1;
   }
 
+  // compile once per query, arrow keys reuse the last one
+  if (!re_query || strcmp(re_query, query)) {
+    regexFree(re);
+    free(re_query);
+    re_query = strdup(query);
+    re = query[0] ? regexCompile(query, NULL) : NULL;
+  }
+  if (!re) // empty or incomplete pattern
+    return;
+
   if (last_match == -1)
     direction = 1;
-  int current = last_match;
-  int i;
-  for (i = 0; i < E.numrows; i++) {
-    current += direction;
-    if (current == -1)
-      current = E.numrows - 1;
-    else if (current == E.numrows)
-      current = 0;
+  int current = editorFindRow(re, last_match, direction);
+  if (current == -1)
+    return;
 
-    erow *row = &E.row[current];
-    char *match = strstr(row->render, query);
-    if (match) {
-      last_match = current;
-      int yOff = current;
-      int curY = E.cy;
-      if (yOff > curY) {
-        while (yOff) {
-          editorMoveCursor(ARROW_DOWN);
-          yOff--;
-        }
-      } else if (curY > yOff) {
-        while (curY) {
-          editorMoveCursor(ARROW_UP);
-          curY--;
-        }
-      }
-      E.cx = editorRowRxToCx(row, match - row->render);
+  erow *row = &E.row[current];
+  int mstart, mlen;
+  regexSearch(re, row->chars, row->size, 0, &mstart, &mlen);
+  last_match = current;
+  E.cy = current;
+  E.cx = mstart;
 
-      saved_hl_line = current;
-      saved_hl = malloc(row->size);
-      memcpy(saved_hl, row->hl, row->size);
-      memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
-      break;
-    }
-  }
+  // long rows only have the columns around the cursor rendered
+  editorScroll();
+  editorRowRender(row);
+  editorLongRowWindow(row, E.coloff, E.screencols);
+  int from = editorRowCxToRx(row, mstart) - row->roff;
+  int to = editorRowCxToRx(row, mstart + mlen) - row->roff;
+  if (from < 0)
+    from = 0;
+  if (to > row->rsize)
+    to = row->rsize;
+
+  saved_hl_line = current;
+  saved_hl_len = row->rsize;
+  saved_hl_off = row->roff;
+  unsigned char *hl = editorHlScratch(row->rsize);
+  editorRowGetHl(row, hl);
+  saved_hl = row->hl;
+  row->hl = NULL;
+  if (to > from)
+    memset(&hl[from], HL_MATCH, to - from);
+  editorRowSetHl(row, hl, row->rsize);
 }
 
 void editorFind() {
@@ -667,17 +1697,228 @@ void editorFind() {
   }
 }
 
+/* replace */
+#define REPLACE_CHUNK_ROWS 4096 // rows per job when computing replacements
+
+struct replaceEdit {
+  int row;
+  char *chars; // new contents of the row
+  int len;
+};
+
+struct replaceScan {
+  struct regex *re;
+  char *rep; // replacement, & stands for the match
+  int global;
+  int first; // first row of the range
+  int nrows;
+  struct replaceEdit **edits; // per job, in row order
+  int *nedits;
+  int *counts; // replacements per job
+};
+
+static void replaceAppend(char **buf, int *len, int *cap, const char *s, int n) {
+  if (*len + n + 1 > *cap) {
+    while (*len + n + 1 > *cap)
+      *cap = *cap ? *cap * 2 : 64;
+    *buf = realloc(*buf, *cap);
+  }
+  memcpy(&(*buf)[*len], s, n);
+  *len += n;
+}
+
+// build the new contents of one row, returns the number of replacements
+int editorReplaceRow(struct replaceScan *rs, erow *row, char **out, int *outlen) {
+  char *buf = NULL;
+  int len = 0, cap = 0, count = 0;
+  int at = 0, done = 0; // done: chars of row already copied to buf
+  int prev_end = -1;     // end of the last non-empty match
+  int mstart, mlen;
+
+  while (at <= row->size &&
+         regexSearch(rs->re, row->chars, row->size, at, &mstart, &mlen)) {
+    if (mlen == 0 && mstart == prev_end) { // no empty match right after one
+      at = mstart + 1;
+      continue;
+    }
+    replaceAppend(&buf, &len, &cap, &row->chars[done], mstart - done);
+    for (char *r = rs->rep; *r; r++) {
+      if (*r == '&')
+        replaceAppend(&buf, &len, &cap, &row->chars[mstart], mlen);
+      else if (*r == '\\' && r[1])
+        replaceAppend(&buf, &len, &cap, ++r, 1);
+      else
+        replaceAppend(&buf, &len, &cap, r, 1);
+    }
+    done = mstart + mlen;
+    at = done;
+    if (mlen > 0)
+      prev_end = done;
+    if (mlen == 0) { // step over the char after an empty match
+      if (at < row->size)
+        replaceAppend(&buf, &len, &cap, &row->chars[at], 1);
+      done = ++at;
+    }
+    count++;
+    if (!rs->global)
+      break;
+  }
+
+  if (count == 0)
+    return 0;
+  if (done < row->size)
+    replaceAppend(&buf, &len, &cap, &row->chars[done], row->size - done);
+  replaceAppend(&buf, &len, &cap, "", 0);
+  buf[len] = '\0';
+  *out = buf;
+  *outlen = len;
+  return count;
+}
+
+void editorReplaceJob(void *arg, int job) {
+  struct replaceScan *rs = arg;
+  int begin = rs->first + job * REPLACE_CHUNK_ROWS;
+  int end = begin + REPLACE_CHUNK_ROWS;
+  if (end > rs->first + rs->nrows)
+    end = rs->first + rs->nrows;
+
+  struct replaceEdit *edits = NULL;
+  int nedits = 0, cap = 0, count = 0;
+  for (int r = begin; r < end; r++) {
+    char *chars;
+    int len;
+    int n = editorReplaceRow(rs, &E.row[r], &chars, &len);
+    if (n == 0)
+      continue;
+    if (nedits == cap) {
+      cap = cap ? cap * 2 : 16;
+      edits = realloc(edits, sizeof(struct replaceEdit) * cap);
+    }
+    edits[nedits].row = r;
+    edits[nedits].chars = chars;
+    edits[nedits].len = len;
+    nedits++;
+    count += n;
+  }
+  rs->edits[job] = edits;
+  rs->nedits[job] = nedits;
+  rs->counts[job] = count;
+}
+
+// split s at the next unescaped delim, removing the escape of the delim
+static char *replaceField(char *s, char delim) {
+  char *w = s;
+  for (; *s; s++) {
+    if (*s == '\\' && s[1] == delim) {
+      *w++ = *++s;
+    } else if (*s == delim) {
+      *w = '\0';
+      return s + 1;
+    } else {
+      if (*s == '\\' && s[1])
+        *w++ = *s++;
+      *w++ = *s;
+    }
+  }
+  *w = '\0';
+  return NULL;
+}
+
+// :s/pat/rep/[g] over nrows rows starting at first
+// all replacements are computed before any row is touched, then every
+// changed row is rebuilt and highlighted once
+void editorReplace(char *cmd, int first, int nrows) {
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  char delim = cmd[0];
+  if (delim == '\0' || isalnum((unsigned char)delim) || delim == '\\' ||
+      delim == ' ') {
+    editorSetStatusMessage("Usage: :%%s/pattern/replacement/[g]");
+    return;
+  }
+  char *pat = &cmd[1];
+  char *rep = replaceField(pat, delim);
+  char *flags = rep ? replaceField(rep, delim) : NULL;
+  if (!rep)
+    rep = "";
+
+  const char *err = NULL;
+  struct regex *re = regexCompile(pat, &err);
+  if (!re) {
+    editorSetStatusMessage("Bad pattern: %s", err);
+    return;
+  }
+  if (first + nrows > E.numrows)
+    nrows = E.numrows - first;
+
+  struct replaceScan rs;
+  rs.re = re;
+  rs.rep = rep;
+  rs.global = flags && strchr(flags, 'g');
+  rs.first = first;
+  rs.nrows = nrows;
+  int njobs = nrows > 0 ? (nrows + REPLACE_CHUNK_ROWS - 1) / REPLACE_CHUNK_ROWS : 0;
+  rs.edits = malloc(sizeof(*rs.edits) * (njobs + 1));
+  rs.nedits = malloc(sizeof(int) * (njobs + 1));
+  rs.counts = malloc(sizeof(int) * (njobs + 1));
+
+  poolRun(njobs, editorReplaceJob, &rs);
+
+  int count = 0, lines = 0;
+  for (int j = 0; j < njobs; j++) {
+    for (int k = 0; k < rs.nedits[j]; k++) {
+      struct replaceEdit *ed = &rs.edits[j][k];
+      editorRowSet(&E.row[ed->row], ed->chars, ed->len);
+    }
+    lines += rs.nedits[j];
+    count += rs.counts[j];
+    free(rs.edits[j]);
+  }
+  free(rs.edits);
+  free(rs.nedits);
+  free(rs.counts);
+  regexFree(re);
+
+  if (count) {
+    if (E.cy < E.numrows && E.cx > E.row[E.cy].size)
+      E.cx = E.row[E.cy].size;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+  editorSetStatusMessage("%d replacements on %d lines in %.1f ms", count, lines,
+                         ms);
+}
+
 /* output */
 void editorScroll() {
   E.rx = 0;
   if (E.cy < E.numrows) { // if cursor is above visible window
     E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
   }
-  if (E.cy < E.rowoff) {
-    E.rowoff = E.cy;
+  if (editorLayoutHidden(E.cy)) // jumped into a fold, open it
+    editorFoldOpen(E.cy);
+  if (E.wrap) { // scroll by display lines instead
+    editorLayoutScroll();
+    return;
   }
-  if (E.cy >= E.rowoff + E.screenrows) { // if cursors is past the botom
-    E.rowoff = E.cy - E.screenrows + 1;
+  if (editorFolds()) { // folded rows take no screen lines
+    int cur = editorLayoutLineOfRow(E.cy);
+    int top = editorLayoutLineOfRow(E.rowoff);
+    if (cur < top)
+      top = cur;
+    if (cur >= top + E.screenrows)
+      top = cur - E.screenrows + 1;
+    int sub;
+    E.rowoff = editorLayoutRowOfLine(top, &sub);
+  } else {
+    if (E.cy < E.rowoff) {
+      E.rowoff = E.cy;
+    }
+    if (E.cy >= E.rowoff + E.screenrows) { // if cursors is past the botom
+      E.rowoff = E.cy - E.screenrows + 1;
+    }
   }
   if (E.cx < E.coloff) { // prevent from going of screen left
     E.coloff = E.cx;
@@ -687,10 +1928,102 @@ void editorScroll() {
   }
 }
 
-void editorDrawRows(struct abuf *ab) {
+// draw the render columns [col, col + width) of row, returns the columns drawn
+int editorDrawRender(struct abuf *ab, erow *row, int col, int width) {
+  editorRowRender(row);
+  editorLongRowWindow(row, col, width);
+  int len = row->roff + row->rsize - col;
+  if (len < 0)
+    len = 0;
+  if (len > width)
+    len = width;
+  char *c = &row->render[col - row->roff];
+  int current_color = -1;
+  int under = 0;            // misspelled word underlined
+  int cx = 0, cx_end = 0;   // char at the render column and where it ends
+  int j;
+  for (j = 0; j < len; j++) {
+    if (row->spell) {
+      while (cx_end <= col + j) {
+        cx_end += (row->chars[cx] == '\t') ? PEB_TAB_STOP - cx_end % PEB_TAB_STOP
+                                           : 1;
+        cx++;
+      }
+      if (row->spell[cx - 1] != under) {
+        under = row->spell[cx - 1];
+        abAppend(ab, under ? "\x1b[4m" : "\x1b[24m", under ? 4 : 5);
+      }
+    }
+    int hl = editorRowHl(row, col - row->roff + j);
+    if (iscntrl(c[j])) {
+      char sym = (c[j] <= 26) ? '@' + c[j] : '?';
+      abAppend(ab, "\x1b[7m", 4);
+      abAppend(ab, &sym, 1);
+      abAppend(ab, "\x1b[m", 3);
+      under = 0;
+      if (current_color != -1) {
+        char buf[16];
+        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
+        abAppend(ab, buf, clen);
+      }
+    } else if (hl == HL_NORMAL) {
+      if (current_color != -1) {
+        abAppend(ab, "\x1b[39m", 5);
+        current_color = -1;
+      }
+      abAppend(ab, &c[j], 1);
+    } else {
+      int color = editorSyntaxToColor(hl);
+      if (color != current_color) {
+        current_color = color;
+        char buf[16];
+        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
+        abAppend(ab, buf, clen);
+      }
+      abAppend(ab, &c[j], 1);
+    }
+  }
+  if (under)
+    abAppend(ab, "\x1b[24m", 5);
+  abAppend(ab, "\x1b[39m", 5);
+  return len;
+}
+
+// after the fold line, how many rows it hides if there is room
+// returns the columns drawn
+int editorDrawFoldMarker(struct abuf *ab, int row, int used) {
+  int hidden = editorFoldAt(row);
+  if (!hidden)
+    return 0;
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), " [+%d lines]", hidden);
+  if (used + len > E.screencols)
+    return 0;
+  char color[16];
+  int clen = snprintf(color, sizeof(color), "\x1b[%dm",
+                      editorSyntaxToColor(HL_COMMENT));
+  abAppend(ab, color, clen);
+  abAppend(ab, buf, len);
+  abAppend(ab, "\x1b[39m", 5);
+  return len;
+}
+
+// draw the text lines of the view in E, emit gets every screen line with the
+// columns it takes up and clears or pads the rest
+void editorDrawRows(void (*emit)(int y, struct abuf *line, int cols)) {
+  struct abuf line = ABUF_INIT;
+  struct abuf *ab = &line;
   int y;
+  int filerow = E.rowoff;            // get the y in the file
+  int sub = E.wrap ? E.wrapoff : 0; // visual line of filerow when wrapping
+  int sel_first, sel_last;           // rows selected in visual mode
+  if (!editorYankSelection(&sel_first, &sel_last))
+    sel_first = sel_last = -1;
   for (y = 0; y < E.screenrows; y++) { // for every row
-    int filerow = y + E.rowoff;        // get the y in the file
+    int cols = 0;
+    line.len = 0;
+    int sel = (filerow >= sel_first && filerow <= sel_last);
+    editorDiffDrawGutter(ab, filerow < E.numrows && sub == 0 ? filerow : -1);
     if (filerow >= E.numrows) {        // check if text is part of row buffer
       if (E.numrows == 0 &&
           y == E.screenrows / 3) { // if row is third down monitor draw welcmmsg
@@ -700,6 +2033,7 @@ void editorDrawRows(struct abuf *ab) {
         if (welcomelen > E.screencols)
           welcomelen = E.screencols;
         int padding = (E.screencols - welcomelen) / 2;
+        cols = padding + welcomelen;
         if (padding) {
           abAppend(ab, "~", 1);
           padding--;
@@ -709,70 +2043,84 @@ void editorDrawRows(struct abuf *ab) {
         abAppend(ab, welcome, welcomelen);
       } else { // if not buf, draw ~
         abAppend(ab, "~", 1);
+        cols = 1;
       }
-    } else { // TODO comment
-      int len = E.row[filerow].rsize - E.coloff;
-      if (len < 0)
-        len = 0;
-      if (len > E.screencols)
-        len = E.screencols;
-      char *c = &E.row[filerow].render[E.coloff];
-      unsigned char *hl = &E.row[filerow].hl[E.coloff];
-      int current_color = -1;
-      int j;
-      for (j = 0; j < len; j++) {
-        if (iscntrl(c[j])) {
-          char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-          abAppend(ab, "\x1b[7m", 4);
-          abAppend(ab, &sym, 1);
-          abAppend(ab, "\x1b[m", 3);
-          if (current_color != -1) {
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-            abAppend(ab, buf, clen);
-          }
-        } else if (hl[j] == HL_NORMAL) {
-          if (current_color != -1) {
-            abAppend(ab, "\x1b[39m", 5);
-            current_color = -1;
-          }
-          abAppend(ab, &c[j], 1);
-        } else {
-          int color = editorSyntaxToColor(hl[j]);
-          if (color != current_color) {
-            current_color = color;
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-            abAppend(ab, buf, clen);
-          }
-          abAppend(ab, &c[j], 1);
-        }
+    } else if (E.wrap) { // draw one visual line of the row
+      erow *row = &E.row[filerow];
+      if (sel)
+        abAppend(ab, "\x1b[7m", 4);
+      int lines = editorLayoutRowLines(row);
+      int start = editorLayoutLineStart(row, sub);
+      int end = (sub + 1 < lines) ? editorLayoutLineStart(row, sub + 1)
+                                  : row->rwidth;
+      cols = editorDrawRender(ab, row, start, end - start);
+      if (sel) {
+        if (!cols++) // show empty lines are selected too
+          abAppend(ab, " ", 1);
+        abAppend(ab, "\x1b[27m", 5);
+      }
+      if (++sub >= lines) {
+        cols += editorDrawFoldMarker(ab, filerow, cols);
+        sub = 0;
+        filerow = editorLayoutNextRow(filerow);
+      }
+    } else { // draw the visible part of the row
+      if (sel)
+        abAppend(ab, "\x1b[7m", 4);
+      cols = editorDrawRender(ab, &E.row[filerow], E.coloff, E.screencols);
+      if (sel) {
+        if (!cols++)
+          abAppend(ab, " ", 1);
+        abAppend(ab, "\x1b[27m", 5);
       }
-      abAppend(ab, "\x1b[39m", 5);
+      cols += editorDrawFoldMarker(ab, filerow, cols);
+      filerow = editorLayoutNextRow(filerow);
     }
 
-    abAppend(ab, "\x1b[K", 3); // clear line currenlty operating on
-    abAppend(ab, "\r\n", 2);
+    emit(y, &line, cols + editorDiffGutter());
   }
+  abFree(&line);
 }
 
-void editorDrawStatusBar(struct abuf *ab) {
+// status line of the view in E, the mode only shows on the active window
+void editorDrawStatusBar(struct abuf *ab, int active) {
   abAppend(ab, "\x1b[7m", 4);   // invert output
-  char status[80], rstatus[80]; // left and right status char*
+  int width = E.screencols + editorDiffGutter(); // under the gutter too
+  char status[80], rstatus[160]; // left and right status char*
+  char stats[80];                // words and reading time, if there is room
+  int slen = editorStatsFormat(stats, sizeof(stats));
+  char rec[8] = "";
+  if (active && editorMacroRecording())
+    snprintf(rec, sizeof(rec), "@%c ", editorMacroRecording());
   // get length's for status bar messages
-  int len = snprintf(status, sizeof(status), "%.10s%.20s%s - %d lines",
-                     (E.mode == INSERT) ? "[insert]" : "[normal]",
-                     E.filename ? E.filename : "[No Name]", E.dirty ? "*" : "",
-                     E.numrows);
-  int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d:%d/%d",
+  int len = snprintf(status, sizeof(status), "%.10s%s%.20s%s - %d lines%s",
+                     !active             ? ""
+                     : (E.mode == INSERT) ? "[insert]"
+                     : (E.mode == VISUAL) ? "[visual]"
+                                          : "[normal]",
+                     rec,
+                     E.filename          ? E.filename
+                     : editorGrepShown() ? "[grep]"
+                                         : "[No Name]",
+                     E.dirty ? "*" : "",
+                     E.numrows,
+                     editorFollowing()   ? " (following)"
+                     : editorStreaming() ? " (reading)"
+                                         : "");
+  int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %s | %d:%d/%d", stats,
                       E.syntax ? E.syntax->filetype : "no ft", E.cy + 1, E.cx,
                       E.numrows);
-  if (len > E.screencols) // cap length to screencols
-    len = E.screencols;
-  abAppend(ab, status, len);   // append left msg
-  while (len < E.screencols) { // append right message or print spaces until msg
-    if (E.screencols - len == rlen) {
-      abAppend(ab, rstatus, rlen);
+  char *right = rstatus; // without the stats if they don't fit
+  if (!slen || len + rlen > width) {
+    right += slen + 3;
+    rlen -= slen + 3;
+  }
+  if (len > width) // cap length to screencols
+    len = width;
+  abAppend(ab, status, len); // append left msg
+  while (len < width) {      // append right message or print spaces until msg
+    if (width - len == rlen) {
+      abAppend(ab, right, rlen);
       break;
     } else {
       abAppend(ab, " ", 1);
@@ -780,40 +2128,43 @@ void editorDrawStatusBar(struct abuf *ab) {
     }
   }
   abAppend(ab, "\x1b[m", 3); // un invert output
-  abAppend(ab, "\r\n", 2);   // newline
 }
 
-void editorDrawMessageBar(struct abuf *ab) {
+// the message line under all windows, cols wide
+void editorDrawMessageBar(struct abuf *ab, int cols) {
   abAppend(ab, "\x1b[K", 3); // clear from cursor pos to eol
   int msglen = strlen(E.statusmsg);
-  if (msglen > E.screencols)
-    msglen = E.screencols;
+  if (msglen > cols)
+    msglen = cols;
   if (msglen && time(NULL) - E.statusmsg_time < 5)
     abAppend(ab, E.statusmsg, msglen);
 }
 
 void editorRefreshScreen() {
-  editorScroll();
-  struct abuf ab = ABUF_INIT; // make new abuf
+  if (editorMacroReplaying()) // drawn once the replay is over
+    return;
+  struct abuf *ab = editorOutputFrame(); // empty frame buffer
 
-  abAppend(&ab, "\x1b[?25l", 6); // hide cursor
-  abAppend(&ab, "\x1b[H", 3);    // cursor to 1,1
+  abAppend(ab, "\x1b[?25l", 6); // hide cursor
 
-  // drawing stuff to screen
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab);
-  editorDrawMessageBar(&ab);
+  // drawing stuff to screen, every window scrolls to its cursor
+  int top, left;
+  editorWindowDraw(ab, &top, &left);
 
   char buf[64];
   // cursor to cx and cy
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1,
-           (E.cx - E.coloff) + 1);
-  abAppend(&ab, buf, strlen(buf));
-
-  abAppend(&ab, "\x1b[?25h", 6); // show cursor
-
-  write(STDOUT_FILENO, ab.b, ab.len); // write to screen
-  abFree(&ab);
+  int cury = E.cy - E.rowoff, curx = E.cx - E.coloff;
+  if (E.wrap)
+    editorLayoutCursor(&cury, &curx);
+  else if (editorFolds())
+    cury = editorLayoutLineOfRow(E.cy) - editorLayoutLineOfRow(E.rowoff);
+  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", top + cury + 1,
+           left + editorDiffGutter() + curx + 1);
+  abAppend(ab, buf, strlen(buf));
+
+  abAppend(ab, "\x1b[?25h", 6); // show cursor
+
+  editorOutputSubmit(); // written to screen by the output thread
 }
 
 void editorSetStatusMessage(const char *fmt, ...) {
@@ -826,6 +2177,13 @@ void editorSetStatusMessage(const char *fmt, ...) {
 
 /* input */
 char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
+  return editorPromptAccept(prompt, callback, NULL);
+}
+
+// a prompt that also takes Enter on an empty query when accept says so, for
+// pickers whose arrow keys choose without typing
+char *editorPromptAccept(char *prompt, void (*callback)(char *, int),
+                         int (*accept)(char *)) {
   size_t bufsize = 128;
   char *buf = malloc(bufsize);
 
@@ -836,7 +2194,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
     editorSetStatusMessage(prompt, buf);
     editorRefreshScreen();
 
-    int c = editorReadKey();
+    int c = editorMacroKey();
     if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
       if (buflen != 0)
         buf[--buflen] = '\0';
@@ -845,7 +2203,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
       free(buf);
       return NULL;
     } else if (c == '\r' || c == CTRL_KEY('q')) {
-      if (buflen != 0) {
+      if (buflen != 0 || (accept && accept(buf))) {
         editorSetStatusMessage("");
         if (callback)
           callback(buf, c);
@@ -875,7 +2233,7 @@ void editorMoveCursor(int key) {
     if (E.cx != 0) {
       E.cx--;
     } else if (E.cy > 0) {
-      E.cy--;
+      E.cy = editorLayoutPrevRow(E.cy); // skipping folded rows
       E.cx = E.row[E.cy].size;
     }
     break;
@@ -884,19 +2242,19 @@ void editorMoveCursor(int key) {
     if (row && E.cx < row->size)
       E.cx++;
     else if (row && E.cx == row->size) {
-      E.cy++;
+      E.cy = editorLayoutNextRow(E.cy);
       E.cx = 0;
     }
     break;
   case ARROW_UP:
   case 'k':
     if (E.cy != 0)
-      E.cy--;
+      E.cy = editorLayoutPrevRow(E.cy);
     break;
   case ARROW_DOWN:
   case 'j':
     if (E.cy < E.numrows)
-      E.cy++;
+      E.cy = editorLayoutNextRow(E.cy);
     break;
   }
 
@@ -906,8 +2264,28 @@ void editorMoveCursor(int key) {
     E.cx = rowlen;
 }
 
+void editorPage(int key) {
+  if (E.wrap) { // page by display lines
+    editorLayoutPage(key == PAGE_UP ? -1 : 1);
+    return;
+  }
+
+  // move c up or down as many tms as needed
+  if (key == PAGE_UP) {
+    E.cy = E.rowoff;
+  } else if (key == PAGE_DOWN) { // the last row on screen
+    E.cy = E.rowoff;
+    for (int j = 1; j < E.screenrows && E.cy < E.numrows; j++)
+      E.cy = editorLayoutNextRow(E.cy);
+  }
+
+  int times = E.screenrows;
+  while (times--)
+    editorMoveCursor(key == PAGE_UP ? ARROW_UP : ARROW_DOWN);
+}
+
 void editorProcessKeypress() {
-  int c = editorReadKey();
+  int c = editorMacroKey();
 
   /* insert mode */
   if (E.mode == INSERT) {
@@ -938,19 +2316,9 @@ void editorProcessKeypress() {
       break;
 
     case PAGE_UP:
-    case PAGE_DOWN: { // move c up or down as many tms as needed
-      if (c == PAGE_UP) {
-        E.cy = E.rowoff;
-      } else if (c == PAGE_DOWN) {
-        E.cy = E.rowoff + E.screenrows - 1;
-        if (E.cy > E.numrows)
-          E.cy = E.numrows;
-      }
-
-      int times = E.screenrows;
-      while (times--)
-        editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-    } break;
+    case PAGE_DOWN:
+      editorPage(c);
+      break;
 
     case ARROW_UP:
     case ARROW_DOWN:
@@ -965,11 +2333,13 @@ void editorProcessKeypress() {
       E.mode = NORMAL;
       break;
 
-    default:
-      editorInsertChar(c);
+    case CTRL_KEY('n'):
+    case CTRL_KEY('p'):
+      editorComplete(c == CTRL_KEY('n') ? 1 : -1);
       break;
 
-    case CTRL_KEY('p'):
+    default:
+      editorInsertChar(c);
       break;
     }
   } else if (E.mode == NORMAL) { /* normal mode */
@@ -987,6 +2357,31 @@ void editorProcessKeypress() {
       editorInsertNewline(1);
       E.mode = INSERT;
     } break;
+    case '\t':
+      editorFoldToggle();
+      break;
+    case CTRL_KEY('w'):
+      editorWindowNext();
+      break;
+    case '\r':
+      editorGrepOpen();
+      break;
+    case 'q':
+      editorMacroRecord();
+      break;
+    case '@':
+      editorMacroPlay(editorMacroKey(), 1);
+      break;
+    case 'V':
+      editorYankVisual();
+      break;
+    case 'p':
+    case 'P':
+      editorYankPut(c == 'P');
+      break;
+    case '"':
+      editorYankRegister();
+      break;
 
     case HOME_KEY:
       E.cx = 0;
@@ -998,19 +2393,9 @@ void editorProcessKeypress() {
       break;
 
     case PAGE_UP:
-    case PAGE_DOWN: { // move c up or down as many tms as needed
-      if (c == PAGE_UP) {
-        E.cy = E.rowoff;
-      } else if (c == PAGE_DOWN) {
-        E.cy = E.rowoff + E.screenrows - 1;
-        if (E.cy > E.numrows)
-          E.cy = E.numrows;
-      }
-
-      int times = E.screenrows;
-      while (times--)
-        editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-    } break;
+    case PAGE_DOWN:
+      editorPage(c);
+      break;
 
     case ARROW_UP:
     case ARROW_DOWN:
@@ -1030,6 +2415,54 @@ void editorProcessKeypress() {
     case '\x1b':
       break;
     }
+  } else if (E.mode == VISUAL) { /* visual line mode */
+    switch (c) {
+    case '/':
+      editorFind();
+      break;
+    case 'y':
+      editorYank(0);
+      break;
+    case 'd':
+    case 'x':
+      editorYank(1);
+      break;
+    case '"':
+      editorYankRegister();
+      break;
+
+    case HOME_KEY:
+      E.cx = 0;
+      break;
+
+    case END_KEY:
+      if (E.cy < E.numrows)
+        E.cx = E.row[E.cy].size;
+      break;
+
+    case PAGE_UP:
+    case PAGE_DOWN:
+      editorPage(c);
+      break;
+
+    case ARROW_UP:
+    case ARROW_DOWN:
+    case ARROW_LEFT:
+    case ARROW_RIGHT:
+    case 'h':
+    case 'j':
+    case 'k':
+    case 'l':
+      editorMoveCursor(c);
+      break;
+
+    case 'V':
+    case CTRL_KEY('l'):
+    case '\x1b':
+    case CTRL_KEY('c'):
+      E.mode = NORMAL;
+      break;
+    }
   }
 }
 
@@ -1041,26 +2474,66 @@ void initEditor() {
   E.rx = 0;
   E.rowoff = 0;
   E.coloff = 0;
+  E.wrap = 0;
+  E.wrapoff = 0;
   E.numrows = 0;
+  E.rowcap = 0;
   E.row = NULL;
   E.dirty = 0;
   E.filename = NULL;
+  E.codec = NULL;
   E.statusmsg[0] = '\0';
   E.statusmsg_time = 0;
   E.syntax = NULL;
-  if (getWindowSize(&E.screenrows, &E.screencols) == -1)
+  int rows, cols;
+  if (getWindowSize(&rows, &cols) == -1)
     die("getWindowSiza");
-  E.screenrows -= 2;
+  editorWindowInit(rows, cols); // sets screenrows and screencols
+}
+
+// runs whenever no key arrived for a read timeout
+void editorIdle() {
+  editorJournalTick();
+  int changed = editorFollowTick();
+  changed |= editorStreamTick();
+  changed |= editorSpellTick();
+  changed |= editorCompleteTick();
+  changed |= editorDiffTick();
+  changed |= editorGrepTick();
+  if (changed)
+    editorRefreshScreen();
+}
+
+// the terminal changed size, a burst of changes comes here once
+void editorResize() {
+  int rows, cols;
+  if (getWindowSize(&rows, &cols) == -1)
+    return;
+  editorWindowResize(rows, cols);
+  editorRefreshScreen();
 }
 
 int main(int argc, char **argv) {
+  // peb - or a pipe on stdin edits the piped data
+  int stream = (argc >= 2 && !strcmp(argv[1], "-")) ||
+               (argc < 2 && !isatty(STDIN_FILENO));
+  if (stream && editorStreamOpen() == -1)
+    die("/dev/tty");
+
   enableRawMode();
   initEditor();
-  if (argc >= 2) {
+  editorOutputInit();
+  editorSetIdleHandler(editorIdle);
+  editorSetResizeHandler(editorResize);
+  if (stream) {
+    editorStreamWait(E.screenrows);
+  } else if (argc >= 2) {
     editorOpen(argv[1]);
   }
+  editorCompleteStart();
 
   while (1) {
+    editorStreamSlice();
     editorRefreshScreen();
     editorProcessKeypress();
   }
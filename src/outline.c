@@ -0,0 +1,457 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "outline.h"
+#include "term.h"
+
+#define OUTLINE_FENCE 0 // level of a ``` or ~~~ line
+
+struct outlineEntry {
+  int row;
+  int level; // 1 to 6 for headings
+
+  // taken by outlineScan, valid while O.scanned
+  int heading; // entry of the heading section the row is in, -1 for none
+  int fenced;  // the rows after it are in a code block
+  int end;     // for a heading, last row of its section, -1 for the last row
+};
+
+static struct {
+  struct outlineEntry *e; // sorted by row
+  int n;
+  int cap;
+  int scanned; // the sections in the entries match them
+  int first;   // row of the first heading outside code, -1 if none
+} O = {NULL, 0, 0, 0, -1};
+
+// heading level of a line, OUTLINE_FENCE for a code fence, -1 otherwise
+static int outlineLevel(const char *s, int len) {
+  int i = 0;
+  while (i < 3 && i < len && s[i] == ' ')
+    i++;
+  if (i + 3 <= len && (!strncmp(&s[i], "```", 3) || !strncmp(&s[i], "~~~", 3)))
+    return OUTLINE_FENCE;
+  int level = 0;
+  while (i + level < len && s[i + level] == '#')
+    level++;
+  if (level < 1 || level > 6)
+    return -1;
+  if (i + level < len && s[i + level] != ' ' && s[i + level] != '\t')
+    return -1; // #include or #tag
+  return level;
+}
+
+// first entry with a row >= row
+static int outlineFind(int row) {
+  int lo = 0, hi = O.n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (O.e[mid].row < row)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// returns whether the row became or stopped being a code fence
+int editorOutlineRowChanged(erow *row) {
+  int level = outlineLevel(row->chars, row->size);
+  int j = outlineFind(row->idx);
+  int found = (j < O.n && O.e[j].row == row->idx);
+  int fence = (found && O.e[j].level == OUTLINE_FENCE);
+
+  if (found && level != -1) {
+    O.scanned &= O.e[j].level == level;
+    O.e[j].level = level;
+  } else if (found) {
+    memmove(&O.e[j], &O.e[j + 1], sizeof(struct outlineEntry) * (O.n - j - 1));
+    O.n--;
+  } else if (level != -1) {
+    if (O.n == O.cap) {
+      O.cap = O.cap ? O.cap * 2 : 64;
+      O.e = realloc(O.e, sizeof(struct outlineEntry) * O.cap);
+    }
+    memmove(&O.e[j + 1], &O.e[j], sizeof(struct outlineEntry) * (O.n - j));
+    O.e[j].row = row->idx;
+    O.e[j].level = level;
+    O.n++;
+  }
+  if (found != (level != -1))
+    O.scanned = 0;
+  return fence != (level == OUTLINE_FENCE);
+}
+
+// n rows were inserted at at, the rows after them moved down
+void editorOutlineRowsInserted(int at, int n) {
+  for (int j = outlineFind(at); j < O.n; j++)
+    O.e[j].row += n;
+  O.scanned = 0;
+}
+
+// the rows [at, at + n) were deleted, returns whether one was a code fence
+int editorOutlineRowsDeleted(int at, int n) {
+  int j = outlineFind(at), k = j;
+  int fence = 0;
+  for (; k < O.n && O.e[k].row < at + n; k++)
+    fence |= (O.e[k].level == OUTLINE_FENCE);
+  memmove(&O.e[j], &O.e[k], sizeof(struct outlineEntry) * (O.n - k));
+  O.n -= k - j;
+  for (; j < O.n; j++)
+    O.e[j].row -= n;
+  O.scanned = 0;
+  return fence;
+}
+
+void editorOutlineReset() {
+  O.n = 0;
+  O.scanned = 0;
+}
+
+// last row of a section that goes on from entry j, before the next heading
+// of level or a higher one outside the code blocks, fenced if in one at j
+static int outlineSectionEnd(int j, int fenced, int level) {
+  for (; j < O.n; j++) {
+    if (O.e[j].level == OUTLINE_FENCE)
+      fenced = !fenced;
+    else if (!fenced && O.e[j].level <= level)
+      return O.e[j].row - 1;
+  }
+  return E.numrows - 1;
+}
+
+// the code block or heading section around row, for folding
+// a code block runs from fence to fence, a section from its heading to
+// before the next heading of the same or a higher level
+int editorOutlineSection(int row, int *start, int *end) {
+  int heading = -1, fence = -1; // entries of the open section and block
+  int j;
+  for (j = 0; j < O.n && O.e[j].row <= row; j++) {
+    if (O.e[j].level == OUTLINE_FENCE) {
+      if (fence == -1) {
+        fence = j;
+      } else if (O.e[j].row == row) { // on the closing fence
+        *start = O.e[fence].row;
+        *end = row;
+        return 1;
+      } else {
+        fence = -1;
+      }
+    } else if (fence == -1) {
+      heading = j;
+    }
+  }
+
+  if (fence != -1) { // inside a block, it ends at the next fence
+    *start = O.e[fence].row;
+    *end = (j < O.n) ? O.e[j].row : E.numrows - 1;
+    return 1;
+  }
+  if (heading == -1)
+    return 0;
+  *start = O.e[heading].row;
+  *end = outlineSectionEnd(j, 0, O.e[heading].level);
+  return 1;
+}
+
+// the section of every entry in one pass, the headings still open are kept
+// on a stack by level and a heading closes the ones of its level and deeper
+static void outlineScan() {
+  if (O.scanned)
+    return;
+  int open[7], depth = 0;
+  int heading = -1, fenced = 0;
+  O.first = -1;
+  for (int j = 0; j < O.n; j++) {
+    struct outlineEntry *e = &O.e[j];
+    if (e->level == OUTLINE_FENCE) {
+      fenced = !fenced;
+    } else if (!fenced) {
+      while (depth && O.e[open[depth - 1]].level >= e->level)
+        O.e[open[--depth]].end = e->row - 1;
+      open[depth++] = j;
+      e->end = -1;
+      heading = j;
+      if (O.first == -1)
+        O.first = e->row;
+    }
+    e->heading = heading;
+    e->fenced = fenced;
+  }
+  O.scanned = 1;
+}
+
+// the heading section row is in, code blocks included, or the text before
+// the first heading, O(log n) until the outline changes
+void editorOutlineHeading(int row, int *start, int *end) {
+  outlineScan();
+  int j = outlineFind(row + 1) - 1; // the last entry at or before row
+  int heading = j >= 0 ? O.e[j].heading : -1;
+  int last = heading != -1 ? O.e[heading].end
+             : O.first != -1 ? O.first - 1
+                             : -1;
+  *start = heading != -1 ? O.e[heading].row : 0;
+  *end = last != -1 ? last : E.numrows - 1;
+}
+
+// whether row is in a fenced code block, fences included, *end gets the last
+// row of the block or of the text before the next block
+int editorOutlineInCode(int row, int *end) {
+  int open = 0, j;
+  for (j = 0; j < O.n && O.e[j].row < row; j++)
+    if (O.e[j].level == OUTLINE_FENCE)
+      open = !open;
+  while (j < O.n && O.e[j].level != OUTLINE_FENCE)
+    j++; // the next fence, at or after row
+  if (!open && (j == O.n || O.e[j].row > row)) { // text up to that fence
+    *end = (j < O.n) ? O.e[j].row - 1 : E.numrows - 1;
+    return 0;
+  }
+  if (!open) // on an opening fence, the block ends at the one after
+    for (j++; j < O.n && O.e[j].level != OUTLINE_FENCE; j++)
+      ;
+  *end = (j < O.n) ? O.e[j].row : E.numrows - 1;
+  return 1;
+}
+
+/* picker */
+
+// headings matching the first k chars of the query, in row order
+struct outlineMatches {
+  int *h; // indexes into P.row
+  int n;
+  int best; // index into h of the best scored match, -1 if none
+};
+
+static struct {
+  // headings outside of code fences, in row order
+  int *row;
+  char *text; // lowercase heading texts back to back, contiguous for the scan
+  int *off;   // start and length of each text
+  int *len;
+  uint64_t *mask; // chars that appear in each text
+  int n;
+
+  struct outlineMatches *lv; // lv[k] matches query[0..k), a stack
+  int nlv;
+  int lvcap;
+  char *query;
+  int sel; // index into the top level, -1 before the first pick
+} P;
+
+static uint64_t outlineCharBit(unsigned char c) { return 1ULL << (c & 63); }
+
+static int outlineWordChar(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 128;
+}
+
+// fuzzy match, q has to be a subsequence of s, both lowercase
+// returns -1 if it isn't, otherwise higher for runs of matching chars,
+// matches at the start of words and matches early in s
+static int outlineScore(const char *q, const char *s, int len) {
+  int score = 0, run = 0, j = 0;
+  for (int i = 0; q[j] && i < len; i++) {
+    if (s[i] != q[j]) {
+      run = 0;
+      continue;
+    }
+    run++;
+    score += 1 + 2 * (run - 1);
+    if (i == 0 || !outlineWordChar(s[i - 1]))
+      score += 3;
+    if (j == 0)
+      score -= (i < 10) ? i : 10;
+    j++;
+  }
+  return q[j] ? -1 : score;
+}
+
+// collect the headings and their text once, every keystroke scans these
+static void outlinePickerInit() {
+  int fenced = 0, total = 0;
+  P.row = malloc(sizeof(int) * (O.n ? O.n : 1));
+  P.n = 0;
+  for (int j = 0; j < O.n; j++) {
+    if (O.e[j].level == OUTLINE_FENCE) {
+      fenced = !fenced;
+    } else if (!fenced) {
+      P.row[P.n++] = O.e[j].row;
+      total += E.row[O.e[j].row].size + 1;
+    }
+  }
+
+  P.text = malloc(total ? total : 1);
+  P.off = malloc(sizeof(int) * (P.n ? P.n : 1));
+  P.len = malloc(sizeof(int) * (P.n ? P.n : 1));
+  P.mask = malloc(sizeof(uint64_t) * (P.n ? P.n : 1));
+  int at = 0;
+  for (int j = 0; j < P.n; j++) {
+    erow *r = &E.row[P.row[j]];
+    int i = 0;
+    while (i < r->size && (r->chars[i] == ' ' || r->chars[i] == '#'))
+      i++;
+    P.off[j] = at;
+    P.len[j] = r->size - i;
+    P.mask[j] = 0;
+    for (; i < r->size; i++) {
+      unsigned char c = tolower((unsigned char)r->chars[i]);
+      P.text[at++] = c;
+      P.mask[j] |= outlineCharBit(c);
+    }
+    P.text[at++] = '\0';
+  }
+
+  // level 0, the empty query matches everything
+  P.lvcap = 16;
+  P.lv = malloc(sizeof(struct outlineMatches) * P.lvcap);
+  P.lv[0].h = malloc(sizeof(int) * (P.n ? P.n : 1));
+  for (int j = 0; j < P.n; j++)
+    P.lv[0].h[j] = j;
+  P.lv[0].n = P.n;
+  P.lv[0].best = -1;
+  P.nlv = 1;
+  P.query = strdup("");
+  P.sel = -1;
+}
+
+static void outlinePickerFree() {
+  for (int k = 0; k < P.nlv; k++)
+    free(P.lv[k].h);
+  free(P.lv);
+  free(P.row);
+  free(P.text);
+  free(P.off);
+  free(P.len);
+  free(P.mask);
+  free(P.query);
+}
+
+// narrow the top level by the next char of q, q holds the first nlv chars
+static void outlinePush(const char *q) {
+  if (P.nlv == P.lvcap) {
+    P.lvcap *= 2;
+    P.lv = realloc(P.lv, sizeof(struct outlineMatches) * P.lvcap);
+  }
+  struct outlineMatches *from = &P.lv[P.nlv - 1];
+  struct outlineMatches *to = &P.lv[P.nlv];
+  to->h = malloc(sizeof(int) * (from->n ? from->n : 1));
+  to->n = 0;
+  to->best = -1;
+
+  uint64_t qmask = 0;
+  for (int i = 0; q[i]; i++)
+    qmask |= outlineCharBit(q[i]);
+  int best_score = -1;
+  for (int j = 0; j < from->n; j++) {
+    int h = from->h[j];
+    if (qmask & ~P.mask[h]) // some char of q isn't in the heading at all
+      continue;
+    int score = outlineScore(q, &P.text[P.off[h]], P.len[h]);
+    if (score < 0)
+      continue;
+    if (score > best_score) {
+      best_score = score;
+      to->best = to->n;
+    }
+    to->h[to->n++] = h;
+  }
+  P.nlv++;
+}
+
+// bring the levels in line with query, backspace just pops levels
+static void outlineFilter(const char *query) {
+  int len = strlen(query);
+  char *q = malloc(len + 1);
+  for (int i = 0; i <= len; i++)
+    q[i] = tolower((unsigned char)query[i]);
+
+  int common = 0;
+  while (common < len && common + 1 < P.nlv && P.query[common] == q[common])
+    common++;
+  if (common == len && P.nlv == len + 1) { // some other key, keep the pick
+    free(q);
+    return;
+  }
+  while (P.nlv > common + 1)
+    free(P.lv[--P.nlv].h);
+  for (int k = common; k < len; k++) {
+    char c = q[k + 1];
+    q[k + 1] = '\0';
+    outlinePush(q);
+    q[k + 1] = c;
+  }
+
+  free(P.query);
+  P.query = q;
+  P.sel = P.lv[P.nlv - 1].best;
+}
+
+static void outlineJump(int h) {
+  E.cy = P.row[h];
+  E.cx = 0;
+}
+
+static void outlineCallback(char *query, int key) {
+  struct outlineMatches *m = &P.lv[P.nlv - 1];
+  if (key == '\r') {
+    if (P.sel >= 0)
+      outlineJump(m->h[P.sel]);
+    return;
+  }
+  if (key == ARROW_DOWN || key == ARROW_RIGHT || key == ARROW_UP ||
+      key == ARROW_LEFT) {
+    if (m->n == 0)
+      return;
+    int dir = (key == ARROW_DOWN || key == ARROW_RIGHT) ? 1 : -1;
+    if (P.sel < 0)
+      P.sel = (dir > 0) ? 0 : m->n - 1;
+    else
+      P.sel = (P.sel + dir + m->n) % m->n;
+    outlineJump(m->h[P.sel]);
+    return;
+  }
+
+  outlineFilter(query);
+  if (P.sel >= 0) // the empty query stays put until an arrow key
+    outlineJump(P.lv[P.nlv - 1].h[P.sel]);
+}
+
+// Enter takes a heading picked with the arrow keys before anything is typed
+static int outlinePicked(char *query) {
+  (void)query;
+  return P.sel >= 0;
+}
+
+// pick a heading by fuzzy search, arrow keys step through the matches in
+// document order
+void editorOutline() {
+  if (E.syntax && strcmp(E.syntax->filetype, "markdown")) {
+    editorSetStatusMessage("Outline is for markdown files");
+    return;
+  }
+
+  outlinePickerInit();
+  if (P.n == 0) {
+    editorSetStatusMessage("No headings");
+    outlinePickerFree();
+    return;
+  }
+
+  int saved_cx = E.cx, saved_cy = E.cy;
+  int saved_rowoff = E.rowoff, saved_coloff = E.coloff;
+  char *query = editorPromptAccept("Outline: %s (arrows for more)",
+                                   outlineCallback, outlinePicked);
+  if (query) {
+    free(query);
+  } else {
+    E.cx = saved_cx;
+    E.cy = saved_cy;
+    E.rowoff = saved_rowoff;
+    E.coloff = saved_coloff;
+  }
+  outlinePickerFree();
+}
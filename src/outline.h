@@ -0,0 +1,18 @@
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include "editor.h"
+
+// markdown heading outline
+// a sorted index of the heading and code fence rows, kept up to date by the
+// row operations, so :outline never has to scan the buffer
+int editorOutlineRowChanged(erow *row);
+void editorOutlineRowsInserted(int at, int n);
+int editorOutlineRowsDeleted(int at, int n);
+void editorOutlineReset();
+int editorOutlineSection(int row, int *start, int *end);
+void editorOutlineHeading(int row, int *start, int *end);
+int editorOutlineInCode(int row, int *end);
+void editorOutline();
+
+#endif // OUTLINE_H
@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "output.h"
+
+#define SYNC_BEGIN "\x1b[?2026h"
+#define SYNC_END "\x1b[?2026l"
+#define OUTPUT_PROBE_MS 500 // longest wait for the terminal to answer
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+
+static struct {
+  struct abuf buf[2];
+  int back;    // buffer the next frame is built in
+  int queued;  // buffer waiting for or being written by the thread, -1 if none
+  int sync;    // terminal supports synchronized updates
+  int threaded; // the writer thread is running
+} O = {{ABUF_INIT, ABUF_INIT}, 0, -1, 0, 0};
+
+// write all of iov, retrying short writes, EINTR and EAGAIN
+static int outputWritev(struct iovec *iov, int n) {
+  while (n > 0) {
+    ssize_t w = writev(STDOUT_FILENO, iov, n);
+    if (w == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) { // stdout is nonblocking
+        struct pollfd p = {STDOUT_FILENO, POLLOUT, 0};
+        poll(&p, 1, -1);
+        continue;
+      }
+      return -1;
+    }
+    while (n > 0 && (size_t)w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  return 0;
+}
+
+static void outputWriteFrame(struct abuf *ab) {
+  struct iovec iov[3];
+  int n = 0;
+  if (O.sync) {
+    iov[n].iov_base = SYNC_BEGIN;
+    iov[n++].iov_len = strlen(SYNC_BEGIN);
+  }
+  iov[n].iov_base = ab->b;
+  iov[n++].iov_len = ab->len;
+  if (O.sync) {
+    iov[n].iov_base = SYNC_END;
+    iov[n++].iov_len = strlen(SYNC_END);
+  }
+  outputWritev(iov, n); // nothing sensible to do if the terminal is gone
+}
+
+static void *outputWriter(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&lock);
+  while (1) {
+    while (O.queued == -1)
+      pthread_cond_wait(&changed, &lock);
+    struct abuf *ab = &O.buf[O.queued];
+    pthread_mutex_unlock(&lock);
+
+    outputWriteFrame(ab);
+
+    pthread_mutex_lock(&lock);
+    O.queued = -1;
+    pthread_cond_broadcast(&changed);
+  }
+  return NULL;
+}
+
+// ask for the state of mode 2026 (DECRQM) and the device attributes, every
+// terminal answers the latter so there is no need to wait out the timeout
+static int outputProbeSync() {
+  const char *q = "\x1b[?2026$p\x1b[c";
+  if (write(STDOUT_FILENO, q, strlen(q)) != (ssize_t)strlen(q))
+    return 0;
+
+  char buf[128];
+  int len = 0;
+  while (len < (int)sizeof(buf) - 1) {
+    struct pollfd p = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&p, 1, OUTPUT_PROBE_MS) <= 0 || read(STDIN_FILENO, &buf[len], 1) != 1)
+      break;
+    if (buf[len++] == 'c') // end of the device attributes
+      break;
+  }
+  buf[len] = '\0';
+
+  // \x1b[?2026;Ns$y, 1 set, 2 reset, 3 permanently set
+  char *r = strstr(buf, "\x1b[?2026;");
+  if (r == NULL)
+    return 0;
+  char mode = r[strlen("\x1b[?2026;")];
+  return mode >= '1' && mode <= '3';
+}
+
+// call in raw mode before the first frame
+void editorOutputInit() {
+  O.sync = outputProbeSync();
+  pthread_t t;
+  if (pthread_create(&t, NULL, outputWriter, NULL) == 0) {
+    pthread_detach(t);
+    O.threaded = 1;
+  }
+}
+
+// empty buffer to build the next frame in
+struct abuf *editorOutputFrame() {
+  O.buf[O.back].len = 0;
+  return &O.buf[O.back];
+}
+
+// hand the frame to the writer, only waits if the previous frame is still
+// being written
+void editorOutputSubmit() {
+  if (!O.threaded) {
+    outputWriteFrame(&O.buf[O.back]);
+    return;
+  }
+  pthread_mutex_lock(&lock);
+  while (O.queued != -1)
+    pthread_cond_wait(&changed, &lock);
+  O.queued = O.back;
+  pthread_cond_broadcast(&changed);
+  pthread_mutex_unlock(&lock);
+  O.back = !O.back;
+}
+
+// wait until every frame is on the terminal, before writing to it directly
+void editorOutputFlush() {
+  if (!O.threaded)
+    return;
+  pthread_mutex_lock(&lock);
+  while (O.queued != -1)
+    pthread_cond_wait(&changed, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+// send s to the terminal between two frames, for escapes that draw nothing
+void editorOutputWrite(const char *s, int len) {
+  editorOutputFlush();
+  struct iovec iov = {(void *)s, len};
+  outputWritev(&iov, 1);
+}
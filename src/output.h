@@ -0,0 +1,16 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "utility.h"
+
+// frames go to the terminal from a writer thread
+// there are two frame buffers, the next frame is built in one while the
+// other is still being written, each frame is wrapped in synchronized
+// update mode (DEC private mode 2026) when the terminal knows it
+void editorOutputInit();
+struct abuf *editorOutputFrame();
+void editorOutputSubmit();
+void editorOutputFlush();
+void editorOutputWrite(const char *s, int len);
+
+#endif // OUTPUT_H
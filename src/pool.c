@@ -0,0 +1,100 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define POOL_MAX_THREADS 16
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t work; // a new batch was posted
+  pthread_cond_t done; // the last job of a batch finished
+  int nthreads;        // workers, -1 until started
+  unsigned long gen;   // batch counter
+  void (*fn)(void *, int);
+  void *arg;
+  int njobs;
+  int next;     // next job to hand out
+  int finished; // jobs done in this batch
+} P = {PTHREAD_MUTEX_INITIALIZER,
+       PTHREAD_COND_INITIALIZER,
+       PTHREAD_COND_INITIALIZER,
+       -1,
+       0,
+       NULL,
+       NULL,
+       0,
+       0,
+       0};
+
+// take jobs of the current batch until none are left, called with lock held
+static void poolDrain() {
+  while (P.next < P.njobs) {
+    int job = P.next++;
+    void (*fn)(void *, int) = P.fn;
+    void *arg = P.arg;
+    pthread_mutex_unlock(&P.lock);
+    fn(arg, job);
+    pthread_mutex_lock(&P.lock);
+    if (++P.finished == P.njobs)
+      pthread_cond_signal(&P.done);
+  }
+}
+
+static void *poolWorker(void *unused) {
+  (void)unused;
+  unsigned long seen = 0;
+  pthread_mutex_lock(&P.lock);
+  while (1) {
+    while (P.gen == seen)
+      pthread_cond_wait(&P.work, &P.lock);
+    seen = P.gen;
+    poolDrain();
+  }
+  return NULL;
+}
+
+static void poolStart() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  if (n > POOL_MAX_THREADS)
+    n = POOL_MAX_THREADS;
+  P.nthreads = 0;
+  for (long i = 0; i < n; i++) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, poolWorker, NULL) != 0)
+      break;
+    pthread_detach(t);
+    P.nthreads++;
+  }
+}
+
+int poolThreads() {
+  if (P.nthreads < 0)
+    poolStart();
+  return P.nthreads + 1;
+}
+
+void poolRun(int njobs, void (*fn)(void *arg, int job), void *arg) {
+  if (P.nthreads < 0)
+    poolStart();
+  if (P.nthreads == 0 || njobs <= 1) { // nothing to hand off
+    for (int j = 0; j < njobs; j++)
+      fn(arg, j);
+    return;
+  }
+
+  pthread_mutex_lock(&P.lock);
+  P.fn = fn;
+  P.arg = arg;
+  P.njobs = njobs;
+  P.next = 0;
+  P.finished = 0;
+  P.gen++;
+  pthread_cond_broadcast(&P.work);
+  poolDrain();
+  while (P.finished < P.njobs)
+    pthread_cond_wait(&P.done, &P.lock);
+  pthread_mutex_unlock(&P.lock);
+}
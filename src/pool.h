@@ -0,0 +1,10 @@
+#ifndef POOL_H
+#define POOL_H
+
+// fixed pool of worker threads for fork/join style jobs
+// run fn(arg, job) for job = 0..njobs-1 and return once all are done
+// the calling thread works on jobs too, only call this from the main thread
+void poolRun(int njobs, void (*fn)(void *arg, int job), void *arg);
+int poolThreads();
+
+#endif // POOL_H
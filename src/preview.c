@@ -0,0 +1,817 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "preview.h"
+#include "table.h"
+#include "window.h"
+
+#define PREVIEW_MIN_COLS 20 // terminals under twice this get no pane
+
+// utf-8 of the box drawing and list marks
+#define BOX_H "\xe2\x94\x80"
+#define BOX_V "\xe2\x94\x82"
+#define BOX_TL "\xe2\x94\x8c"
+#define BOX_TR "\xe2\x94\x90"
+#define BOX_BL "\xe2\x94\x94"
+#define BOX_BR "\xe2\x94\x98"
+#define BOX_CROSS "\xe2\x94\xbc"
+#define MARK_BULLET "\xe2\x80\xa2"
+#define MARK_TODO "\xe2\x98\x90"
+#define MARK_DONE "\xe2\x98\x91"
+
+// styles of the laid out text, combined into one sgr sequence
+#define ST_BOLD (1 << 0)
+#define ST_EM (1 << 1)
+#define ST_CODE (1 << 2)
+#define ST_LINK (1 << 3)
+#define ST_HEAD (1 << 4)
+#define ST_UNDER (1 << 5)
+#define ST_DIM (1 << 6)
+
+// what a row starts, and the blocks made of them
+enum previewRow {
+  BLOCK_BLANK,
+  BLOCK_TEXT,
+  BLOCK_HEADING,
+  BLOCK_RULE,
+  BLOCK_FENCE,
+  BLOCK_ITEM,
+  BLOCK_QUOTE,
+  BLOCK_TABLE
+};
+
+struct previewBlock {
+  int start, n; // rows
+  int kind;     // previewRow of its first row
+  int stale;    // its rows changed, split them again before use
+
+  // layout, the screen lines one after another in text
+  int width; // columns it was laid out for, 0 if never
+  char *text;
+  int len;
+  int *line; // where each screen line starts in text
+  int nlines;
+};
+
+static struct {
+  int on;
+  struct previewBlock *b; // by start, together they cover every row
+  int n, cap;
+  int stale; // some block is stale or rows were added without a hook
+  uint64_t *drawn; // hash of every screen line as last sent
+  int rows;
+  int valid; // drawn matches the terminal
+} P;
+
+/* blocks */
+
+static int previewIndent(const char *s, int len) {
+  int i = 0;
+  while (i < len && (s[i] == ' ' || s[i] == '\t'))
+    i++;
+  return i;
+}
+
+static int previewRowKind(erow *row) {
+  const char *s = row->chars;
+  int len = row->size, i = previewIndent(s, len);
+  if (i == len)
+    return BLOCK_BLANK;
+  char c = s[i];
+  if (i + 3 <= len && (!strncmp(&s[i], "```", 3) || !strncmp(&s[i], "~~~", 3)))
+    return BLOCK_FENCE;
+  if (c == '#') {
+    int level = 0;
+    while (i + level < len && s[i + level] == '#')
+      level++;
+    if (level <= 6 && (i + level == len || s[i + level] == ' '))
+      return BLOCK_HEADING;
+  }
+  if (c == '-' || c == '*' || c == '_') { // ---, * * *
+    int marks = 0, j;
+    for (j = i; j < len && (s[j] == c || s[j] == ' '); j++)
+      marks += (s[j] == c);
+    if (j == len && marks >= 3)
+      return BLOCK_RULE;
+  }
+  if ((c == '-' || c == '*' || c == '+') && (i + 1 == len || s[i + 1] == ' '))
+    return BLOCK_ITEM;
+  if (isdigit((unsigned char)c)) {
+    int j = i;
+    while (j < len && isdigit((unsigned char)s[j]))
+      j++;
+    if (j < len && (s[j] == '.' || s[j] == ')') &&
+        (j + 1 == len || s[j + 1] == ' '))
+      return BLOCK_ITEM;
+  }
+  if (c == '>')
+    return BLOCK_QUOTE;
+  if (c == '|')
+    return BLOCK_TABLE;
+  return BLOCK_TEXT;
+}
+
+// rows of the block starting at row
+static int previewParse(int row, int *kind) {
+  *kind = previewRowKind(&E.row[row]);
+  int n = 1;
+  for (; row + n < E.numrows; n++) {
+    int k = previewRowKind(&E.row[row + n]);
+    if (*kind == BLOCK_FENCE) { // up to the closing fence
+      if (k == BLOCK_FENCE)
+        return n + 1;
+      continue;
+    }
+    int more =
+        (k == *kind && k != BLOCK_HEADING && k != BLOCK_RULE) ||
+        (k == BLOCK_TEXT && (*kind == BLOCK_ITEM || *kind == BLOCK_QUOTE));
+    if (!more)
+      break;
+  }
+  return n;
+}
+
+static void previewFreeLayout(struct previewBlock *b) {
+  free(b->text);
+  free(b->line);
+  b->text = NULL;
+  b->line = NULL;
+  b->len = b->nlines = 0;
+  b->width = 0;
+}
+
+// block holding row, the last one for rows past the end
+static int previewFind(int row) {
+  int lo = 0, hi = P.n;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (P.b[mid].start <= row)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// split the stale blocks again, together with the block before them that
+// they may join, and go on until the new blocks line up with an old one
+// that is still good, blocks that come out the same keep their layout
+static void previewSplit() {
+  if (!P.stale)
+    return;
+  P.stale = 0;
+
+  int covered = P.n ? P.b[P.n - 1].start + P.b[P.n - 1].n : 0;
+  if (covered != E.numrows) { // loaded without hooks, or dropped
+    if (!P.n) {
+      P.b = realloc(P.b, sizeof(struct previewBlock) * 16);
+      P.cap = 16;
+      memset(&P.b[0], 0, sizeof(struct previewBlock));
+      P.n = 1;
+    }
+    struct previewBlock *last = &P.b[P.n - 1];
+    last->n = E.numrows - last->start;
+    if (last->n < 0)
+      last->n = 0;
+    last->stale = 1;
+  }
+
+  struct previewBlock *nb = NULL;
+  int nn = 0, ncap = 0;
+  for (int i = 0; i < P.n; i++) {
+    if (!P.b[i].stale)
+      continue;
+    int first = i > 0 ? i - 1 : i;
+    int row = P.b[first].start, k = first;
+    nn = 0;
+    while (1) {
+      while (k < P.n && (P.b[k].start < row || !P.b[k].n)) // passed or empty
+        k++;
+      if (row >= E.numrows) {
+        k = P.n;
+        break;
+      }
+      if (nn && k < P.n && P.b[k].start == row && !P.b[k].stale)
+        break;
+
+      if (nn == ncap) {
+        ncap = ncap ? ncap * 2 : 16;
+        nb = realloc(nb, sizeof(struct previewBlock) * ncap);
+      }
+      struct previewBlock *b = &nb[nn++];
+      memset(b, 0, sizeof(struct previewBlock));
+      b->start = row;
+      b->n = previewParse(row, &b->kind);
+      struct previewBlock *old = k < P.n ? &P.b[k] : NULL;
+      if (old && old->start == row && old->n == b->n && old->kind == b->kind &&
+          !old->stale) { // the same block, keep what it was laid out to
+        *b = *old;
+        old->text = NULL;
+        old->line = NULL;
+      }
+      row += b->n;
+    }
+
+    for (int j = first; j < k; j++)
+      previewFreeLayout(&P.b[j]);
+    int grow = nn - (k - first);
+    if (P.n + grow > P.cap) {
+      while (P.n + grow > P.cap)
+        P.cap = P.cap ? P.cap * 2 : 16;
+      P.b = realloc(P.b, sizeof(struct previewBlock) * P.cap);
+    }
+    memmove(&P.b[first + nn], &P.b[k], sizeof(struct previewBlock) * (P.n - k));
+    memcpy(&P.b[first], nb, sizeof(struct previewBlock) * nn);
+    P.n += grow;
+    i = first + nn - 1;
+  }
+  free(nb);
+}
+
+/* layout */
+
+// the block being laid out
+static struct {
+  struct previewBlock *b;
+  int width; // columns of the pane
+  int limit; // columns text may take on this line
+  int col;
+  int style;
+  int linecap;
+  struct abuf text;
+} O;
+
+// text of the block with a style per byte, before it is wrapped
+static struct {
+  char *s;
+  unsigned char *st;
+  int len, cap;
+} T;
+
+static int previewCharLen(const char *s, int len) {
+  unsigned char c = *s;
+  int n = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+  return n < len ? n : len;
+}
+
+static void outStyle(int style) {
+  if (style == O.style)
+    return;
+  char buf[40] = "\x1b[0";
+  int len = 3;
+  static const struct {
+    int st;
+    const char *sgr;
+  } sgr[] = {{ST_BOLD, ";1"},    {ST_EM, ";3"},    {ST_CODE, ";36"},
+             {ST_LINK, ";4;34"}, {ST_HEAD, ";35"}, {ST_UNDER, ";4"},
+             {ST_DIM, ";2"}};
+  for (unsigned int j = 0; j < sizeof(sgr) / sizeof(sgr[0]); j++) {
+    if (style & sgr[j].st) {
+      strcpy(&buf[len], sgr[j].sgr);
+      len += strlen(sgr[j].sgr);
+    }
+  }
+  buf[len++] = 'm';
+  abAppend(&O.text, buf, len);
+  O.style = style;
+}
+
+static void outLine() {
+  struct previewBlock *b = O.b;
+  outStyle(0);
+  if (b->nlines == O.linecap) {
+    O.linecap = O.linecap ? O.linecap * 2 : 8;
+    b->line = realloc(b->line, sizeof(int) * O.linecap);
+  }
+  b->line[b->nlines++] = O.text.len;
+  O.col = 0;
+  O.limit = O.width;
+}
+
+// append text, cut at the limit of the line
+static void outPut(const char *s, int len, int style) {
+  for (int i = 0; i < len;) {
+    int n = previewCharLen(&s[i], len - i);
+    int w = s[i] == '\t' ? 1 : editorTableWidth(&s[i], n);
+    if (O.col + w > O.limit)
+      return;
+    outStyle(style);
+    abAppend(&O.text, s[i] == '\t' ? " " : &s[i], n);
+    O.col += w;
+    i += n;
+  }
+}
+
+static void outRepeat(const char *s, int n, int style) {
+  for (; n > 0; n--)
+    outPut(s, strlen(s), style);
+}
+
+static void textPut(const char *s, int n, int style) {
+  if (T.len + n > T.cap) {
+    while (T.len + n > T.cap)
+      T.cap = T.cap ? T.cap * 2 : 256;
+    T.s = realloc(T.s, T.cap);
+    T.st = realloc(T.st, T.cap);
+  }
+  memcpy(&T.s[T.len], s, n);
+  memset(&T.st[T.len], style, n);
+  T.len += n;
+}
+
+// the closing run of n marks c after i, -1 if there is none
+static int textClosing(const char *s, int len, int i, char c, int n) {
+  for (int j = i; j + n <= len; j++) {
+    if (s[j] == '\\') {
+      j++;
+      continue;
+    }
+    int run = 0;
+    while (j + run < len && s[j + run] == c)
+      run++;
+    if (run == n && s[j - 1] != ' ')
+      return j;
+    if (run)
+      j += run - 1;
+  }
+  return -1;
+}
+
+// markdown inline markup to styles: code spans, emphasis and links
+static void textInline(const char *s, int len, int style) {
+  for (int i = 0; i < len;) {
+    char c = s[i];
+    if (c == '\\' && i + 1 < len && ispunct((unsigned char)s[i + 1])) {
+      textPut(&s[i + 1], 1, style);
+      i += 2;
+      continue;
+    }
+    if (c == '`') {
+      int n = 0;
+      while (i + n < len && s[i + n] == '`')
+        n++;
+      int j = i + n;
+      while (j < len) {
+        int run = 0;
+        while (j + run < len && s[j + run] == '`')
+          run++;
+        if (run == n)
+          break;
+        j += run ? run : 1;
+      }
+      if (j < len) {
+        textPut(&s[i + n], j - i - n, style | ST_CODE);
+        i = j + n;
+        continue;
+      }
+    }
+    if ((c == '*' || c == '_') &&
+        !(c == '_' && i > 0 && isalnum((unsigned char)s[i - 1]))) {
+      int n = (i + 1 < len && s[i + 1] == c) ? 2 : 1;
+      int j = (i + n < len && s[i + n] != ' ')
+                  ? textClosing(s, len, i + n + 1, c, n)
+                  : -1;
+      if (j > 0) {
+        textInline(&s[i + n], j - i - n, style | (n == 2 ? ST_BOLD : ST_EM));
+        i = j + n;
+        continue;
+      }
+    }
+    if (c == '[' || (c == '!' && i + 1 < len && s[i + 1] == '[')) {
+      int open = i + (c == '!') + 1;
+      char *close = memchr(&s[open], ']', len - open);
+      int j = close ? close - s : len;
+      char *end = (j + 1 < len && s[j + 1] == '(')
+                      ? memchr(&s[j + 1], ')', len - j - 1)
+                      : NULL;
+      if (end) {
+        textInline(&s[open], j - open, style | ST_LINK);
+        i = end - s + 1;
+        continue;
+      }
+    }
+    textPut(&s[i], 1, style);
+    i++;
+  }
+}
+
+static void textRow(erow *row, int from, int style) {
+  from += previewIndent(&row->chars[from], row->size - from);
+  int to = row->size;
+  while (to > from && row->chars[to - 1] == ' ')
+    to--;
+  if (T.len && to > from)
+    textPut(" ", 1, style);
+  textInline(&row->chars[from], to - from, style);
+}
+
+// lay out the text in words over as many lines as it takes, first goes in
+// front of the first line and rest in front of the others
+static void outWrap(const char *first, const char *rest, int style) {
+  outLine();
+  outPut(first, strlen(first), style);
+  int lead = O.col;
+  for (int i = 0; i < T.len;) {
+    while (i < T.len && T.s[i] == ' ')
+      i++;
+    if (i == T.len)
+      break;
+    int j = i;
+    while (j < T.len && T.s[j] != ' ')
+      j++;
+    int w = editorTableWidth(&T.s[i], j - i);
+    if (O.col > lead && O.col + 1 + w > O.width) {
+      outLine();
+      outPut(rest, strlen(rest), style);
+      lead = O.col;
+    } else if (O.col > lead) {
+      outPut(" ", 1, T.st[i - 1] & T.st[i]);
+    }
+    while (i < j) { // words wider than the pane are split
+      int n = previewCharLen(&T.s[i], j - i);
+      int cw = editorTableWidth(&T.s[i], n);
+      if (O.col + cw > O.width && O.col > lead) {
+        outLine();
+        outPut(rest, strlen(rest), style);
+        lead = O.col;
+      }
+      outPut(&T.s[i], n, T.st[i]);
+      i += n;
+    }
+  }
+}
+
+static void layoutHeading(erow *row) {
+  const char *s = row->chars;
+  int i = previewIndent(s, row->size), level = 0, end = row->size;
+  while (i < end && s[i] == '#') {
+    i++;
+    level++;
+  }
+  while (end > i && (s[end - 1] == '#' || s[end - 1] == ' '))
+    end--;
+  int style =
+      ST_BOLD | (level <= 2 ? ST_HEAD : 0) | (level == 1 ? ST_UNDER : 0);
+  i += previewIndent(&s[i], end - i);
+  textInline(&s[i], end - i, style);
+  outWrap("", "", style);
+}
+
+static void layoutList(struct previewBlock *b) {
+  char first[64], rest[64];
+  for (int r = b->start; r < b->start + b->n; r++) {
+    erow *row = &E.row[r];
+    if (previewRowKind(row) != BLOCK_ITEM) {
+      textRow(row, 0, 0);
+      continue;
+    }
+    if (r > b->start)
+      outWrap(first, rest, 0);
+    T.len = 0;
+
+    const char *s = row->chars;
+    int indent = 0, i = 0;
+    for (; i < row->size && (s[i] == ' ' || s[i] == '\t'); i++)
+      indent += s[i] == '\t' ? 2 : 1;
+    if (indent > O.width / 2)
+      indent = O.width / 2;
+    if (indent > 32)
+      indent = 32;
+    int m = i;
+    while (m < row->size && s[m] != ' ')
+      m++;
+    const char *mark = MARK_BULLET;
+    int marklen = strlen(MARK_BULLET), markw = 1;
+    if (isdigit((unsigned char)s[i])) { // numbers stay as they are
+      mark = &s[i];
+      marklen = markw = (m - i < 16) ? m - i : 16;
+    }
+    int at = m + (m < row->size);
+    if (at + 3 <= row->size && s[at] == '[' && s[at + 2] == ']' &&
+        strchr(" xX", s[at + 1])) { // task list
+      mark = s[at + 1] == ' ' ? MARK_TODO : MARK_DONE;
+      marklen = strlen(mark);
+      markw = 1;
+      at += 3;
+    }
+    snprintf(first, sizeof(first), "%*s%.*s ", indent, "", marklen, mark);
+    snprintf(rest, sizeof(rest), "%*s", indent + markw + 1, "");
+    textRow(row, at, 0);
+  }
+  outWrap(first, rest, 0);
+}
+
+static void layoutCode(struct previewBlock *b) {
+  int last = b->start + b->n - 1;
+  int closed = b->n > 1 && previewRowKind(&E.row[last]) == BLOCK_FENCE;
+  int end = closed ? last : last + 1;
+
+  erow *fence = &E.row[b->start];
+  int li = previewIndent(fence->chars, fence->size) + 3;
+  while (li < fence->size &&
+         (fence->chars[li] == '`' || fence->chars[li] == '~'))
+    li++;
+  li += previewIndent(&fence->chars[li], fence->size - li);
+  int langlen = fence->size - li;
+  int langw = editorTableWidth(&fence->chars[li], langlen);
+
+  int inner = langlen ? langw + 2 : 0;
+  for (int r = b->start + 1; r < end; r++) {
+    int w = editorTableWidth(E.row[r].chars, E.row[r].size);
+    if (w > inner)
+      inner = w;
+  }
+  if (inner > O.width - 4)
+    inner = O.width - 4;
+
+  outLine();
+  outPut(BOX_TL BOX_H, strlen(BOX_TL BOX_H), ST_DIM);
+  if (langlen) {
+    outPut(" ", 1, ST_DIM);
+    O.limit = O.width - 3;
+    outPut(&fence->chars[li], langlen, ST_DIM);
+    O.limit = O.width;
+    outPut(" ", 1, ST_DIM);
+  }
+  outRepeat(BOX_H, inner + 3 - O.col, ST_DIM);
+  outPut(BOX_TR, strlen(BOX_TR), ST_DIM);
+  for (int r = b->start + 1; r < end; r++) {
+    outLine();
+    outPut(BOX_V " ", strlen(BOX_V " "), ST_DIM);
+    O.limit = inner + 2;
+    outPut(E.row[r].chars, E.row[r].size, ST_CODE);
+    O.limit = O.width;
+    outRepeat(" ", inner + 2 - O.col, 0);
+    outPut(" " BOX_V, strlen(" " BOX_V), ST_DIM);
+  }
+  if (closed) {
+    outLine();
+    outPut(BOX_BL, strlen(BOX_BL), ST_DIM);
+    outRepeat(BOX_H, inner + 2, ST_DIM);
+    outPut(BOX_BR, strlen(BOX_BR), ST_DIM);
+  }
+}
+
+static void layoutTable(struct previewBlock *b) {
+  struct tableCell *cells = NULL;
+  int ncells = 0, cap = 0, ncols = 0;
+  int *start = malloc(sizeof(int) * (b->n + 1));
+  for (int r = 0; r < b->n; r++) {
+    start[r] = ncells;
+    int n = editorTableSplit(&E.row[b->start + r], &cells, &ncells, &cap);
+    if (n > ncols)
+      ncols = n;
+  }
+  start[b->n] = ncells;
+
+  // the second row lines up the columns when it is all dashes
+  int delim = b->n > 1;
+  for (int c = delim ? start[1] : 0; delim && c < start[2]; c++) {
+    const char *s = &E.row[b->start + 1].chars[cells[c].start];
+    delim = cells[c].len > 0 && strspn(s, ":-") >= (size_t)cells[c].len;
+  }
+  int *width = calloc(ncols, sizeof(int));
+  char *align = calloc(ncols, 1); // 0 left, 1 right, 2 centered
+  for (int r = 0; r < b->n; r++) {
+    for (int c = start[r]; c < start[r + 1]; c++) {
+      int k = c - start[r];
+      if (delim && r == 1) {
+        const char *s = &E.row[b->start + 1].chars[cells[c].start];
+        align[k] = s[cells[c].len - 1] == ':' ? 1 + (s[0] == ':') : 0;
+      } else if (cells[c].width > width[k]) {
+        width[k] = cells[c].width;
+      }
+    }
+  }
+
+  for (int r = 0; r < b->n; r++) {
+    erow *row = &E.row[b->start + r];
+    outLine();
+    for (int k = 0; k < ncols; k++) {
+      const char *sep = delim && r == 1 ? BOX_H BOX_CROSS BOX_H : " " BOX_V " ";
+      if (k)
+        outPut(sep, strlen(sep), ST_DIM);
+      if (delim && r == 1) {
+        outRepeat(BOX_H, width[k], ST_DIM);
+        continue;
+      }
+      int c = start[r] + k;
+      int w = c < start[r + 1] ? cells[c].width : 0;
+      int before = align[k] == 1   ? width[k] - w
+                   : align[k] == 2 ? (width[k] - w) / 2
+                                   : 0;
+      outRepeat(" ", before, 0);
+      if (w)
+        outPut(&row->chars[cells[c].start], cells[c].len,
+               r == 0 && delim ? ST_BOLD : 0);
+      outRepeat(" ", width[k] - w - before, 0);
+    }
+  }
+  free(cells);
+  free(start);
+  free(width);
+  free(align);
+}
+
+// the screen lines of a block for a pane cols wide
+static void previewLayout(struct previewBlock *b, int cols) {
+  if (b->width == cols)
+    return;
+  previewFreeLayout(b);
+  O.b = b;
+  O.width = cols;
+  O.limit = cols;
+  O.col = 0;
+  O.style = 0;
+  O.linecap = 0;
+  O.text = (struct abuf)ABUF_INIT;
+  T.len = 0;
+
+  switch (b->kind) {
+  case BLOCK_BLANK:
+    outLine();
+    break;
+  case BLOCK_HEADING:
+    layoutHeading(&E.row[b->start]);
+    break;
+  case BLOCK_RULE:
+    outLine();
+    outRepeat(BOX_H, cols, ST_DIM);
+    break;
+  case BLOCK_FENCE:
+    layoutCode(b);
+    break;
+  case BLOCK_ITEM:
+    layoutList(b);
+    break;
+  case BLOCK_QUOTE:
+    for (int r = b->start; r < b->start + b->n; r++) {
+      erow *row = &E.row[r];
+      int i = previewIndent(row->chars, row->size);
+      if (i < row->size && row->chars[i] == '>')
+        i++;
+      textRow(row, i, ST_EM);
+    }
+    outWrap(BOX_V " ", BOX_V " ", ST_DIM);
+    break;
+  case BLOCK_TABLE:
+    layoutTable(b);
+    break;
+  default:
+    for (int r = b->start; r < b->start + b->n; r++)
+      textRow(&E.row[r], 0, 0);
+    outWrap("", "", 0);
+    break;
+  }
+  outStyle(0);
+  b->text = O.text.b;
+  b->len = O.text.len;
+  b->width = cols;
+}
+
+/* pane */
+
+int editorPreviewCols(int cols) {
+  return P.on && cols >= 2 * PREVIEW_MIN_COLS ? cols / 2 : 0;
+}
+
+static uint64_t previewHash(const char *s, int len, int cols) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ (uint64_t)cols; // fnv-1a
+  for (int i = 0; i < len; i++)
+    h = (h ^ (unsigned char)s[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+static void previewEmit(struct abuf *ab, int top, int left, int y,
+                        const char *s, int len, int cols) {
+  uint64_t h = previewHash(s, len, cols);
+  if (P.valid && P.drawn[y] == h)
+    return;
+  P.drawn[y] = h;
+  char buf[32];
+  int n = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", top + y + 1, left + 1);
+  abAppend(ab, buf, n);
+  abAppend(ab, s, len);
+  abAppend(ab, "\x1b[m\x1b[K", 6);
+}
+
+// the pane from the block of the top row of the active window, as far into
+// the block as that row is into its rows
+void editorPreviewDraw(struct abuf *ab, int top, int left, int rows, int cols) {
+  if (!editorPreviewCols(left + cols))
+    return;
+  previewSplit();
+  if (P.rows != rows) {
+    free(P.drawn);
+    P.drawn = calloc(rows, sizeof(uint64_t));
+    P.rows = rows;
+    P.valid = 0;
+  }
+
+  int j = P.n ? previewFind(E.rowoff) : 0, line = 0;
+  if (j < P.n) {
+    previewLayout(&P.b[j], cols);
+    if (P.b[j].n)
+      line = (long long)(E.rowoff - P.b[j].start) * P.b[j].nlines / P.b[j].n;
+  }
+  for (int y = 0; y < rows - 1; y++) {
+    while (j < P.n && line >= P.b[j].nlines) {
+      if (++j < P.n)
+        previewLayout(&P.b[j], cols);
+      line = 0;
+    }
+    if (j < P.n) {
+      struct previewBlock *b = &P.b[j];
+      int end = line + 1 < b->nlines ? b->line[line + 1] : b->len;
+      previewEmit(ab, top, left, y, &b->text[b->line[line]],
+                  end - b->line[line], cols);
+      line++;
+    } else {
+      previewEmit(ab, top, left, y, "", 0, cols);
+    }
+  }
+
+  struct abuf status = ABUF_INIT;
+  abAppend(&status, "\x1b[7m preview", 12);
+  for (int x = 8; x < cols; x++)
+    abAppend(&status, " ", 1);
+  previewEmit(ab, top, left, rows - 1, status.b, status.len, cols);
+  abFree(&status);
+  P.valid = 1;
+}
+
+void editorPreviewInvalidate() { P.valid = 0; }
+
+void editorPreviewStart() {
+  if (P.on)
+    return;
+  P.on = 1;
+  P.stale = 1;
+  editorWindowRelayout();
+}
+
+void editorPreviewStop() {
+  if (!P.on)
+    return;
+  editorPreviewReset();
+  free(P.drawn);
+  P.drawn = NULL;
+  P.rows = 0;
+  P.on = 0;
+  editorWindowRelayout();
+}
+
+/* row hooks */
+
+void editorPreviewRowChanged(erow *row) {
+  if (!P.on)
+    return;
+  P.stale = 1;
+  if (P.n && row->idx < P.b[P.n - 1].start + P.b[P.n - 1].n)
+    P.b[previewFind(row->idx)].stale = 1;
+}
+
+void editorPreviewRowsInserted(int at, int n) {
+  if (!P.on)
+    return;
+  P.stale = 1;
+  if (!P.n)
+    return;
+  int j = previewFind(at);
+  P.b[j].n += n;
+  P.b[j].stale = 1;
+  for (j++; j < P.n; j++)
+    P.b[j].start += n;
+}
+
+// the blocks lose the rows of [at, at + n) they held and move up by the ones
+// before them
+void editorPreviewRowsDeleted(int at, int n) {
+  if (!P.on || !P.n)
+    return;
+  P.stale = 1;
+  for (int j = previewFind(at); j < P.n; j++) {
+    struct previewBlock *b = &P.b[j];
+    int from = at > b->start ? at : b->start;
+    int to = at + n < b->start + b->n ? at + n : b->start + b->n;
+    if (to > from) {
+      b->n -= to - from;
+      b->stale = 1;
+    }
+    if (b->start > at)
+      b->start -= (b->start < at + n ? b->start : at + n) - at;
+  }
+}
+
+void editorPreviewReset() {
+  for (int j = 0; j < P.n; j++)
+    previewFreeLayout(&P.b[j]);
+  free(P.b);
+  P.b = NULL;
+  P.n = P.cap = 0;
+  P.stale = 1;
+  P.valid = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "editor.h"
+
+// rendered markdown next to the windows
+// the rows are split into blocks (paragraphs, headings, lists, quotes, code,
+// tables), each block keeps the screen lines it was laid out to, edits only
+// mark the blocks they touch and those are split again and laid out when they
+// next come into view, the pane starts at the block of the top row of the
+// active window so it scrolls with it
+void editorPreviewStart();
+void editorPreviewStop();
+int editorPreviewCols(int cols);
+void editorPreviewDraw(struct abuf *ab, int top, int left, int rows, int cols);
+void editorPreviewInvalidate();
+void editorPreviewRowChanged(erow *row);
+void editorPreviewRowsInserted(int at, int n);
+void editorPreviewRowsDeleted(int at, int n);
+void editorPreviewReset();
+
+#endif // PREVIEW_H
@@ -0,0 +1,563 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "regex.h"
+
+#define RE_MAX_POS 256 // max number of char positions in a pattern
+#define RE_MAX_WORDS (RE_MAX_POS / 64)
+#define RE_CHUNKS(m) (((m) + 7) / 8)
+
+enum reNodeType { RE_LIT = 0, RE_EMPTY, RE_CAT, RE_ALT, RE_STAR, RE_PLUS, RE_QUEST };
+
+struct reNode {
+  int type;
+  int left, right; // child nodes
+  int pos;         // position for RE_LIT
+};
+
+struct reParser {
+  const char *p;
+  const char *end;
+  const char *err;
+  struct reNode *nodes;
+  int nnodes;
+  int capnodes;
+  unsigned char classes[RE_MAX_POS][32]; // byte set per position
+  int npos;
+};
+
+struct regex {
+  int npos;
+  int words; // 64 bit words per state set
+  int anchor_start;
+  int anchor_end;
+  int nullable;
+  uint64_t first[RE_MAX_WORDS];
+  uint64_t last[RE_MAX_WORDS];
+  uint64_t *bmask;  // 256 * words, positions matching each byte
+  uint64_t *follow; // chunks * 256 * words, follow sets per 8 positions
+  unsigned char firstbyte[32]; // bytes that can start a match
+  char prefix[64];             // literal every match starts with
+  int prefixlen;
+};
+
+/* parsing */
+
+static int reNewNode(struct reParser *ps, int type, int left, int right) {
+  if (ps->nnodes == ps->capnodes) {
+    ps->capnodes = ps->capnodes ? ps->capnodes * 2 : 32;
+    ps->nodes = realloc(ps->nodes, sizeof(struct reNode) * ps->capnodes);
+  }
+  struct reNode *n = &ps->nodes[ps->nnodes];
+  n->type = type;
+  n->left = left;
+  n->right = right;
+  n->pos = -1;
+  return ps->nnodes++;
+}
+
+static void reSetBit(unsigned char *set, int c) {
+  set[(unsigned char)c >> 3] |= 1 << ((unsigned char)c & 7);
+}
+
+static int reHasBit(const unsigned char *set, int c) {
+  return set[(unsigned char)c >> 3] & (1 << ((unsigned char)c & 7));
+}
+
+// add the set for a \d \w \s style escape, returns 0 if c is no class escape
+static int reEscapeClass(unsigned char *set, int c) {
+  int neg = (c == 'D' || c == 'W' || c == 'S');
+  unsigned char tmp[32];
+  memset(tmp, 0, sizeof(tmp));
+  int i;
+  switch (c) {
+  case 'd':
+  case 'D':
+    for (i = '0'; i <= '9'; i++)
+      reSetBit(tmp, i);
+    break;
+  case 'w':
+  case 'W':
+    for (i = 0; i < 256; i++)
+      if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') ||
+          (i >= '0' && i <= '9') || i == '_')
+        reSetBit(tmp, i);
+    break;
+  case 's':
+  case 'S':
+    reSetBit(tmp, ' ');
+    reSetBit(tmp, '\t');
+    reSetBit(tmp, '\r');
+    reSetBit(tmp, '\n');
+    reSetBit(tmp, '\f');
+    reSetBit(tmp, '\v');
+    break;
+  default:
+    return 0;
+  }
+  for (i = 0; i < 32; i++)
+    set[i] |= neg ? ~tmp[i] : tmp[i];
+  return 1;
+}
+
+static int reEscapeChar(int c) {
+  switch (c) {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  default:
+    return c;
+  }
+}
+
+static int reNewPos(struct reParser *ps) {
+  if (ps->npos == RE_MAX_POS) {
+    ps->err = "pattern too long";
+    return -1;
+  }
+  memset(ps->classes[ps->npos], 0, 32);
+  int n = reNewNode(ps, RE_LIT, -1, -1);
+  ps->nodes[n].pos = ps->npos++;
+  return n;
+}
+
+static int reParseClass(struct reParser *ps) {
+  int n = reNewPos(ps);
+  if (n < 0)
+    return -1;
+  unsigned char *set = ps->classes[ps->nodes[n].pos];
+  int neg = 0;
+  if (ps->p < ps->end && *ps->p == '^') {
+    neg = 1;
+    ps->p++;
+  }
+  int first = 1;
+  while (ps->p < ps->end && (*ps->p != ']' || first)) {
+    int lo = (unsigned char)*ps->p++;
+    first = 0;
+    if (lo == '\\') {
+      if (ps->p == ps->end)
+        break;
+      int e = (unsigned char)*ps->p++;
+      if (reEscapeClass(set, e))
+        continue;
+      lo = reEscapeChar(e);
+    }
+    int hi = lo;
+    if (ps->p + 1 < ps->end && ps->p[0] == '-' && ps->p[1] != ']') {
+      hi = (unsigned char)ps->p[1];
+      ps->p += 2;
+      if (hi == '\\' && ps->p < ps->end)
+        hi = reEscapeChar((unsigned char)*ps->p++);
+    }
+    for (int c = lo; c <= hi; c++)
+      reSetBit(set, c);
+  }
+  if (ps->p == ps->end) {
+    ps->err = "missing ]";
+    return -1;
+  }
+  ps->p++; // skip ]
+  if (neg)
+    for (int i = 0; i < 32; i++)
+      set[i] = ~set[i];
+  return n;
+}
+
+static int reParseAlt(struct reParser *ps);
+
+static int reParseAtom(struct reParser *ps) {
+  int c = (unsigned char)*ps->p++;
+  int n;
+  switch (c) {
+  case '(':
+    n = reParseAlt(ps);
+    if (n < 0)
+      return -1;
+    if (ps->p == ps->end || *ps->p != ')') {
+      ps->err = "missing )";
+      return -1;
+    }
+    ps->p++;
+    return n;
+  case '[':
+    return reParseClass(ps);
+  case '*':
+  case '+':
+  case '?':
+    ps->err = "nothing to repeat";
+    return -1;
+  case '.':
+    if ((n = reNewPos(ps)) < 0)
+      return -1;
+    memset(ps->classes[ps->nodes[n].pos], 0xff, 32);
+    return n;
+  case '\\':
+    if (ps->p == ps->end) {
+      ps->err = "trailing \\";
+      return -1;
+    }
+    c = (unsigned char)*ps->p++;
+    if ((n = reNewPos(ps)) < 0)
+      return -1;
+    if (!reEscapeClass(ps->classes[ps->nodes[n].pos], c))
+      reSetBit(ps->classes[ps->nodes[n].pos], reEscapeChar(c));
+    return n;
+  default:
+    if ((n = reNewPos(ps)) < 0)
+      return -1;
+    reSetBit(ps->classes[ps->nodes[n].pos], c);
+    return n;
+  }
+}
+
+static int reParseRepeat(struct reParser *ps) {
+  int n = reParseAtom(ps);
+  while (n >= 0 && ps->p < ps->end &&
+         (*ps->p == '*' || *ps->p == '+' || *ps->p == '?')) {
+    int c = *ps->p++;
+    n = reNewNode(ps, c == '*' ? RE_STAR : c == '+' ? RE_PLUS : RE_QUEST, n,
+                  -1);
+  }
+  return n;
+}
+
+static int reParseCat(struct reParser *ps) {
+  int n = -1;
+  while (ps->p < ps->end && *ps->p != '|' && *ps->p != ')') {
+    int a = reParseRepeat(ps);
+    if (a < 0)
+      return -1;
+    n = (n < 0) ? a : reNewNode(ps, RE_CAT, n, a);
+  }
+  if (n < 0)
+    n = reNewNode(ps, RE_EMPTY, -1, -1);
+  return n;
+}
+
+static int reParseAlt(struct reParser *ps) {
+  int n = reParseCat(ps);
+  while (n >= 0 && ps->p < ps->end && *ps->p == '|') {
+    ps->p++;
+    int b = reParseCat(ps);
+    if (b < 0)
+      return -1;
+    n = reNewNode(ps, RE_ALT, n, b);
+  }
+  return n;
+}
+
+/* glushkov construction */
+
+// collect the leading literal chars of a concatenation
+static int rePrefix(struct reParser *ps, int n, char *out, int cap, int *len) {
+  struct reNode *node = &ps->nodes[n];
+  if (node->type == RE_CAT)
+    return rePrefix(ps, node->left, out, cap, len) &&
+           rePrefix(ps, node->right, out, cap, len);
+  if (node->type != RE_LIT || *len == cap)
+    return 0;
+
+  unsigned char *set = ps->classes[node->pos];
+  int found = -1;
+  for (int c = 0; c < 256; c++) {
+    if (reHasBit(set, c)) {
+      if (found != -1)
+        return 0;
+      found = c;
+    }
+  }
+  if (found == -1) // an empty class, nothing matches
+    return 0;
+  out[(*len)++] = found;
+  return 1;
+}
+
+struct regex *regexCompile(const char *pattern, const char **err) {
+  struct regex *re = calloc(1, sizeof(struct regex));
+  struct reParser *ps = calloc(1, sizeof(struct reParser));
+
+  int plen = strlen(pattern);
+  ps->p = pattern;
+  ps->end = pattern + plen;
+  if (ps->p < ps->end && *ps->p == '^') {
+    re->anchor_start = 1;
+    ps->p++;
+  }
+  if (ps->end > ps->p && ps->end[-1] == '$') {
+    // only an anchor if the $ is not escaped
+    int bs = 0;
+    for (const char *q = ps->end - 2; q >= ps->p && *q == '\\'; q--)
+      bs++;
+    if (bs % 2 == 0) {
+      re->anchor_end = 1;
+      ps->end--;
+    }
+  }
+
+  int root = reParseAlt(ps);
+  if (root >= 0 && ps->p != ps->end)
+    ps->err = "unmatched )";
+  if (ps->err) {
+    if (err)
+      *err = ps->err;
+    free(ps->nodes);
+    free(ps);
+    free(re);
+    return NULL;
+  }
+
+  int m = ps->npos;
+  int w = (m + 63) / 64;
+  if (w == 0)
+    w = 1;
+  re->npos = m;
+  re->words = w;
+
+  // first, last and nullable per node, nodes are in post order
+  uint64_t *first = calloc((size_t)ps->nnodes * w, sizeof(uint64_t));
+  uint64_t *last = calloc((size_t)ps->nnodes * w, sizeof(uint64_t));
+  char *nullable = calloc(ps->nnodes, 1);
+  uint64_t *follow = calloc((size_t)(m ? m : 1) * w, sizeof(uint64_t));
+
+  for (int i = 0; i < ps->nnodes; i++) {
+    struct reNode *n = &ps->nodes[i];
+    uint64_t *f = &first[i * w], *l = &last[i * w];
+    uint64_t *fa = NULL, *la = NULL, *fb = NULL, *lb = NULL;
+    if (n->left >= 0) {
+      fa = &first[n->left * w];
+      la = &last[n->left * w];
+    }
+    if (n->right >= 0) {
+      fb = &first[n->right * w];
+      lb = &last[n->right * w];
+    }
+    int k, p;
+
+    switch (n->type) {
+    case RE_LIT:
+      f[n->pos / 64] |= 1ULL << (n->pos % 64);
+      l[n->pos / 64] |= 1ULL << (n->pos % 64);
+      break;
+    case RE_EMPTY:
+      nullable[i] = 1;
+      break;
+    case RE_CAT:
+      for (p = 0; p < m; p++)
+        if (la[p / 64] & (1ULL << (p % 64)))
+          for (k = 0; k < w; k++)
+            follow[p * w + k] |= fb[k];
+      nullable[i] = nullable[n->left] && nullable[n->right];
+      for (k = 0; k < w; k++) {
+        f[k] = fa[k] | (nullable[n->left] ? fb[k] : 0);
+        l[k] = lb[k] | (nullable[n->right] ? la[k] : 0);
+      }
+      break;
+    case RE_ALT:
+      nullable[i] = nullable[n->left] || nullable[n->right];
+      for (k = 0; k < w; k++) {
+        f[k] = fa[k] | fb[k];
+        l[k] = la[k] | lb[k];
+      }
+      break;
+    case RE_STAR:
+    case RE_PLUS:
+    case RE_QUEST:
+      if (n->type != RE_QUEST)
+        for (p = 0; p < m; p++)
+          if (la[p / 64] & (1ULL << (p % 64)))
+            for (k = 0; k < w; k++)
+              follow[p * w + k] |= fa[k];
+      nullable[i] = (n->type == RE_PLUS) ? nullable[n->left] : 1;
+      memcpy(f, fa, w * sizeof(uint64_t));
+      memcpy(l, la, w * sizeof(uint64_t));
+      break;
+    }
+  }
+
+  re->nullable = nullable[root];
+  memcpy(re->first, &first[root * w], w * sizeof(uint64_t));
+  memcpy(re->last, &last[root * w], w * sizeof(uint64_t));
+
+  // byte masks
+  re->bmask = calloc((size_t)256 * w, sizeof(uint64_t));
+  for (int p = 0; p < m; p++)
+    for (int c = 0; c < 256; c++)
+      if (reHasBit(ps->classes[p], c))
+        re->bmask[c * w + p / 64] |= 1ULL << (p % 64);
+
+  for (int c = 0; c < 256; c++)
+    for (int k = 0; k < w; k++)
+      if (re->bmask[c * w + k] & re->first[k])
+        reSetBit(re->firstbyte, c);
+
+  // follow tables, one per 8 positions indexed by the state byte
+  int chunks = RE_CHUNKS(m);
+  re->follow = calloc((size_t)(chunks ? chunks : 1) * 256 * w, sizeof(uint64_t));
+  for (int ch = 0; ch < chunks; ch++) {
+    uint64_t *t = &re->follow[(size_t)ch * 256 * w];
+    for (int b = 1; b < 256; b++) {
+      int low = __builtin_ctz(b);
+      int p = ch * 8 + low;
+      for (int k = 0; k < w; k++)
+        t[b * w + k] = t[(b & (b - 1)) * w + k] | (p < m ? follow[p * w + k] : 0);
+    }
+  }
+
+  if (!re->anchor_start)
+    rePrefix(ps, root, re->prefix, sizeof(re->prefix), &re->prefixlen);
+
+  free(first);
+  free(last);
+  free(nullable);
+  free(follow);
+  free(ps->nodes);
+  free(ps);
+  return re;
+}
+
+void regexFree(struct regex *re) {
+  if (!re)
+    return;
+  free(re->bmask);
+  free(re->follow);
+  free(re);
+}
+
+/* matching */
+
+// d = follow(d) | (add_first ? first : 0), masked with byte c
+// returns nonzero if any state is left
+static int reStep(const struct regex *re, uint64_t *d, int c, int add_first) {
+  int w = re->words;
+  uint64_t next[RE_MAX_WORDS];
+  int k;
+
+  for (k = 0; k < w; k++)
+    next[k] = add_first ? re->first[k] : 0;
+  for (k = 0; k < w; k++) {
+    uint64_t bits = d[k];
+    int ch = k * 8;
+    while (bits) {
+      unsigned b = bits & 0xff;
+      if (b) {
+        const uint64_t *t = &re->follow[((size_t)ch * 256 + b) * w];
+        for (int j = 0; j < w; j++)
+          next[j] |= t[j];
+      }
+      bits >>= 8;
+      ch++;
+    }
+  }
+
+  const uint64_t *mask = &re->bmask[(unsigned char)c * w];
+  uint64_t any = 0;
+  for (k = 0; k < w; k++) {
+    d[k] = next[k] & mask[k];
+    any |= d[k];
+  }
+  return any != 0;
+}
+
+static int reAccepts(const struct regex *re, const uint64_t *d) {
+  for (int k = 0; k < re->words; k++)
+    if (d[k] & re->last[k])
+      return 1;
+  return 0;
+}
+
+// length of the longest match starting at st or -1
+static int reLongest(const struct regex *re, const char *s, int len, int st) {
+  uint64_t d[RE_MAX_WORDS] = {0};
+  int best = (re->nullable && (!re->anchor_end || st == len)) ? 0 : -1;
+
+  for (int i = st; i < len; i++) {
+    if (!reStep(re, d, s[i], i == st))
+      break;
+    if (reAccepts(re, d) && (!re->anchor_end || i + 1 == len))
+      best = i + 1 - st;
+  }
+  return best;
+}
+
+// end of the first match ending after from or -1
+static int reFirstEnd(const struct regex *re, const char *s, int len, int from) {
+  uint64_t d[RE_MAX_WORDS] = {0};
+  int active = 0;
+
+  if (re->nullable && !re->anchor_end)
+    return from;
+
+  for (int i = from; i < len; i++) {
+    if (!active) { // nothing in flight, skip to a byte that can start a match
+      while (i < len && !reHasBit(re->firstbyte, s[i]))
+        i++;
+      if (i == len)
+        break;
+    }
+    active = reStep(re, d, s[i], 1);
+    if (active && reAccepts(re, d) && (!re->anchor_end || i + 1 == len))
+      return i + 1;
+  }
+  return re->nullable ? len : -1;
+}
+
+int regexSearch(const struct regex *re, const char *s, int len, int from,
+                int *mstart, int *mlen) {
+  int st = -1, n = -1;
+
+  if (from > len)
+    return 0;
+
+  if (re->anchor_start) {
+    if (from == 0 && (n = reLongest(re, s, len, 0)) >= 0)
+      st = 0;
+  } else if (re->prefixlen) { // let memmem find the candidates
+    int at = from;
+    while (at + re->prefixlen <= len) {
+      const char *hit = memmem(&s[at], len - at, re->prefix, re->prefixlen);
+      if (!hit)
+        break;
+      at = hit - s;
+      if ((n = reLongest(re, s, len, at)) >= 0) {
+        st = at;
+        break;
+      }
+      at++;
+    }
+  } else {
+    int end = reFirstEnd(re, s, len, from);
+    if (end < 0)
+      return 0;
+    if (!mstart && !mlen)
+      return 1;
+    // a match ends at end, so the leftmost one starts at or before it
+    for (int at = from; at <= end; at++) {
+      if (at < len && !re->nullable && !reHasBit(re->firstbyte, s[at]))
+        continue;
+      if ((n = reLongest(re, s, len, at)) >= 0) {
+        st = at;
+        break;
+      }
+    }
+  }
+
+  if (st < 0)
+    return 0;
+  if (mstart)
+    *mstart = st;
+  if (mlen)
+    *mlen = n;
+  return 1;
+}
+
+int regexLiteral(const struct regex *re, const char **lit) {
+  *lit = re->prefix;
+  return re->prefixlen;
+}
@@ -0,0 +1,20 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+// small regex engine used by search
+// supports . [] [^] * + ? | () ^ $ and the \d \w \s escapes
+// patterns are compiled into a bit-parallel glushkov automaton
+struct regex;
+
+struct regex *regexCompile(const char *pattern, const char **err);
+void regexFree(struct regex *re);
+
+// search s[from..len) for the leftmost longest match
+// returns 1 on a match, mstart and mlen may be NULL if only a yes/no is needed
+int regexSearch(const struct regex *re, const char *s, int len, int from,
+                int *mstart, int *mlen);
+
+// literal every match starts with, so callers can prefilter big inputs
+int regexLiteral(const struct regex *re, const char **lit);
+
+#endif // REGEX_H
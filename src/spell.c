@@ -0,0 +1,814 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "layout.h"
+#include "outline.h"
+#include "spell.h"
+
+#define SPELL_DICT "/usr/share/dict/words"
+#define SPELL_MAGIC 0x44424550 // "PEBD"
+#define SPELL_VERSION 1
+#define SPELL_MAX_WORD 64             // longer words are never in the list
+#define SPELL_QUEUE_BYTES (256 << 10) // row text handed to the worker per tick
+
+// an edge of the dawg, the edges of a node are consecutive and sorted by char
+#define EDGE_CHAR(e) ((e) & 0xff)
+#define EDGE_LAST (1u << 8)    // last edge of its node
+#define EDGE_FINAL (1u << 9)   // a word ends after this edge
+#define EDGE_TO(e) ((e) >> 10) // first edge of the next node, 0 if none
+#define EDGE_MAX ((1u << 22) - 1)
+
+// the compiled word list, the edges follow
+struct spellHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t root; // first edge of the root node
+  uint32_t nedges;
+  int64_t size; // size and mtime of the word list it was built from
+  int64_t mtime;
+};
+
+// a row copy for the worker, only the words overlapping [from, to) are checked
+struct spellJob {
+  struct spellJob *next;
+  int row; // moves with inserted and deleted rows, -1 to drop the result
+  int full;
+  int from, to;
+  int *bad; // start and length of each misspelled word
+  int nbad;
+  int len;
+  char text[];
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER;
+
+static struct {
+  int on;
+  int quiet;   // turned on for the filetype, a missing word list is fine
+  int started; // the worker is running
+  int dict;    // 0 while loading, 1 loaded, -1 no word list
+  const uint32_t *edges;
+  uint32_t nedges;
+  uint32_t root;
+
+  // jobs, the queue and busy belong to the worker, done to the main thread
+  struct spellJob *queue, *queue_tail, *busy, *done, *done_tail;
+  int queued; // bytes waiting in the queue
+
+  int next;  // rows before it are queued or checked, unless on screen
+  int stale; // rows from here may have moved in or out of a code block
+  int code, code_from, code_to; // the last answer of editorOutlineInCode
+} S = {0, 0, 0, 0, NULL, 0, 0, NULL, NULL, NULL, NULL, NULL, 0,
+       0, INT_MAX, 0, -1, -1};
+
+/* dawg */
+
+static int spellLookup(const unsigned char *w, int len) {
+  uint32_t at = S.root;
+  uint32_t e = 0;
+  for (int i = 0; i < len; i++) {
+    if (at == 0)
+      return 0;
+    for (;; at++) {
+      if (at >= S.nedges)
+        return 0;
+      e = S.edges[at];
+      if (EDGE_CHAR(e) == w[i])
+        break;
+      if (EDGE_CHAR(e) > w[i] || (e & EDGE_LAST))
+        return 0;
+    }
+    at = EDGE_TO(e);
+  }
+  return (e & EDGE_FINAL) != 0;
+}
+
+// a trie node while building, minimized nodes are kept in a hash set so
+// equal suffixes are shared
+struct spellNode {
+  unsigned char *ch;
+  int *to;
+  int n, cap;
+  int final;
+};
+
+static struct {
+  struct spellNode *node;
+  int nnodes, cap;
+  int *unused; // ids of merged nodes
+  int nunused, unused_cap;
+  int *set; // ids of minimized nodes, -1 for an empty slot
+  int nset, set_cap;
+} B;
+
+static int spellNewNode() {
+  int id;
+  if (B.nunused) {
+    id = B.unused[--B.nunused];
+  } else {
+    if (B.nnodes == B.cap) {
+      B.cap = B.cap ? B.cap * 2 : 1024;
+      B.node = realloc(B.node, sizeof(struct spellNode) * B.cap);
+    }
+    id = B.nnodes++;
+  }
+  memset(&B.node[id], 0, sizeof(struct spellNode));
+  return id;
+}
+
+static void spellAddEdge(int id, unsigned char c, int to) {
+  struct spellNode *n = &B.node[id];
+  if (n->n == n->cap) {
+    n->cap = n->cap ? n->cap * 2 : 2;
+    n->ch = realloc(n->ch, n->cap);
+    n->to = realloc(n->to, sizeof(int) * n->cap);
+  }
+  n->ch[n->n] = c;
+  n->to[n->n++] = to;
+}
+
+static uint32_t spellNodeHash(int id) {
+  struct spellNode *n = &B.node[id];
+  uint32_t h = 2166136261u ^ n->final; // fnv-1a
+  for (int k = 0; k < n->n; k++)
+    h = ((h ^ n->ch[k]) * 16777619u ^ n->to[k]) * 16777619u;
+  return h;
+}
+
+static int spellNodeSame(int a, int b) {
+  struct spellNode *x = &B.node[a], *y = &B.node[b];
+  return x->final == y->final && x->n == y->n &&
+         !memcmp(x->ch, y->ch, x->n) &&
+         !memcmp(x->to, y->to, sizeof(int) * x->n);
+}
+
+static void spellSetGrow() {
+  int *old = B.set, cap = B.set_cap;
+  B.set_cap = cap ? cap * 2 : 1024;
+  B.set = malloc(sizeof(int) * B.set_cap);
+  memset(B.set, -1, sizeof(int) * B.set_cap);
+  for (int k = 0; k < cap; k++) {
+    if (old[k] == -1)
+      continue;
+    uint32_t s = spellNodeHash(old[k]) & (B.set_cap - 1);
+    while (B.set[s] != -1)
+      s = (s + 1) & (B.set_cap - 1);
+    B.set[s] = old[k];
+  }
+  free(old);
+}
+
+// the minimized node equal to id, which is id itself if there was none
+static int spellMinimized(int id) {
+  if (2 * (B.nset + 1) > B.set_cap)
+    spellSetGrow();
+  uint32_t s = spellNodeHash(id) & (B.set_cap - 1);
+  for (; B.set[s] != -1; s = (s + 1) & (B.set_cap - 1))
+    if (spellNodeSame(B.set[s], id))
+      return B.set[s];
+  B.set[s] = id;
+  B.nset++;
+  return id;
+}
+
+// minimize the nodes of the last word below depth keep, deepest first
+static void spellMinimize(int *path, int depth, int keep) {
+  for (int d = depth; d > keep; d--) {
+    int same = spellMinimized(path[d]);
+    if (same == path[d])
+      continue;
+    struct spellNode *parent = &B.node[path[d - 1]];
+    parent->to[parent->n - 1] = same;
+    free(B.node[path[d]].ch);
+    free(B.node[path[d]].to);
+    memset(&B.node[path[d]], 0, sizeof(struct spellNode));
+    if (B.nunused == B.unused_cap) {
+      B.unused_cap = B.unused_cap ? B.unused_cap * 2 : 64;
+      B.unused = realloc(B.unused, sizeof(int) * B.unused_cap);
+    }
+    B.unused[B.nunused++] = path[d];
+  }
+}
+
+// lay out the edges of node id after its children, returns its first edge
+static uint32_t spellEmit(int id, uint32_t *first, uint32_t **out, int *n,
+                          int *cap) {
+  struct spellNode *node = &B.node[id];
+  if (node->n == 0 || *n > (int)EDGE_MAX)
+    return 0;
+  if (first[id])
+    return first[id];
+  uint32_t to[256];
+  for (int k = 0; k < node->n; k++)
+    to[k] = spellEmit(node->to[k], first, out, n, cap);
+  if (*n + node->n > (int)EDGE_MAX) {
+    *n = EDGE_MAX + 1; // too big, the caller checks *n
+    return 0;
+  }
+  if (*n + node->n > *cap) {
+    while (*n + node->n > *cap)
+      *cap *= 2;
+    *out = realloc(*out, sizeof(uint32_t) * *cap);
+  }
+  first[id] = *n;
+  for (int k = 0; k < node->n; k++) {
+    uint32_t e = node->ch[k] | (to[k] << 10);
+    if (B.node[node->to[k]].final)
+      e |= EDGE_FINAL;
+    if (k == node->n - 1)
+      e |= EDGE_LAST;
+    (*out)[(*n)++] = e;
+  }
+  return first[id];
+}
+
+static int spellCompare(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// the dawg of a word list, one word per line, hunspell .dic flags after a
+// slash are ignored, returns the header followed by the edges or NULL
+static struct spellHeader *spellBuild(char *buf, long long len,
+                                      size_t *size) {
+  int nwords = 0, cap = 1024;
+  char **words = malloc(sizeof(char *) * cap);
+  for (char *p = buf, *end = buf + len; p < end;) {
+    char *nl = memchr(p, '\n', end - p);
+    char *e = nl ? nl : end;
+    *e = '\0';
+    p[strcspn(p, "/\r\t ")] = '\0';
+    if (*p && strlen(p) <= SPELL_MAX_WORD) {
+      if (nwords == cap)
+        words = realloc(words, sizeof(char *) * (cap *= 2));
+      words[nwords++] = p;
+    }
+    p = e + 1;
+  }
+  qsort(words, nwords, sizeof(char *), spellCompare);
+
+  memset(&B, 0, sizeof(B));
+  int path[SPELL_MAX_WORD + 1];
+  path[0] = spellNewNode();
+  const char *prev = "";
+  int prevlen = 0;
+  for (int w = 0; w < nwords; w++) {
+    const char *s = words[w];
+    int n = strlen(s), common = 0;
+    while (common < n && common < prevlen && s[common] == prev[common])
+      common++;
+    if (common == n && n == prevlen)
+      continue; // duplicate
+    spellMinimize(path, prevlen, common);
+    for (int d = common; d < n; d++) {
+      int child = spellNewNode();
+      spellAddEdge(path[d], s[d], child);
+      path[d + 1] = child;
+    }
+    B.node[path[n]].final = 1;
+    prev = s;
+    prevlen = n;
+  }
+  spellMinimize(path, prevlen, 0);
+  free(words);
+
+  int n = 1, outcap = 1024; // edge 0 means no node
+  uint32_t *out = calloc(outcap, sizeof(uint32_t));
+  uint32_t *first = calloc(B.nnodes, sizeof(uint32_t));
+  uint32_t root = spellEmit(path[0], first, &out, &n, &outcap);
+  free(first);
+  for (int k = 0; k < B.nnodes; k++) {
+    free(B.node[k].ch);
+    free(B.node[k].to);
+  }
+  free(B.node);
+  free(B.unused);
+  free(B.set);
+  if (root == 0 || n > (int)EDGE_MAX) { // empty or too big
+    free(out);
+    return NULL;
+  }
+
+  *size = sizeof(struct spellHeader) + sizeof(uint32_t) * n;
+  struct spellHeader *h = malloc(*size);
+  h->magic = SPELL_MAGIC;
+  h->version = SPELL_VERSION;
+  h->root = root;
+  h->nedges = n;
+  memcpy(h + 1, out, sizeof(uint32_t) * n);
+  free(out);
+  return h;
+}
+
+static void spellUse(const struct spellHeader *h) {
+  S.edges = (const uint32_t *)(h + 1);
+  S.nedges = h->nedges;
+  S.root = h->root;
+}
+
+// map the compiled list in file if it was built from a word list like src
+static int spellMap(const char *file, struct stat *src) {
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return 0;
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > (off_t)sizeof(struct spellHeader))
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return 0;
+  const struct spellHeader *h = map;
+  if (h->magic != SPELL_MAGIC || h->version != SPELL_VERSION ||
+      h->size != src->st_size || h->mtime != src->st_mtime ||
+      sizeof(*h) + sizeof(uint32_t) * h->nedges != (size_t)st.st_size ||
+      h->root >= h->nedges) {
+    munmap(map, st.st_size);
+    return 0;
+  }
+  spellUse(h);
+  return 1;
+}
+
+// map the compiled word list, compiling it first if it is missing or older
+// than the list, without a cache directory it stays in memory
+static int spellLoad() {
+  const char *path = getenv("PEB_DICT");
+  if (!path || !*path)
+    path = SPELL_DICT;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd == -1)
+    return 0;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return 0;
+  }
+  char *file = editorCachePath(path, ".dawg");
+  if (file && spellMap(file, &st)) {
+    close(fd);
+    free(file);
+    return 1;
+  }
+
+  char *buf = malloc(st.st_size + 1);
+  long long got = 0;
+  ssize_t r;
+  while (got < st.st_size && (r = read(fd, buf + got, st.st_size - got)) > 0)
+    got += r;
+  close(fd);
+  size_t size;
+  struct spellHeader *h = spellBuild(buf, got, &size);
+  free(buf);
+  if (!h) {
+    free(file);
+    return 0;
+  }
+  h->size = st.st_size;
+  h->mtime = st.st_mtime;
+
+  int ok = 0;
+  if (file) { // write it next to the other caches and map that
+    char *tmp = malloc(strlen(file) + 5);
+    sprintf(tmp, "%s.tmp", file);
+    int out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (out != -1) {
+      ok = write(out, h, size) == (ssize_t)size;
+      close(out);
+      ok = ok && rename(tmp, file) == 0 && spellMap(file, &st);
+      if (!ok)
+        unlink(tmp);
+    }
+    free(tmp);
+    free(file);
+  }
+  if (ok)
+    free(h);
+  else
+    spellUse(h); // kept for good
+  return 1;
+}
+
+/* checking */
+
+static int spellWordChar(unsigned char c) {
+  return isalpha(c) || c >= 0x80 || c == '\'';
+}
+
+static int spellKnown(const unsigned char *w, int len) {
+  if (spellLookup(w, len))
+    return 1;
+  int upper = 0, letters = 0;
+  unsigned char low[SPELL_MAX_WORD];
+  for (int i = 0; i < len; i++) {
+    letters += isalpha(w[i]) != 0;
+    upper += isupper(w[i]) != 0;
+    low[i] = tolower(w[i]);
+  }
+  if (upper && upper == letters)
+    return 1; // acronyms
+  if (upper > 1 || (upper == 1 && !isupper(w[0])))
+    return 1; // camelCase and names like iPhone
+  if (upper && spellLookup(low, len))
+    return 1; // capitalized at the start of a sentence
+  if (len > 2 && w[len - 2] == '\'' && tolower(w[len - 1]) == 's')
+    return spellKnown(w, len - 2);
+  return 0;
+}
+
+// whether the char next to a word makes it part of a number, name or path
+static int spellJoined(const unsigned char *s, int len, int i) {
+  if (i < 0 || i >= len)
+    return 0;
+  if (isdigit(s[i]) || strchr("_/\\@$%&=+*<>~", s[i]))
+    return 1;
+  return s[i] == '.' && i + 1 < len && isalnum(s[i + 1]) && i > 0 &&
+         isalnum(s[i - 1]); // file.txt or e.g
+}
+
+static void spellBad(struct spellJob *j, int start, int len) {
+  if (j->nbad % 16 == 0)
+    j->bad = realloc(j->bad, sizeof(int) * 2 * (j->nbad + 16));
+  j->bad[2 * j->nbad] = start;
+  j->bad[2 * j->nbad + 1] = len;
+  j->nbad++;
+}
+
+static void spellCheck(struct spellJob *j) {
+  const unsigned char *s = (const unsigned char *)j->text;
+  int len = j->len;
+  int i = 0;
+  while (i < len) {
+    unsigned char c = s[i];
+    if (c == '`') { // code span, it closes with as many backticks
+      int n = 0;
+      while (i + n < len && s[i + n] == '`')
+        n++;
+      int k = i + n;
+      while (k < len) {
+        int m = 0;
+        while (k + m < len && s[k + m] == '`')
+          m++;
+        if (m == n)
+          break;
+        k += m ? m : 1;
+      }
+      i = (k < len) ? k + n : i + n;
+      continue;
+    }
+    if ((c == ']' && i + 1 < len && s[i + 1] == '(') ||
+        (c == ':' && i + 2 < len && s[i + 1] == '/' && s[i + 2] == '/')) {
+      while (i < len && s[i] != ')' && s[i] != ' ')
+        i++; // link target or url
+      continue;
+    }
+    if (c == '<' && i + 1 < len && (isalpha(s[i + 1]) || s[i + 1] == '/')) {
+      const unsigned char *gt = memchr(&s[i], '>', len - i);
+      i = gt ? gt - s + 1 : i + 1; // html tag
+      continue;
+    }
+    if (!spellWordChar(c) || c == '\'') {
+      i++;
+      continue;
+    }
+
+    int start = i;
+    while (i < len && spellWordChar(s[i]))
+      i++;
+    int end = i;
+    while (s[end - 1] == '\'')
+      end--;
+    if (end - start < 2 || end - start > SPELL_MAX_WORD ||
+        spellJoined(s, len, start - 1) || spellJoined(s, len, i))
+      continue;
+    if (end > j->from && start < j->to && !spellKnown(&s[start], end - start))
+      spellBad(j, start, end - start);
+  }
+}
+
+static void *spellWorker(void *arg) {
+  (void)arg;
+  int loaded = spellLoad();
+  pthread_mutex_lock(&lock);
+  S.dict = loaded ? 1 : -1;
+  while (1) {
+    while (!S.queue)
+      pthread_cond_wait(&work, &lock);
+    struct spellJob *j = S.queue;
+    S.queue = j->next;
+    if (!S.queue)
+      S.queue_tail = NULL;
+    S.queued -= j->len;
+    S.busy = j;
+    pthread_mutex_unlock(&lock);
+
+    if (loaded)
+      spellCheck(j);
+
+    pthread_mutex_lock(&lock);
+    S.busy = NULL;
+    j->next = NULL;
+    if (S.done_tail)
+      S.done_tail->next = j;
+    else
+      S.done = j;
+    S.done_tail = j;
+  }
+  return NULL;
+}
+
+/* rows */
+
+// whether row is in a fenced code block, the stretch around the last row
+// asked for is remembered since rows are mostly asked for in order
+static int spellInCode(int row) {
+  if (row < S.code_from || row > S.code_to) {
+    S.code = editorOutlineInCode(row, &S.code_to);
+    S.code_from = row;
+  }
+  return S.code;
+}
+
+static void spellPush(erow *row, int full, int from, int to) {
+  struct spellJob *j = malloc(sizeof(struct spellJob) + row->size);
+  j->next = NULL;
+  j->row = row->idx;
+  j->full = full;
+  j->from = from;
+  j->to = to;
+  j->bad = NULL;
+  j->nbad = 0;
+  j->len = row->size;
+  memcpy(j->text, row->chars, row->size);
+
+  pthread_mutex_lock(&lock);
+  if (S.queue_tail)
+    S.queue_tail->next = j;
+  else
+    S.queue = j;
+  S.queue_tail = j;
+  S.queued += j->len;
+  pthread_cond_signal(&work);
+  pthread_mutex_unlock(&lock);
+}
+
+static void spellClear(erow *row, int state) {
+  free(row->spell);
+  row->spell = NULL;
+  row->spell_state = state;
+}
+
+static void spellQueueRow(erow *row) {
+  if ((row->spell_state & SPELL_STATE) != SPELL_UNCHECKED)
+    return;
+  if (row->size >= LONG_ROW_THRESHOLD || spellInCode(row->idx)) {
+    spellClear(row, SPELL_CHECKED); // only a window of long rows is rendered
+    return;
+  }
+  row->spell_state = SPELL_QUEUED;
+  if (memchr(row->chars, '`', row->size))
+    row->spell_state |= SPELL_CODE;
+  spellPush(row, 1, 0, row->size);
+}
+
+// copy the result of a job into its row if the row still has the same text
+static int spellApply(struct spellJob *j) {
+  if (j->row < 0 || j->row >= E.numrows)
+    return 0;
+  erow *row = &E.row[j->row];
+  if (row->size != j->len || memcmp(row->chars, j->text, j->len))
+    return 0; // changed since, the change queued it again
+  if (j->full)
+    row->spell_state = SPELL_CHECKED | (row->spell_state & SPELL_CODE);
+  else if ((row->spell_state & SPELL_STATE) != SPELL_CHECKED)
+    return 0;
+
+  int changed = 0;
+  if (row->spell) {
+    int from = j->full ? 0 : j->from, to = j->full ? row->size : j->to;
+    for (int k = from; k < to; k++)
+      changed |= row->spell[k];
+    memset(&row->spell[from], 0, to - from);
+  }
+  if (j->nbad && !row->spell)
+    row->spell = calloc(row->size, 1);
+  for (int k = 0; k < j->nbad; k++)
+    memset(&row->spell[j->bad[2 * k]], 1, j->bad[2 * k + 1]);
+  return changed || j->nbad;
+}
+
+// every job still waiting for or holding a result
+static void spellEachJob(void (*fn)(struct spellJob *j, int at, int n), int at,
+                         int n) {
+  struct spellJob *lists[] = {S.queue, S.busy, S.done};
+  for (int l = 0; l < 3; l++)
+    for (struct spellJob *j = lists[l]; j; j = (l == 1) ? NULL : j->next)
+      fn(j, at, n);
+}
+
+static void spellJobInserted(struct spellJob *j, int at, int n) {
+  if (j->row >= at)
+    j->row += n;
+}
+
+static void spellJobDeleted(struct spellJob *j, int at, int n) {
+  if (j->row >= at + n)
+    j->row -= n;
+  else if (j->row >= at)
+    j->row = -1;
+}
+
+static void spellJobStale(struct spellJob *j, int at, int n) {
+  (void)n;
+  if (j->row >= at)
+    j->row = -1;
+}
+
+// rows from at on are checked again
+static void spellRecheck(int at) {
+  pthread_mutex_lock(&lock);
+  spellEachJob(spellJobStale, at, 0);
+  pthread_mutex_unlock(&lock);
+  for (int j = at; j < E.numrows; j++)
+    E.row[j].spell_state &= ~SPELL_STATE; // marks stay until the new ones
+  if (at < S.next)
+    S.next = at;
+}
+
+/* interface */
+
+void editorSpellStart(int quiet) {
+  S.quiet = quiet;
+  if (S.on)
+    return;
+  S.on = 1;
+  S.next = 0;
+  S.stale = INT_MAX;
+  S.code_from = S.code_to = -1;
+  if (S.started)
+    return;
+  pthread_t t;
+  if (pthread_create(&t, NULL, spellWorker, NULL) != 0) {
+    S.on = 0;
+    if (!quiet)
+      editorSetStatusMessage("spell: no thread");
+    return;
+  }
+  pthread_detach(t);
+  S.started = 1;
+}
+
+void editorSpellStop() {
+  if (!S.on)
+    return;
+  S.on = 0;
+  spellRecheck(0);
+  for (int j = 0; j < E.numrows; j++)
+    spellClear(&E.row[j], SPELL_UNCHECKED);
+}
+
+// prose gets checked, code doesn't
+void editorSpellFiletype() {
+  if (E.syntax && !strcmp(E.syntax->filetype, "markdown"))
+    editorSpellStart(1);
+  else if (S.quiet)
+    editorSpellStop();
+}
+
+// before row is updated, its edit is still noted in edit_at and edit_len
+void editorSpellRowChanged(erow *row) {
+  if (!S.on)
+    return;
+  int at = row->edit_at, len = row->edit_len;
+  int single = len && (row->spell_state & SPELL_STATE) == SPELL_CHECKED &&
+               !(row->spell_state & SPELL_CODE) &&
+               !(len > 0 && memchr(&row->chars[at], '`', len));
+  if (!single || row->size >= LONG_ROW_THRESHOLD) {
+    spellClear(row, SPELL_UNCHECKED);
+    if (row->idx < S.next)
+      S.next = row->idx;
+    return;
+  }
+
+  if (row->spell) { // move the marks after the edit along
+    int old = row->size - len;
+    if (len > 0) {
+      row->spell = realloc(row->spell, row->size);
+      memmove(&row->spell[at + len], &row->spell[at], old - at);
+      memset(&row->spell[at], 0, len);
+    } else {
+      memmove(&row->spell[at], &row->spell[at - len], old - at + len);
+    }
+  }
+  int from = at, to = at + (len > 0 ? len : 0);
+  while (from > 0 && spellWordChar(row->chars[from - 1]))
+    from--;
+  while (to < row->size && spellWordChar(row->chars[to]))
+    to++;
+  if (row->spell)
+    memset(&row->spell[from], 0, to - from);
+  if (!spellInCode(row->idx))
+    spellPush(row, 0, from, to);
+}
+
+// a code fence came or went, the rows after it may be code now or not
+void editorSpellFenceChanged(int at) {
+  if (at < S.stale)
+    S.stale = at;
+  S.code_from = S.code_to = -1;
+}
+
+void editorSpellRowsInserted(int at, int n) {
+  pthread_mutex_lock(&lock);
+  spellEachJob(spellJobInserted, at, n);
+  pthread_mutex_unlock(&lock);
+  if (S.code_to >= at)
+    S.code_from = S.code_to = -1;
+  if (S.next > at)
+    S.next += n;
+}
+
+// a row past the deleted ones moves up by n, one of them goes to at
+static int spellRowDeleted(int row, int at, int n) {
+  return row >= at + n ? row - n : at;
+}
+
+void editorSpellRowsDeleted(int at, int n) {
+  pthread_mutex_lock(&lock);
+  spellEachJob(spellJobDeleted, at, n);
+  pthread_mutex_unlock(&lock);
+  if (S.code_to >= at)
+    S.code_from = S.code_to = -1;
+  if (S.next > at)
+    S.next = spellRowDeleted(S.next, at, n);
+  if (S.stale > at && S.stale != INT_MAX)
+    S.stale = spellRowDeleted(S.stale, at, n);
+}
+
+// the rows are gone, results still coming in are for the old ones
+void editorSpellReset() {
+  pthread_mutex_lock(&lock);
+  spellEachJob(spellJobStale, 0, 0);
+  pthread_mutex_unlock(&lock);
+  S.next = 0;
+  S.stale = INT_MAX;
+  S.code_from = S.code_to = -1;
+}
+
+// take in what the worker checked and hand it more rows, the ones on screen
+// first, returns whether any marks changed
+int editorSpellTick() {
+  if (!S.on)
+    return 0;
+  pthread_mutex_lock(&lock);
+  struct spellJob *done = S.done;
+  S.done = S.done_tail = NULL;
+  int dict = S.dict, queued = S.queued;
+  pthread_mutex_unlock(&lock);
+
+  int changed = 0;
+  while (done) {
+    struct spellJob *j = done;
+    done = j->next;
+    changed |= spellApply(j);
+    free(j->bad);
+    free(j);
+  }
+  if (dict == -1) {
+    if (!S.quiet)
+      editorSetStatusMessage("spell: no word list, set PEB_DICT");
+    editorSpellStop();
+    return 1;
+  }
+
+  if (S.stale != INT_MAX) {
+    spellRecheck(S.stale);
+    S.stale = INT_MAX;
+  }
+  if (queued >= SPELL_QUEUE_BYTES)
+    return changed;
+  int row = E.rowoff;
+  for (int y = 0; y < E.screenrows && row < E.numrows; y++) {
+    spellQueueRow(&E.row[row]);
+    row = editorLayoutNextRow(row);
+  }
+  for (; S.next < E.numrows && queued < SPELL_QUEUE_BYTES; S.next++) {
+    erow *r = &E.row[S.next];
+    if ((r->spell_state & SPELL_STATE) == SPELL_UNCHECKED)
+      queued += r->size + 1;
+    spellQueueRow(r);
+  }
+  return changed;
+}
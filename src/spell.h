@@ -0,0 +1,28 @@
+#ifndef SPELL_H
+#define SPELL_H
+
+#include "editor.h"
+
+// spell checking
+// the word list ($PEB_DICT or /usr/share/dict/words) is compiled once into a
+// dawg in ~/.cache/peb that later starts just map, a worker thread checks
+// copies of the rows, the ones on screen first, and the idle loop copies the
+// misspelled words into row->spell, code spans and fenced code blocks are
+// skipped and an edit inside a word only rechecks that word
+#define SPELL_UNCHECKED 0
+#define SPELL_QUEUED 1
+#define SPELL_CHECKED 2
+#define SPELL_STATE 3
+#define SPELL_CODE 4 // the row had a code span, a backtick edit moves them
+
+void editorSpellStart(int quiet);
+void editorSpellStop();
+void editorSpellFiletype();
+void editorSpellRowChanged(erow *row);
+void editorSpellFenceChanged(int at);
+void editorSpellRowsInserted(int at, int n);
+void editorSpellRowsDeleted(int at, int n);
+void editorSpellReset();
+int editorSpellTick();
+
+#endif // SPELL_H
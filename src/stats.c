@@ -0,0 +1,281 @@
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "outline.h"
+#include "stats.h"
+
+#define STATS_WPM 200 // words read a minute, for the reading time
+
+struct statsCount {
+  long long words;
+  long long chars; // code points, not bytes
+};
+
+static struct {
+  int *words, *chars;      // counts of each row
+  struct statsCount *tree; // Fenwick tree over the rows, 1 based
+  int n;                   // rows counted
+  int cap;
+  int from; // rows from here on moved, their nodes are stale, INT_MAX if none
+  int lost; // a buffer that isn't prose isn't counted, count it all again
+
+  // the edit about to happen and the counts of its span before it
+  int edit_row, edit_at, edit_len;
+  int edit_words, edit_chars;
+} S = {NULL, NULL, NULL, 0, 0, 0, 0, -1, 0, 0, 0, 0};
+
+/* counting */
+
+// non ASCII bytes are taken as letters, ' and - join the parts of a word
+static int statsWordChar(unsigned char c) { return isalnum(c) || c >= 0x80; }
+
+static int statsJoins(unsigned char c) { return c == '\'' || c == '-'; }
+
+// counts of the chars [from, to) of row, no word crosses either end
+static void statsCount(erow *row, int from, int to, int *words, int *chars) {
+  const unsigned char *s = (const unsigned char *)row->chars;
+  int w = 0, c = 0, in = 0;
+  for (int j = from; j < to; j++) {
+    if ((s[j] & 0xc0) != 0x80)
+      c++;
+    if (statsWordChar(s[j])) {
+      w += !in;
+      in = 1;
+    } else if (!(in && statsJoins(s[j]) && j + 1 < row->size &&
+                 statsWordChar(s[j + 1]))) {
+      in = 0;
+    }
+  }
+  *words = w;
+  *chars = c;
+}
+
+// the len chars at at widened to whole words
+static void statsSpan(erow *row, int at, int len, int *from, int *to) {
+  const unsigned char *s = (const unsigned char *)row->chars;
+  *from = at;
+  *to = at + len;
+  while (*from > 0 &&
+         (statsWordChar(s[*from - 1]) || statsJoins(s[*from - 1])))
+    (*from)--;
+  while (*to < row->size && (statsWordChar(s[*to]) || statsJoins(s[*to])))
+    (*to)++;
+}
+
+// only prose is counted, the rest waits until the buffer is prose again
+static int statsOn() {
+  if (E.syntax && strcmp(E.syntax->filetype, "markdown"))
+    S.lost = 1;
+  return !S.lost;
+}
+
+/* tree */
+
+static void statsReserve(int n) {
+  if (n <= S.cap)
+    return;
+  S.cap = S.cap ? S.cap * 2 : 1024;
+  while (S.cap < n)
+    S.cap *= 2;
+  S.words = realloc(S.words, sizeof(int) * S.cap);
+  S.chars = realloc(S.chars, sizeof(int) * S.cap);
+  S.tree = realloc(S.tree, sizeof(struct statsCount) * (S.cap + 1));
+}
+
+// counts of the rows [0, i)
+static struct statsCount statsPrefix(int i) {
+  struct statsCount sum = {0, 0};
+  for (; i > 0; i -= i & -i) {
+    sum.words += S.tree[i].words;
+    sum.chars += S.tree[i].chars;
+  }
+  return sum;
+}
+
+static void statsAdd(int i, int words, int chars) {
+  for (i++; i <= S.n; i += i & -i) {
+    S.tree[i].words += words;
+    S.tree[i].chars += chars;
+  }
+}
+
+static void statsAddNode(int i) {
+  int parent = i + (i & -i);
+  if (parent <= S.n) {
+    S.tree[parent].words += S.tree[i].words;
+    S.tree[parent].chars += S.tree[i].chars;
+  }
+}
+
+// the nodes up to S.from cover rows that didn't move and stay, the ones
+// after it are built again by adding every node to its parent, O(n - from)
+static void statsBuild() {
+  if (S.from == INT_MAX)
+    return;
+  for (int i = S.from + 1; i <= S.n; i++) {
+    S.tree[i].words = S.words[i - 1];
+    S.tree[i].chars = S.chars[i - 1];
+  }
+  for (int i = S.from; i > 0; i -= i & -i) // the kept nodes with new parents
+    statsAddNode(i);
+  for (int i = S.from + 1; i <= S.n; i++)
+    statsAddNode(i);
+  S.from = INT_MAX;
+}
+
+// every row counted again, for a buffer that just became prose
+static void statsRecount() {
+  S.n = 0;
+  S.from = 0;
+  S.lost = 0;
+  statsReserve(E.numrows);
+  for (int j = 0; j < E.numrows; j++) {
+    statsCount(&E.row[j], 0, E.row[j].size, &S.words[j], &S.chars[j]);
+    S.n++;
+  }
+}
+
+// a row added at the end, its node sums the rows it covers before it
+static void statsAppend(int words, int chars) {
+  int i = ++S.n;
+  S.words[i - 1] = words;
+  S.chars[i - 1] = chars;
+  if (S.from != INT_MAX)
+    return;
+  struct statsCount a = statsPrefix(i - 1), b = statsPrefix(i - (i & -i));
+  S.tree[i].words = a.words - b.words + words;
+  S.tree[i].chars = a.chars - b.chars + chars;
+}
+
+/* rows */
+
+// before a row is edited, the words about to change are counted
+void editorStatsRowEditing(erow *row, int at, int len) {
+  S.edit_row = -1;
+  if (!len || !statsOn() || row->idx >= S.n)
+    return;
+  int from, to;
+  statsSpan(row, at, len < 0 ? -len : 0, &from, &to); // what goes away
+  statsCount(row, from, to, &S.edit_words, &S.edit_chars);
+  S.edit_row = row->idx;
+  S.edit_at = at;
+  S.edit_len = len;
+}
+
+// a single edit only counts the words around it again
+void editorStatsRowChanged(erow *row) {
+  if (!statsOn())
+    return;
+  int words, chars;
+  if (row->idx == S.edit_row && row->edit_at == S.edit_at &&
+      row->edit_len == S.edit_len && row->idx < S.n) {
+    int from, to;
+    statsSpan(row, row->edit_at, row->edit_len > 0 ? row->edit_len : 0, &from,
+              &to);
+    statsCount(row, from, to, &words, &chars);
+    words += S.words[row->idx] - S.edit_words;
+    chars += S.chars[row->idx] - S.edit_chars;
+  } else {
+    statsCount(row, 0, row->size, &words, &chars);
+  }
+  S.edit_row = -1;
+  if (row->idx >= S.n) { // appended by loading
+    statsReserve(row->idx + 1);
+    while (S.n < row->idx)
+      statsAppend(0, 0);
+    statsAppend(words, chars);
+    return;
+  }
+  // nodes past S.from are built again anyway
+  statsAdd(row->idx, words - S.words[row->idx], chars - S.chars[row->idx]);
+  S.words[row->idx] = words;
+  S.chars[row->idx] = chars;
+}
+
+// counted when they are updated
+void editorStatsRowsInserted(int at, int n) {
+  if (!statsOn() || at > S.n)
+    return;
+  statsReserve(S.n + n);
+  memmove(&S.words[at + n], &S.words[at], sizeof(int) * (S.n - at));
+  memmove(&S.chars[at + n], &S.chars[at], sizeof(int) * (S.n - at));
+  memset(&S.words[at], 0, sizeof(int) * n);
+  memset(&S.chars[at], 0, sizeof(int) * n);
+  S.n += n;
+  if (at < S.from)
+    S.from = at;
+}
+
+void editorStatsRowsDeleted(int at, int n) {
+  if (!statsOn() || at >= S.n)
+    return;
+  if (n > S.n - at)
+    n = S.n - at;
+  memmove(&S.words[at], &S.words[at + n], sizeof(int) * (S.n - at - n));
+  memmove(&S.chars[at], &S.chars[at + n], sizeof(int) * (S.n - at - n));
+  S.n -= n;
+  if (at < S.from)
+    S.from = at;
+}
+
+// whether every row is counted, for the cache of big files
+int editorStatsCounted() { return statsOn() && S.n == E.numrows; }
+
+void editorStatsRowCounts(int idx, int *words, int *chars) {
+  *words = S.words[idx];
+  *chars = S.chars[idx];
+}
+
+// the counts of n rows read from the cache, the tree is built when shown,
+// without counts the rows are counted then
+void editorStatsLoad(const int *words, const int *chars, int n) {
+  editorStatsReset();
+  if (!words) {
+    S.lost = 1;
+    return;
+  }
+  statsReserve(n);
+  memcpy(S.words, words, sizeof(int) * n);
+  memcpy(S.chars, chars, sizeof(int) * n);
+  S.n = n;
+}
+
+// loading appends the rows without the tree, it is built once when shown
+void editorStatsReset() {
+  S.n = 0;
+  S.from = 0;
+  S.lost = 0;
+  S.edit_row = -1;
+}
+
+/* status bar */
+
+// counts of the section around the cursor and of the whole buffer, like
+// "120/4312 words 702/25108 chars 1/22 min", 0 if the buffer isn't prose
+int editorStatsFormat(char *buf, int size) {
+  buf[0] = '\0';
+  if (E.syntax && strcmp(E.syntax->filetype, "markdown"))
+    return 0;
+  if (S.lost)
+    statsRecount();
+  statsBuild();
+  int start, end;
+  editorOutlineHeading(E.cy < E.numrows ? E.cy : E.numrows - 1, &start, &end);
+  if (end >= S.n)
+    end = S.n - 1;
+  struct statsCount doc = statsPrefix(S.n);
+  struct statsCount sec = {0, 0};
+  if (start <= end) {
+    struct statsCount a = statsPrefix(start), b = statsPrefix(end + 1);
+    sec.words = b.words - a.words;
+    sec.chars = b.chars - a.chars;
+  }
+  int len = snprintf(buf, size, "%lld/%lld words %lld/%lld chars %lld/%lld min",
+                     sec.words, doc.words, sec.chars, doc.chars,
+                     (sec.words + STATS_WPM - 1) / STATS_WPM,
+                     (doc.words + STATS_WPM - 1) / STATS_WPM);
+  return len < size ? len : size - 1;
+}
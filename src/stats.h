@@ -0,0 +1,22 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "editor.h"
+
+// words, characters and reading time for the status bar
+// every row keeps its counts and a Fenwick tree sums them, so the count of
+// any run of rows costs O(log n), an edit counts only the words around it
+// again and costs O(log n) more, inserting or deleting rows moves the counts
+// after them and their part of the tree is built again when it is next
+// needed, O(n - at) like moving the rows themselves, only prose is counted
+void editorStatsRowEditing(erow *row, int at, int len);
+void editorStatsRowChanged(erow *row);
+void editorStatsRowsInserted(int at, int n);
+void editorStatsRowsDeleted(int at, int n);
+void editorStatsReset();
+int editorStatsCounted();
+void editorStatsRowCounts(int idx, int *words, int *chars);
+void editorStatsLoad(const int *words, const int *chars, int n);
+int editorStatsFormat(char *buf, int size);
+
+#endif // STATS_H
@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "stream.h"
+
+#define STREAM_READ 65536            // bytes per read from the pipe
+#define STREAM_TICK_BYTES (8 << 20) // rows made per idle tick, keys stay snappy
+#define STREAM_KEY_BYTES (1 << 20)  // rows made between two keys
+#define STREAM_QUEUE_MAX (64 << 20) // reading waits while this much is queued
+#define STREAM_WAIT_MS 200          // longest wait for the first screen
+
+// data read from the pipe but not turned into rows yet
+struct streamChunk {
+  struct streamChunk *next;
+  int len;
+  char data[];
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t arrived = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t drained = PTHREAD_COND_INITIALIZER;
+
+static struct {
+  int active; // rows are still coming
+  int fd;     // the pipe, owned by the reader thread
+  pid_t child; // process writing the pipe, -1 if none
+  void (*done)(void);
+  struct streamChunk *head, *tail;
+  long long queued; // bytes in the chunks
+  int eof;
+  int err;    // errno of a failed read
+  int status; // exit status of the child
+  int partial; // the last row is still waiting for its newline
+} S = {0, -1, -1, NULL, NULL, NULL, 0, 0, 0, 0, 0};
+
+int editorStreaming() { return S.active; }
+
+static void *streamReader(void *arg) {
+  (void)arg;
+  char buf[STREAM_READ];
+  while (1) {
+    ssize_t n = read(S.fd, buf, sizeof(buf));
+    if (n == -1 && errno == EINTR)
+      continue;
+    struct streamChunk *c = NULL;
+    if (n > 0) {
+      c = malloc(sizeof(struct streamChunk) + n);
+      c->next = NULL;
+      c->len = n;
+      memcpy(c->data, buf, n);
+    }
+
+    pthread_mutex_lock(&lock);
+    if (c) {
+      // the pipe backs up while the rows are behind, the writer waits
+      while (S.queued >= STREAM_QUEUE_MAX)
+        pthread_cond_wait(&drained, &lock);
+      S.queued += c->len;
+      if (S.tail)
+        S.tail->next = c;
+      else
+        S.head = c;
+      S.tail = c;
+    } else {
+      S.eof = 1;
+      S.err = (n == -1) ? errno : 0;
+    }
+    pthread_cond_signal(&arrived);
+    pthread_mutex_unlock(&lock);
+    if (!c)
+      break;
+  }
+  close(S.fd);
+
+  int status = S.status;
+  if (S.child != -1) {
+    while (waitpid(S.child, &status, 0) == -1 && errno == EINTR)
+      ;
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+  }
+  pthread_mutex_lock(&lock);
+  S.status = status;
+  pthread_cond_signal(&arrived);
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+// read fd in the background, child is the process writing it, reaped once
+// the input ends, and done runs after the last row is in
+int editorStreamStart(int fd, pid_t child, void (*done)(void)) {
+  S.fd = fd;
+  S.child = child;
+  S.done = done;
+  S.eof = 0;
+  S.err = 0;
+  S.status = (child == -1) ? 0 : -1; // -1 until the child is reaped
+  S.partial = 0;
+  S.queued = 0;
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, streamReader, NULL) != 0)
+    return -1;
+  pthread_detach(thread);
+  S.active = 1;
+  return 0;
+}
+
+// take over stdin as the data to edit and read keys from the terminal
+int editorStreamOpen() {
+  int fd = dup(STDIN_FILENO);
+  if (fd == -1)
+    return -1;
+  int tty = open("/dev/tty", O_RDWR);
+  if (tty == -1 || dup2(tty, STDIN_FILENO) == -1) {
+    close(fd);
+    return -1;
+  }
+  close(tty);
+  return editorStreamStart(fd, -1, NULL);
+}
+
+// turns what arrived into rows, at most budget bytes at a time, returns 1
+// if the rows changed
+static int streamLoad(long long budget) {
+  if (!S.active)
+    return 0;
+
+  pthread_mutex_lock(&lock);
+  struct streamChunk *c = S.head;
+  int eof = S.eof;
+  int status = S.status;
+  S.head = S.tail = NULL;
+  pthread_mutex_unlock(&lock);
+
+  int changed = (c != NULL);
+  long long done = 0;
+  while (c && done < budget) {
+    struct streamChunk *next = c->next;
+    S.partial = editorLoadRows(c->data, c->len, S.partial);
+    done += c->len;
+    free(c);
+    c = next;
+  }
+
+  pthread_mutex_lock(&lock);
+  S.queued -= done;
+  if (c) { // over budget, put the rest back in front
+    struct streamChunk *last = c;
+    while (last->next)
+      last = last->next;
+    last->next = S.head;
+    if (!S.head)
+      S.tail = last;
+    S.head = c;
+  }
+  pthread_cond_signal(&drained);
+  pthread_mutex_unlock(&lock);
+  if (!c && eof && status != -1) {
+    editorLoadRowsDone(S.partial);
+    S.active = 0;
+    if (S.err)
+      editorSetStatusMessage("Error reading input: %s", strerror(S.err));
+    else if (status == 127)
+      editorSetStatusMessage("Error reading input: filter program not found");
+    else if (status)
+      editorSetStatusMessage("Error reading input: exit status %d", status);
+    else
+      editorSetStatusMessage("Read %d lines", E.numrows);
+    if (S.done)
+      S.done();
+    changed = 1;
+  }
+  return changed;
+}
+
+// called from the idle loop
+int editorStreamTick() { return streamLoad(STREAM_TICK_BYTES); }
+
+// called before every key, so typing doesn't hold the loading up
+int editorStreamSlice() { return streamLoad(STREAM_KEY_BYTES); }
+
+// block until rows lines have arrived or the input ended, so the first
+// screen is full when it is drawn, a slow writer gets STREAM_WAIT_MS
+void editorStreamWait(int rows) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += STREAM_WAIT_MS * 1000000L;
+  deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+  deadline.tv_nsec %= 1000000000L;
+
+  while (S.active && E.numrows < rows) {
+    int timeout = 0;
+    pthread_mutex_lock(&lock);
+    while (!S.head && !(S.eof && S.status != -1) && !timeout)
+      timeout = pthread_cond_timedwait(&arrived, &lock, &deadline) != 0;
+    pthread_mutex_unlock(&lock);
+    editorStreamTick();
+    if (timeout)
+      break;
+  }
+}
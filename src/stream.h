@@ -0,0 +1,17 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <sys/types.h>
+
+// reading a buffer from stdin, a pipe or a decompressor
+// a thread drains the pipe into chunks as data arrives and the idle loop
+// turns the chunks into rows, a slice of them before every key too, for stdin
+// the keyboard is read from /dev/tty
+int editorStreamStart(int fd, pid_t child, void (*done)(void));
+int editorStreamOpen();
+void editorStreamWait(int rows);
+int editorStreamTick();
+int editorStreamSlice();
+int editorStreaming();
+
+#endif // STREAM_H
@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "outline.h"
+#include "table.h"
+#include "utility.h"
+
+#define TABLE_MIN_WIDTH 3 // the delimiter row needs at least ---
+
+// alignment of a column, from the colons of the delimiter row
+enum tableAlign { ALIGN_NONE = 0, ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+
+/* measuring */
+
+// display columns of a code point, wide east asian and emoji take two,
+// combining marks and zero width spaces none
+static int tableCharWidth(unsigned int c) {
+  if ((c >= 0x300 && c <= 0x36f) || (c >= 0x200b && c <= 0x200f) ||
+      (c >= 0x20d0 && c <= 0x20ff) || (c >= 0xfe00 && c <= 0xfe0f))
+    return 0;
+  if ((c >= 0x1100 && c <= 0x115f) || (c >= 0x2e80 && c <= 0xa4cf) ||
+      (c >= 0xac00 && c <= 0xd7a3) || (c >= 0xf900 && c <= 0xfaff) ||
+      (c >= 0xfe30 && c <= 0xfe4f) || (c >= 0xff00 && c <= 0xff60) ||
+      (c >= 0xffe0 && c <= 0xffe6) || (c >= 0x1f300 && c <= 0x1f64f) ||
+      (c >= 0x1f900 && c <= 0x1f9ff) || (c >= 0x20000 && c <= 0x3fffd))
+    return 2;
+  return 1;
+}
+
+// display columns of utf-8 text, stray bytes count as one column each
+int editorTableWidth(const char *s, int len) {
+  const unsigned char *p = (const unsigned char *)s, *end = p + len;
+  int w = 0;
+  while (p < end) {
+    unsigned int c = *p++;
+    int more = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+    if (more) {
+      c &= 0x3f >> more;
+      while (more && p < end && (*p & 0xc0) == 0x80) {
+        c = (c << 6) | (*p++ & 0x3f);
+        more--;
+      }
+    }
+    w += more ? 1 : tableCharWidth(c);
+  }
+  return w;
+}
+
+// columns of text that starts at column col once its tabs are expanded
+static int tableRenderWidth(const char *s, int len, int col) {
+  int w = 0;
+  const char *tab;
+  while ((tab = memchr(s, '\t', len))) {
+    w += editorTableWidth(s, tab - s);
+    w += PEB_TAB_STOP - (col + w) % PEB_TAB_STOP;
+    len -= tab + 1 - s;
+    s = tab + 1;
+  }
+  return w + editorTableWidth(s, len);
+}
+
+static int tableIsPipe(const char *s, int i) {
+  return s[i] == '|' && (i == 0 || s[i - 1] != '\\');
+}
+
+static int tableHasPipe(erow *row) {
+  for (int i = 0; i < row->size; i++)
+    if (tableIsPipe(row->chars, i))
+      return 1;
+  return 0;
+}
+
+static int tableIndent(erow *row) {
+  int i = 0;
+  while (i < row->size && (row->chars[i] == ' ' || row->chars[i] == '\t'))
+    i++;
+  return i;
+}
+
+// split a row at its unescaped pipes, the pipes at either end don't start
+// or end a cell, returns the number of cells appended to *cells
+int editorTableSplit(erow *row, struct tableCell **cells, int *n, int *cap) {
+  const char *s = row->chars;
+  int i = tableIndent(row), end = row->size;
+  while (end > i && (s[end - 1] == ' ' || s[end - 1] == '\t'))
+    end--;
+  if (i < end && s[i] == '|')
+    i++;
+  if (end > i && tableIsPipe(s, end - 1))
+    end--;
+
+  int count = 0;
+  while (1) {
+    int j = i;
+    while (j < end && !tableIsPipe(s, j))
+      j++;
+    int a = i, b = j;
+    while (a < b && (s[a] == ' ' || s[a] == '\t'))
+      a++;
+    while (b > a && (s[b - 1] == ' ' || s[b - 1] == '\t'))
+      b--;
+    if (*n == *cap) {
+      *cap = *cap ? *cap * 2 : 256;
+      *cells = realloc(*cells, sizeof(struct tableCell) * *cap);
+    }
+    (*cells)[(*n)++] = (struct tableCell){a, b - a, editorTableWidth(&s[a], b - a)};
+    count++;
+    if (j >= end)
+      break;
+    i = j + 1;
+  }
+  return count;
+}
+
+// a cell of the delimiter row, :---, ---: or :---:
+static int tableDelimiter(const char *s, int len, enum tableAlign *align) {
+  int i = 0, left = 0, right = 0;
+  if (i < len && s[i] == ':')
+    left = 1, i++;
+  if (len - i > 0 && s[len - 1] == ':')
+    right = 1, len--;
+  if (i >= len)
+    return 0;
+  for (; i < len; i++)
+    if (s[i] != '-')
+      return 0;
+  *align = left && right ? ALIGN_CENTER
+           : right       ? ALIGN_RIGHT
+           : left        ? ALIGN_LEFT
+                         : ALIGN_NONE;
+  return 1;
+}
+
+/* formatting */
+
+static void tablePut(char **b, int *len, int *cap, const char *s, int n) {
+  if (*len + n + 1 > *cap) {
+    while (*len + n + 1 > *cap)
+      *cap = *cap ? *cap * 2 : 256;
+    *b = realloc(*b, *cap);
+  }
+  memcpy(&(*b)[*len], s, n);
+  *len += n;
+}
+
+static void tablePad(char **b, int *len, int *cap, char c, int n) {
+  for (; n > 0; n--)
+    tablePut(b, len, cap, &c, 1);
+}
+
+// put s as if it started at column col, its tabs turned into the spaces they
+// rendered as there, so the cell keeps its width wherever it moves to,
+// returns the column after it
+static int tablePutExpanded(char **b, int *len, int *cap, const char *s, int n,
+                            int col) {
+  const char *tab;
+  while ((tab = memchr(s, '\t', n))) {
+    tablePut(b, len, cap, s, tab - s);
+    col += editorTableWidth(s, tab - s);
+    tablePad(b, len, cap, ' ', PEB_TAB_STOP - col % PEB_TAB_STOP);
+    col += PEB_TAB_STOP - col % PEB_TAB_STOP;
+    n -= tab + 1 - s;
+    s = tab + 1;
+  }
+  tablePut(b, len, cap, s, n);
+  return col + editorTableWidth(s, n);
+}
+
+/* interface */
+
+// :table, align the markdown table around the cursor
+void editorTableAlign() {
+  int end;
+  if (E.cy >= E.numrows || !tableHasPipe(&E.row[E.cy]) ||
+      editorOutlineInCode(E.cy, &end)) {
+    editorSetStatusMessage("No table here");
+    return;
+  }
+  int first = E.cy, last = E.cy;
+  while (first > 0 && tableHasPipe(&E.row[first - 1]))
+    first--;
+  while (last + 1 < E.numrows && tableHasPipe(&E.row[last + 1]))
+    last++;
+  int nrows = last - first + 1;
+
+  // every cell of every row, measured on the way
+  struct tableCell *cells = NULL;
+  int ncells = 0, cellcap = 0, ncols = 0;
+  int *start = malloc(sizeof(int) * (nrows + 1)); // first cell of each row
+  for (int r = 0; r < nrows; r++) {
+    erow *row = &E.row[first + r];
+    start[r] = ncells;
+    int n = editorTableSplit(row, &cells, &ncells, &cellcap);
+    if (n > ncols)
+      ncols = n;
+    for (int c = start[r]; c < ncells; c++) // tabs as they are rendered
+      if (memchr(&row->chars[cells[c].start], '\t', cells[c].len))
+        cells[c].width =
+            tableRenderWidth(&row->chars[cells[c].start], cells[c].len,
+                             editorRowCxToRx(row, cells[c].start));
+  }
+  start[nrows] = ncells;
+
+  enum tableAlign *align = calloc(ncols, sizeof(enum tableAlign));
+  int ok = nrows >= 2;
+  for (int c = start[1]; ok && c < start[2]; c++)
+    ok = tableDelimiter(&E.row[first + 1].chars[cells[c].start], cells[c].len,
+                        &align[c - start[1]]);
+  if (!ok) {
+    editorSetStatusMessage("No table here, the second row isn't ---|---");
+    free(cells);
+    free(start);
+    free(align);
+    return;
+  }
+
+  int *width = malloc(sizeof(int) * ncols);
+  for (int k = 0; k < ncols; k++)
+    width[k] = TABLE_MIN_WIDTH;
+  for (int r = 0; r < nrows; r++)
+    for (int c = start[r]; c < start[r + 1]; c++)
+      if (r != 1 && cells[c].width > width[c - start[r]])
+        width[c - start[r]] = cells[c].width;
+
+  // the cell the cursor is in, to put it back at the same char
+  int ccell = 0, coff = 0, ccx = E.cx;
+  erow *crow = &E.row[E.cy];
+  for (int c = start[E.cy - first]; c < start[E.cy - first + 1]; c++) {
+    if (c > start[E.cy - first] && cells[c].start > E.cx)
+      break;
+    ccell = c - start[E.cy - first];
+    coff = E.cx - cells[c].start;
+  }
+  if (coff < 0)
+    coff = 0;
+
+  // format the rows into buf, one line each
+  char *buf = NULL;
+  int len = 0, cap = 0;
+  int indent = tableIndent(&E.row[first]);
+  for (int r = 0; r < nrows; r++) {
+    erow *row = &E.row[first + r];
+    int line = len;
+    tablePut(&buf, &len, &cap, E.row[first].chars, indent);
+    tablePut(&buf, &len, &cap, "|", 1);
+    for (int k = 0; k < ncols; k++) {
+      int c = start[r] + k;
+      struct tableCell *cell = c < start[r + 1] ? &cells[c] : NULL;
+      tablePut(&buf, &len, &cap, " ", 1);
+      if (r == 1) {
+        int colons = (align[k] == ALIGN_LEFT || align[k] == ALIGN_CENTER) +
+                     (align[k] == ALIGN_RIGHT || align[k] == ALIGN_CENTER);
+        if (align[k] == ALIGN_LEFT || align[k] == ALIGN_CENTER)
+          tablePut(&buf, &len, &cap, ":", 1);
+        tablePad(&buf, &len, &cap, '-', width[k] - colons);
+        if (align[k] == ALIGN_RIGHT || align[k] == ALIGN_CENTER)
+          tablePut(&buf, &len, &cap, ":", 1);
+      } else {
+        int w = cell ? cell->width : 0;
+        int pad = width[k] > w ? width[k] - w : 0;
+        int before = align[k] == ALIGN_RIGHT    ? pad
+                     : align[k] == ALIGN_CENTER ? pad / 2
+                                                : 0;
+        tablePad(&buf, &len, &cap, ' ', before);
+        // tabs become the spaces they rendered as, the cursor goes after
+        // the chars before it
+        int here = row == crow && k == ccell, n = cell ? cell->len : 0;
+        int at = here && coff < n ? coff : n;
+        const char *s = cell ? &row->chars[cell->start] : "";
+        int col = cell ? editorRowCxToRx(row, cell->start) : 0;
+        col = tablePutExpanded(&buf, &len, &cap, s, at, col);
+        if (here)
+          ccx = len - line;
+        tablePutExpanded(&buf, &len, &cap, s + at, n - at, col);
+        tablePad(&buf, &len, &cap, ' ', pad - before);
+      }
+      tablePut(&buf, &len, &cap, " |", 2);
+    }
+    tablePut(&buf, &len, &cap, "\n", 1);
+  }
+  free(cells);
+  free(start);
+  free(align);
+  free(width);
+
+  // one edit, only the rows that come out different are replaced
+  int changed = editorSetRows(first, buf, len);
+  free(buf);
+  E.cx = ccx < E.row[E.cy].size ? ccx : E.row[E.cy].size;
+  editorSetStatusMessage("%d columns, %d of %d rows changed", ncols, changed,
+                         nrows);
+}
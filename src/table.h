@@ -0,0 +1,20 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "editor.h"
+
+// markdown table alignment
+// the cells of every row are split and measured in display columns in one
+// pass, then the rows are formatted into a scratch buffer and replaced as one
+// edit that leaves the rows that come out the same alone, so aligning again
+// after editing one cell only touches the rows whose padding moved
+struct tableCell {
+  int start, len; // trimmed contents in the row's chars
+  int width;      // display columns of the contents
+};
+
+int editorTableWidth(const char *s, int len);
+int editorTableSplit(erow *row, struct tableCell **cells, int *n, int *cap);
+void editorTableAlign();
+
+#endif // TABLE_H
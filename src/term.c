@@ -1,16 +1,94 @@
+#define _GNU_SOURCE
+
 #include "term.h"
 #include "error.h"
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TERM_IDLE_MS 100         // a key wait this long runs the idle handler
+#define TERM_RESIZE_SETTLE_MS 30 // quiet time that ends a burst of resizes
+#define TERM_RESIZE_MAX_MS 150   // a longer burst is handled in steps
+
+static void (*idleHandler)(void) = NULL;
+static void (*resizeHandler)(void) = NULL;
+static int resizePipe[2] = {-1, -1}; // SIGWINCH writes, the key loop reads
+
+// fn runs every time a read times out without a key
+void editorSetIdleHandler(void (*fn)(void)) { idleHandler = fn; }
+
+// the signal only wakes the key loop, a full pipe already says resized
+static void termWinch(int sig) {
+  (void)sig;
+  int saved = errno;
+  write(resizePipe[1], "", 1);
+  errno = saved;
+}
+
+// fn runs from the key loop once the terminal stopped changing size
+void editorSetResizeHandler(void (*fn)(void)) {
+  if (resizePipe[0] == -1) {
+    if (pipe(resizePipe) == -1)
+      return;
+    for (int j = 0; j < 2; j++) {
+      fcntl(resizePipe[j], F_SETFL, O_NONBLOCK);
+      fcntl(resizePipe[j], F_SETFD, FD_CLOEXEC);
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = termWinch;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &sa, NULL);
+  }
+  resizeHandler = fn;
+}
+
+// empty the pipe and wait for the rest of a burst, dragging a window edge
+// sends dozens of signals that should become one relayout
+static void termResized() {
+  char buf[64];
+  struct pollfd p = {resizePipe[0], POLLIN, 0};
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    while (read(resizePipe[0], buf, sizeof(buf)) > 0)
+      ;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000 +
+                   (now.tv_nsec - start.tv_nsec) / 1000000 <
+               TERM_RESIZE_MAX_MS &&
+           poll(&p, 1, TERM_RESIZE_SETTLE_MS) != 0); // EINTR is another one
+  if (resizeHandler)
+    resizeHandler();
+}
 
 int editorReadKey() {
-  int nread; // num of bytes read
-  char c;    // char to be read in
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-    if (nread == -1 && errno != EAGAIN)
-      die("read");
+  char c; // char to be read in
+  while (1) {
+    struct pollfd p[2] = {{STDIN_FILENO, POLLIN, 0}, {resizePipe[0], POLLIN, 0}};
+    int n = poll(p, resizePipe[0] != -1 ? 2 : 1, TERM_IDLE_MS);
+    if (n == -1 && errno != EINTR)
+      die("poll");
+    if (n > 0 && (p[1].revents & POLLIN)) {
+      termResized();
+      continue;
+    }
+    if (n > 0) {
+      int nread = read(STDIN_FILENO, &c, 1);
+      if (nread == 1)
+        break;
+      if (nread == -1 && errno != EAGAIN && errno != EINTR)
+        die("read");
+    }
+    if (idleHandler) // timed out, or the read came back empty
+      idleHandler();
   }
 
   if (c == '\x1b') { // if character is escape char
@@ -2,7 +2,7 @@
 #define TERM_H
 
 #include <termios.h>
-enum editorModes { NORMAL = 0, INSERT };
+enum editorModes { NORMAL = 0, INSERT, VISUAL };
 
 enum editorHighlight {
   HL_NORMAL = 0,
@@ -31,5 +31,7 @@ enum editorKey {
 int getWindowSize(int *rows, int *cols);
 int getCursorPosition(int *rows, int *cols);
 int editorReadKey();
+void editorSetIdleHandler(void (*fn)(void));
+void editorSetResizeHandler(void (*fn)(void));
 
 #endif // TERM_
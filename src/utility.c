@@ -8,13 +8,19 @@ int is_seperator(int c) {
 }
 
 void abAppend(struct abuf *ab, const char *s, int len) {
-  // allocate new mem for expanded string
-  char *new = realloc(ab->b, ab->len + len);
+  if (ab->len + len > ab->cap) {
+    // grow by doubling so a reused buffer stops reallocating
+    int cap = ab->cap ? ab->cap : 4096;
+    while (cap < ab->len + len)
+      cap *= 2;
+    char *new = realloc(ab->b, cap);
 
-  if (new == NULL) // if realloc failed, return
-    return;
-  memcpy(&new[ab->len], s, len);
-  ab->b = new;
+    if (new == NULL) // if realloc failed, return
+      return;
+    ab->b = new;
+    ab->cap = cap;
+  }
+  memcpy(&ab->b[ab->len], s, len);
   ab->len += len;
 }
 
@@ -1,7 +1,7 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
-#define ABUF_INIT {NULL, 0}
+#define ABUF_INIT {NULL, 0, 0}
 #define PEB_VERSION "2.2"
 #define PEB_TAB_STOP 2
 #define CTRL_KEY(k) ((k) & 0x1f)
@@ -13,6 +13,7 @@
 struct abuf {
   char *b;
   int len;
+  int cap;
 };
 
 int is_seperator(int c);
@@ -0,0 +1,396 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diff.h"
+#include "fold.h"
+#include "layout.h"
+#include "preview.h"
+#include "window.h"
+
+#define WINDOW_MIN_ROWS 3 // a text line and the status line at least
+#define WINDOW_MIN_COLS 10
+
+struct window {
+  struct window *parent;
+  struct window *a, *b; // a is above or left of b, NULL for a leaf
+  int vertical;         // a and b side by side
+
+  // leaves
+  struct editorView v;
+  int top, left, rows, cols; // screen area with status line and separator
+  uint64_t *drawn;           // hash of every screen line as last sent
+  int valid;                 // drawn matches the terminal
+  int anchor;                // screen line of the cursor before a resize
+  struct layout *layout;     // rows laid out for this window's width
+};
+
+static struct {
+  struct window *root;
+  struct window *active;
+  int rows, cols; // terminal size
+  uint64_t msg;   // hash of the message line as last sent
+  int msg_valid;
+} W = {NULL, NULL, 0, 0, 0, 0};
+
+static void windowSave(struct window *w) {
+  w->v.cx = E.cx;
+  w->v.cy = E.cy;
+  w->v.rx = E.rx;
+  w->v.rowoff = E.rowoff;
+  w->v.coloff = E.coloff;
+  w->v.wrap = E.wrap;
+  w->v.wrapoff = E.wrapoff;
+  w->v.screenrows = E.screenrows;
+  w->v.screencols = E.screencols;
+}
+
+static void windowLoad(struct window *w) {
+  E.cx = w->v.cx;
+  E.cy = w->v.cy;
+  E.rx = w->v.rx;
+  E.rowoff = w->v.rowoff;
+  E.coloff = w->v.coloff;
+  E.wrap = w->v.wrap;
+  E.wrapoff = w->v.wrapoff;
+  E.screenrows = w->v.screenrows;
+  E.screencols = w->v.screencols;
+  editorLayoutUse(w->layout);
+
+  // the rows may have changed from another window
+  if (E.cy > E.numrows)
+    E.cy = E.numrows;
+  int size = (E.cy < E.numrows) ? E.row[E.cy].size : 0;
+  if (E.cx > size)
+    E.cx = size;
+  if (E.rowoff > E.cy)
+    E.rowoff = E.cy;
+}
+
+static struct window *windowLeaf(struct window *w) {
+  while (w->a)
+    w = w->a;
+  return w;
+}
+
+/* layout */
+
+static void windowPlace(struct window *w, int top, int left, int rows,
+                        int cols) {
+  if (w->a) {
+    if (w->vertical) {
+      int acols = cols / 2;
+      windowPlace(w->a, top, left, rows, acols);
+      windowPlace(w->b, top, left + acols, rows, cols - acols);
+    } else {
+      int arows = rows / 2;
+      windowPlace(w->a, top, left, arows, cols);
+      windowPlace(w->b, top + arows, left, rows - arows, cols);
+    }
+    return;
+  }
+  if (w->top != top || w->left != left || w->rows != rows || w->cols != cols) {
+    w->top = top;
+    w->left = left;
+    w->rows = rows;
+    w->cols = cols;
+    free(w->drawn);
+    w->drawn = calloc(rows, sizeof(uint64_t));
+    w->valid = 0;
+  }
+  w->v.screenrows = rows - 1; // status line
+  // separator on the right, the diff gutter on the left
+  w->v.screencols = cols - (left + cols < W.cols) - editorDiffGutter();
+}
+
+// columns left of the preview
+static int windowCols() { return W.cols - editorPreviewCols(W.cols); }
+
+// the message line takes the last terminal line, windows get the rest
+static void windowLayout() {
+  windowSave(W.active);
+  windowPlace(W.root, 0, 0, W.rows - 1, windowCols());
+  windowLoad(W.active);
+}
+
+static struct window *windowNew() {
+  struct window *w = calloc(1, sizeof(struct window));
+  w->rows = -1;
+  return w;
+}
+
+void editorWindowInit(int rows, int cols) {
+  W.rows = rows;
+  W.cols = cols;
+  W.root = W.active = windowNew();
+  W.root->layout = editorLayoutNew();
+  windowLayout();
+}
+
+// screen line of the cursor in the view in E
+static int windowCursorLine() {
+  if (E.wrap || editorFolds()) {
+    int y, x;
+    editorLayoutCursor(&y, &x);
+    return y;
+  }
+  return E.cy - E.rowoff;
+}
+
+// scroll the view in E so the cursor is on screen line y, or the last one
+static void windowScrollTo(int y) {
+  if (y >= E.screenrows)
+    y = E.screenrows - 1;
+  if (y < 0)
+    y = 0;
+  if (E.wrap || editorFolds())
+    editorLayoutAnchor(y);
+  else
+    E.rowoff = E.cy > y ? E.cy - y : 0;
+}
+
+static void windowAnchor(struct window *w, int restore) {
+  if (w->a) {
+    windowAnchor(w->a, restore);
+    windowAnchor(w->b, restore);
+    return;
+  }
+  windowLoad(w);
+  if (restore)
+    windowScrollTo(w->anchor);
+  else
+    w->anchor = windowCursorLine();
+  windowSave(w);
+}
+
+// the terminal changed size, every window keeps its cursor on the same
+// screen line as far as it fits, wrapped rows get new breaks as they are
+// drawn and nothing else depends on the width
+void editorWindowResize(int rows, int cols) {
+  windowSave(W.active);
+  windowAnchor(W.root, 0);
+  W.rows = rows > WINDOW_MIN_ROWS ? rows : WINDOW_MIN_ROWS;
+  W.cols = cols > WINDOW_MIN_COLS ? cols : WINDOW_MIN_COLS;
+  windowPlace(W.root, 0, 0, W.rows - 1, windowCols());
+  windowAnchor(W.root, 1);
+  windowLoad(W.active);
+  editorWindowInvalidate();
+}
+
+// the columns taken off the text changed
+void editorWindowRelayout() {
+  windowLayout();
+  editorWindowInvalidate();
+}
+
+static void windowInvalidate(struct window *w) {
+  if (w->a) {
+    windowInvalidate(w->a);
+    windowInvalidate(w->b);
+  }
+  w->valid = 0;
+}
+
+// the terminal no longer shows what was last sent, redraw all of it
+void editorWindowInvalidate() {
+  windowInvalidate(W.root);
+  editorPreviewInvalidate();
+  W.msg_valid = 0;
+}
+
+/* splits */
+
+// split the active window in two, the new half becomes active
+int editorWindowSplit(int vertical) {
+  struct window *w = W.active;
+  if (vertical ? w->cols < 2 * WINDOW_MIN_COLS : w->rows < 2 * WINDOW_MIN_ROWS) {
+    editorSetStatusMessage("Not enough room to split");
+    return 0;
+  }
+  windowSave(w);
+
+  // w turns into the split, its view moves into a new leaf
+  struct window *a = windowNew(), *b = windowNew();
+  a->v = b->v = w->v;
+  a->parent = b->parent = w;
+  a->drawn = w->drawn;
+  a->top = w->top;
+  a->left = w->left;
+  a->rows = w->rows;
+  a->cols = w->cols;
+  a->valid = w->valid;
+  a->layout = w->layout;
+  b->layout = editorLayoutNew();
+  w->drawn = NULL;
+  w->layout = NULL;
+  w->a = a;
+  w->b = b;
+  w->vertical = vertical;
+
+  W.active = b;
+  windowPlace(W.root, 0, 0, W.rows - 1, windowCols());
+  windowLoad(W.active);
+  return 1;
+}
+
+// close the active window, 0 if it is the last one
+int editorWindowClose() {
+  struct window *w = W.active;
+  struct window *p = w->parent;
+  if (p == NULL)
+    return 0;
+
+  // the other half takes the place of the split
+  struct window *keep = (p->a == w) ? p->b : p->a;
+  struct window *gp = p->parent;
+  keep->parent = gp;
+  if (gp == NULL)
+    W.root = keep;
+  else if (gp->a == p)
+    gp->a = keep;
+  else
+    gp->b = keep;
+  free(w->drawn);
+  editorLayoutFree(w->layout);
+  free(w);
+  free(p);
+
+  W.active = windowLeaf(keep);
+  windowPlace(W.root, 0, 0, W.rows - 1, windowCols());
+  windowLoad(W.active);
+  return 1;
+}
+
+static int windowCount(struct window *w) {
+  return w->a ? windowCount(w->a) + windowCount(w->b) : 1;
+}
+
+int editorWindows() { return windowCount(W.root); }
+
+// make the next window in screen order active
+void editorWindowNext() {
+  windowSave(W.active);
+  struct window *w = W.active;
+  while (w->parent && w->parent->b == w)
+    w = w->parent;
+  W.active = windowLeaf(w->parent ? w->parent->b : W.root);
+  windowLoad(W.active);
+}
+
+/* shared rows */
+
+// where row goes when delta rows are inserted at at, or -delta deleted there
+static int windowShiftRow(int row, int at, int delta) {
+  if (delta > 0)
+    return at <= row ? row + delta : row;
+  if (row >= at - delta)
+    return row + delta;
+  return row > at ? at : row; // one of the deleted rows
+}
+
+static void windowShift(struct window *w, int at, int delta) {
+  if (w->a) {
+    windowShift(w->a, at, delta);
+    windowShift(w->b, at, delta);
+    return;
+  }
+  if (w == W.active) // E is moved by whoever made the change
+    return;
+  // keep the other windows on the same text
+  w->v.cy = windowShiftRow(w->v.cy, at, delta);
+  w->v.rowoff = windowShiftRow(w->v.rowoff, at, delta);
+}
+
+void editorWindowRowsInserted(int at, int n) {
+  if (W.root)
+    windowShift(W.root, at, n);
+}
+
+void editorWindowRowsDeleted(int at, int n) {
+  if (W.root)
+    windowShift(W.root, at, -n);
+}
+
+/* drawing */
+
+static uint64_t windowHash(const char *s, int len, int cols) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ (uint64_t)cols; // fnv-1a
+  for (int i = 0; i < len; i++)
+    h = (h ^ (unsigned char)s[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+static struct abuf *frame;  // frame being drawn
+static struct window *drawing; // window being drawn
+
+// send screen line y of the window being drawn unless it is already there
+static void windowEmit(int y, struct abuf *line, int cols) {
+  struct window *w = drawing;
+  uint64_t h = windowHash(line->b, line->len, cols);
+  if (w->valid && w->drawn[y] == h)
+    return;
+  w->drawn[y] = h;
+
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", w->top + y + 1,
+                     w->left + 1);
+  abAppend(frame, buf, len);
+  abAppend(frame, line->b, line->len);
+  if (w->left + w->cols >= W.cols) { // reaches the right edge
+    abAppend(frame, "\x1b[K", 3);
+    return;
+  }
+  for (; cols < w->v.screencols + editorDiffGutter(); cols++)
+    abAppend(frame, " ", 1);
+  abAppend(frame, "\x1b[7m|\x1b[m", 8); // separator
+}
+
+static void windowDraw(struct window *w) {
+  if (w->a) {
+    windowDraw(w->a);
+    windowDraw(w->b);
+    return;
+  }
+  if (w->rows < 2) // squeezed out by a small terminal
+    return;
+  windowLoad(w);
+  if (w != W.active && editorLayoutHidden(E.cy)) // folded from another window
+    E.cy = editorLayoutPrevRow(E.cy);
+  editorScroll();
+  drawing = w;
+  editorDrawRows(windowEmit);
+
+  struct abuf line = ABUF_INIT;
+  editorDrawStatusBar(&line, w == W.active);
+  windowEmit(w->rows - 1, &line, E.screencols + editorDiffGutter());
+  abFree(&line);
+
+  w->valid = 1;
+  windowSave(w);
+}
+
+// draw every window and the message line, top and left get where the active
+// window starts, whose view is in E afterwards
+void editorWindowDraw(struct abuf *ab, int *top, int *left) {
+  frame = ab;
+  windowSave(W.active);
+  windowDraw(W.root);
+  windowLoad(W.active);
+  *top = W.active->top;
+  *left = W.active->left;
+  editorPreviewDraw(ab, 0, windowCols(), W.rows - 1, W.cols - windowCols());
+
+  struct abuf line = ABUF_INIT;
+  editorDrawMessageBar(&line, W.cols);
+  uint64_t h = windowHash(line.b, line.len, W.cols);
+  if (!W.msg_valid || W.msg != h) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;1H", W.rows);
+    abAppend(ab, buf, len);
+    abAppend(ab, line.b, line.len);
+    W.msg = h;
+    W.msg_valid = 1;
+  }
+  abFree(&line);
+}
@@ -0,0 +1,23 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "editor.h"
+
+// split windows over the one buffer
+// windows are the leaves of a tree of horizontal and vertical splits, each
+// with its own view, the view of the active window is the one in E so the
+// rest of the editor only ever sees one, drawing loads every window in turn
+// and only sends the screen lines that changed since the last frame
+void editorWindowInit(int rows, int cols);
+void editorWindowResize(int rows, int cols);
+void editorWindowInvalidate();
+void editorWindowRelayout();
+int editorWindowSplit(int vertical);
+int editorWindowClose();
+int editorWindows();
+void editorWindowNext();
+void editorWindowDraw(struct abuf *ab, int *top, int *left);
+void editorWindowRowsInserted(int at, int n);
+void editorWindowRowsDeleted(int at, int n);
+
+#endif // WINDOW_H
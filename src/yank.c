@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "macro.h"
+#include "output.h"
+#include "term.h"
+#include "yank.h"
+
+#define YANK_REGS 28          // " then a to z, then +
+#define YANK_CLIP (YANK_REGS - 1)
+#define YANK_CLIP_MAX (1 << 20) // terminals drop longer OSC 52 strings
+
+// the lines of a register, shared by every register holding them
+struct yankSlice {
+  int refs;
+  int first, n; // rows it is made of while none of them changed, first -1 after
+  char *text;   // once copied out, the lines each ended by a newline
+  long long len;
+  struct yankSlice *next; // in Y.live while it points at rows
+};
+
+static struct {
+  struct yankSlice *reg[YANK_REGS];
+  struct yankSlice *live; // slices pointing at rows
+  int next;               // register for the next yank or put, 0 is "
+  int anchor;             // row the visual selection started on
+} Y = {{NULL}, NULL, 0, 0};
+
+/* slices */
+
+// the rows [first, first + n) each ended by a newline
+static char *yankJoin(int first, int n, long long *len) {
+  *len = 0;
+  for (int j = first; j < first + n; j++)
+    *len += E.row[j].size + 1;
+  char *text = malloc(*len ? *len : 1), *p = text;
+  for (int j = first; j < first + n; j++) {
+    memcpy(p, E.row[j].chars, E.row[j].size);
+    p += E.row[j].size;
+    *p++ = '\n';
+  }
+  return text;
+}
+
+// copy the text out of the rows before they change
+static void yankCopy(struct yankSlice *s) {
+  s->text = yankJoin(s->first, s->n, &s->len);
+  struct yankSlice **pp = &Y.live;
+  while (*pp != s)
+    pp = &(*pp)->next;
+  *pp = s->next;
+  s->first = -1;
+}
+
+static void yankRelease(struct yankSlice *s) {
+  if (!s || --s->refs)
+    return;
+  if (s->first != -1) {
+    struct yankSlice **pp = &Y.live;
+    while (*pp != s)
+      pp = &(*pp)->next;
+    *pp = s->next;
+  }
+  free(s->text);
+  free(s);
+}
+
+static void yankStore(int reg, struct yankSlice *s) {
+  s->refs++;
+  yankRelease(Y.reg[reg]);
+  Y.reg[reg] = s;
+}
+
+void editorYankRowChanging(int row) {
+  for (struct yankSlice *s = Y.live, *next; s; s = next) {
+    next = s->next;
+    if (row >= s->first && row < s->first + s->n)
+      yankCopy(s);
+  }
+}
+
+void editorYankRowsInserting(int at, int n) {
+  for (struct yankSlice *s = Y.live, *next; s; s = next) {
+    next = s->next;
+    if (at <= s->first)
+      s->first += n;
+    else if (at < s->first + s->n)
+      yankCopy(s);
+  }
+}
+
+void editorYankRowsDeleting(int at, int n) {
+  for (struct yankSlice *s = Y.live, *next; s; s = next) {
+    next = s->next;
+    if (at + n <= s->first)
+      s->first -= n;
+    else if (at < s->first + s->n)
+      yankCopy(s);
+  }
+}
+
+void editorYankRowsFreeing() {
+  while (Y.live)
+    yankCopy(Y.live);
+}
+
+/* clipboard */
+
+// hand the lines to the terminal, which puts them on the system clipboard
+static void yankClipboard(struct yankSlice *s) {
+  static const char b64[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  if (s->first != -1) {
+    long long len = 0;
+    for (int j = s->first; j < s->first + s->n && len <= YANK_CLIP_MAX; j++)
+      len += E.row[j].size + 1;
+    if (len > YANK_CLIP_MAX) {
+      editorSetStatusMessage("Too much for the clipboard");
+      return;
+    }
+    yankCopy(s);
+  }
+  if (s->len > YANK_CLIP_MAX) {
+    editorSetStatusMessage("Too much for the clipboard");
+    return;
+  }
+  const unsigned char *t = (const unsigned char *)s->text;
+  char *buf = malloc(4 * (s->len + 2) / 3 + 16);
+  int n = sprintf(buf, "\x1b]52;c;");
+  long long i;
+  for (i = 0; i + 2 < s->len; i += 3) {
+    buf[n++] = b64[t[i] >> 2];
+    buf[n++] = b64[(t[i] & 3) << 4 | t[i + 1] >> 4];
+    buf[n++] = b64[(t[i + 1] & 15) << 2 | t[i + 2] >> 6];
+    buf[n++] = b64[t[i + 2] & 63];
+  }
+  if (i < s->len) {
+    int two = (i + 1 < s->len);
+    buf[n++] = b64[t[i] >> 2];
+    buf[n++] = b64[(t[i] & 3) << 4 | (two ? t[i + 1] >> 4 : 0)];
+    buf[n++] = two ? b64[(t[i + 1] & 15) << 2] : '=';
+    buf[n++] = '=';
+  }
+  buf[n++] = '\a';
+  editorOutputWrite(buf, n);
+  free(buf);
+}
+
+/* commands */
+
+// " in normal or visual mode, the register for the next yank or put
+void editorYankRegister() {
+  int c = editorMacroKey();
+  if (c == '"')
+    Y.next = 0;
+  else if (c >= 'a' && c <= 'z')
+    Y.next = 1 + c - 'a';
+  else if (c == '+')
+    Y.next = YANK_CLIP;
+  else if (c != '\x1b')
+    editorSetStatusMessage("Registers are a to z, \" and +");
+}
+
+static int yankName(int reg) {
+  return reg == 0 ? '"' : reg == YANK_CLIP ? '+' : 'a' + reg - 1;
+}
+
+void editorYankVisual() {
+  if (E.numrows == 0)
+    return;
+  if (E.cy >= E.numrows)
+    E.cy = E.numrows - 1;
+  Y.anchor = E.cy;
+  E.mode = VISUAL;
+}
+
+// the rows selected in visual mode
+int editorYankSelection(int *first, int *last) {
+  if (E.mode != VISUAL || E.numrows == 0)
+    return 0;
+  int cy = E.cy < E.numrows ? E.cy : E.numrows - 1;
+  int anchor = Y.anchor < E.numrows ? Y.anchor : E.numrows - 1;
+  *first = cy < anchor ? cy : anchor;
+  *last = cy < anchor ? anchor : cy;
+  return 1;
+}
+
+// yank the selected rows into " and the register picked with ", deleting
+// them if del
+void editorYank(int del) {
+  int first, last;
+  if (!editorYankSelection(&first, &last))
+    return;
+  struct yankSlice *s = calloc(1, sizeof(struct yankSlice));
+  s->first = first;
+  s->n = last - first + 1;
+  s->next = Y.live;
+  Y.live = s;
+  yankStore(0, s);
+  if (Y.next)
+    yankStore(Y.next, s);
+  int clip = (Y.next == YANK_CLIP);
+  Y.next = 0;
+  E.mode = NORMAL;
+  E.cy = first;
+  E.cx = 0;
+
+  editorSetStatusMessage(del ? "%d fewer lines" : "%d lines yanked", s->n);
+  if (clip)
+    yankClipboard(s);
+  if (del)
+    editorDelRows(first, s->n);
+}
+
+// put the register picked with " or else " after the cursor line, or before
+void editorYankPut(int before) {
+  struct yankSlice *s = Y.reg[Y.next];
+  int name = yankName(Y.next);
+  Y.next = 0;
+  if (!s) {
+    editorSetStatusMessage("Register %c is empty", name);
+    return;
+  }
+  int at = (before || E.numrows == 0) ? E.cy : E.cy + 1;
+  if (at > E.numrows)
+    at = E.numrows;
+  // a slice pointing at rows moves along with them unless the put splits it
+  char *lines = NULL;
+  long long len = 0;
+  if (s->first != -1 && at > s->first && at < s->first + s->n)
+    yankCopy(s);
+  else if (s->first != -1)
+    lines = yankJoin(s->first, s->n, &len);
+  editorInsertRows(at, lines ? lines : s->text, lines ? len : s->len);
+  free(lines);
+  E.cy = at;
+  E.cx = 0;
+  editorSetStatusMessage("%d more lines", s->n);
+}
@@ -0,0 +1,21 @@
+#ifndef YANK_H
+#define YANK_H
+
+// registers for yank and put, V selects whole lines, y yanks them, d deletes
+// them and p or P puts a register after or before the cursor line, "x picks
+// register x (a to z, " or + which also goes to the clipboard with OSC 52)
+// a yank only points at the rows, the text is copied out of them when one is
+// about to change, so yanking any number of lines takes no time or memory
+void editorYankVisual();
+int editorYankSelection(int *first, int *last);
+void editorYank(int del);
+void editorYankPut(int before);
+void editorYankRegister();
+
+// the rows are about to change
+void editorYankRowChanging(int row);
+void editorYankRowsInserting(int at, int n);
+void editorYankRowsDeleting(int at, int n);
+void editorYankRowsFreeing();
+
+#endif // YANK_H
@@ -0,0 +1,509 @@
+// syngen, turns the grammar files in syntax/ into C
+//
+//   syngen syntax/c.syn syntax/sh.syn ... > syntax.c
+//
+// every grammar gets a scanner with the delimiters unrolled into a switch,
+// a perfect hash over its keywords and the separator set as a bitmap, plus
+// the HLDB entry pointing at them. the interpreted highlighter in main.c
+// keeps working off the same entry, see :hlbench
+//
+// grammar lines are "directive values...", lines starting with # are
+// comments
+//   name markdown           filetype shown in the status bar
+//   match .md .markdown     extensions (leading .) or substrings of the name
+//   comment //              singleline comment start
+//   multiline /* */         multiline comment start and end
+//   highlight numbers strings
+//   keywords if while ...   HL_KEYWORD1, may repeat
+//   types int char ...      HL_KEYWORD2, may repeat
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYN_MAX_WORDS 1024
+
+struct grammar {
+  const char *file;
+  char name[64];
+  char id[64]; // name as a C identifier
+  char *match[64];
+  int nmatch;
+  char *scs, *mcs, *mce;
+  int numbers, strings;
+  char *words[SYN_MAX_WORDS];
+  int kinds[SYN_MAX_WORDS]; // 1 keyword, 2 type
+  int nwords;
+};
+
+static void fail(const char *file, int line, const char *msg) {
+  fprintf(stderr, "%s:%d: %s\n", file, line, msg);
+  exit(1);
+}
+
+// same set as is_seperator in utility.c
+static int isSep(int c) {
+  return c == '\0' || isspace(c) || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+/* parsing */
+
+static void parse(struct grammar *g, const char *file) {
+  FILE *fp = fopen(file, "r");
+  if (!fp) {
+    perror(file);
+    exit(1);
+  }
+  memset(g, 0, sizeof(*g));
+  g->file = file;
+
+  char line[4096];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    lineno++;
+    if (line[0] == '#')
+      continue;
+    char *tok[SYN_MAX_WORDS];
+    int n = 0;
+    for (char *t = strtok(line, " \t\r\n"); t && n < SYN_MAX_WORDS;
+         t = strtok(NULL, " \t\r\n"))
+      tok[n++] = strdup(t);
+    if (n == 0)
+      continue;
+
+    if (!strcmp(tok[0], "name") && n == 2) {
+      snprintf(g->name, sizeof(g->name), "%s", tok[1]);
+    } else if (!strcmp(tok[0], "match")) {
+      for (int j = 1; j < n && g->nmatch < 63; j++)
+        g->match[g->nmatch++] = tok[j];
+    } else if (!strcmp(tok[0], "comment") && n == 2) {
+      g->scs = tok[1];
+    } else if (!strcmp(tok[0], "multiline") && n == 3) {
+      g->mcs = tok[1];
+      g->mce = tok[2];
+    } else if (!strcmp(tok[0], "highlight")) {
+      for (int j = 1; j < n; j++) {
+        if (!strcmp(tok[j], "numbers"))
+          g->numbers = 1;
+        else if (!strcmp(tok[j], "strings"))
+          g->strings = 1;
+        else
+          fail(file, lineno, "highlight takes numbers and strings");
+      }
+    } else if (!strcmp(tok[0], "keywords") || !strcmp(tok[0], "types")) {
+      for (int j = 1; j < n; j++) {
+        for (char *c = tok[j]; *c; c++)
+          if (isSep((unsigned char)*c))
+            fail(file, lineno, "keywords can't contain separators");
+        for (int k = 0; k < g->nwords; k++)
+          if (!strcmp(g->words[k], tok[j]))
+            fail(file, lineno, "duplicate keyword");
+        if (g->nwords == SYN_MAX_WORDS)
+          fail(file, lineno, "too many keywords");
+        g->words[g->nwords] = tok[j];
+        g->kinds[g->nwords++] = (tok[0][0] == 'k') ? 1 : 2;
+      }
+    } else {
+      fail(file, lineno, "unknown directive");
+    }
+  }
+  fclose(fp);
+
+  if (!g->name[0])
+    fail(file, lineno, "missing name");
+  int k = 0;
+  for (char *c = g->name; *c && k < 62; c++)
+    g->id[k++] = isalnum((unsigned char)*c) ? tolower((unsigned char)*c) : '_';
+  g->id[k] = '\0';
+}
+
+/* emitting */
+
+static void emitStr(const char *s) {
+  if (!s) {
+    printf("NULL");
+    return;
+  }
+  putchar('"');
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (isprint(c))
+      putchar(c);
+    else
+      printf("\\%03o", c);
+  }
+  putchar('"');
+}
+
+static void emitChar(FILE *f, int c) {
+  if (c == '\'' || c == '\\')
+    fprintf(f, "'\\%c'", c);
+  else if (isprint(c))
+    fprintf(f, "'%c'", c);
+  else
+    fprintf(f, "'\\%03o'", c);
+}
+
+// s[i..) starts with d, unrolled
+static void emitMatch(FILE *f, const char *d) {
+  for (int j = 0; d[j]; j++) {
+    fprintf(f, "%ss[i + %d] == ", j ? " && " : "", j);
+    emitChar(f, (unsigned char)d[j]);
+  }
+}
+
+static uint32_t kwHash(const char *s, int n, uint32_t seed) {
+  uint32_t h = (uint32_t)(unsigned char)s[0] * 0x9e3779b1u +
+               (uint32_t)(unsigned char)s[n - 1] * 0x85ebca77u +
+               (uint32_t)(unsigned char)s[n / 2] * 0xc2b2ae3du + (uint32_t)n;
+  return h * seed;
+}
+
+// smallest table and a seed that put every keyword in its own slot
+static void perfectHash(struct grammar *g, int *bits, uint32_t *seed) {
+  int b = 1;
+  while ((1 << b) < 2 * g->nwords)
+    b++;
+  for (; b <= 16; b++) {
+    int size = 1 << b;
+    char *used = malloc(size);
+    for (uint32_t k = 1; k < 200000; k++) {
+      uint32_t s = (k * 0x9e3779b9u) | 1; // spread over all the bits
+      memset(used, 0, size);
+      int ok = 1;
+      for (int j = 0; ok && j < g->nwords; j++) {
+        uint32_t slot = kwHash(g->words[j], strlen(g->words[j]), s) >> (32 - b);
+        ok = !used[slot];
+        used[slot] = 1;
+      }
+      if (ok) {
+        free(used);
+        *bits = b;
+        *seed = s;
+        return;
+      }
+    }
+    free(used);
+  }
+  fail(g->file, 0, "no perfect hash for the keywords");
+}
+
+static void emitKeywords(struct grammar *g) {
+  // the interpreted highlighter takes the kilo format, types end in |
+  printf("static char *%s_keywords[] = {", g->id);
+  for (int j = 0; j < g->nwords; j++) {
+    char w[256];
+    snprintf(w, sizeof(w), "%s%s", g->words[j], g->kinds[j] == 2 ? "|" : "");
+    emitStr(w);
+    printf(", ");
+  }
+  printf("NULL};\n\n");
+
+  if (g->nwords == 0) {
+    printf("static int %s_keyword(const char *s, int *len) {\n"
+           "  (void)s;\n  *len = 0;\n  return 0;\n}\n\n",
+           g->id);
+    return;
+  }
+
+  int bits;
+  uint32_t seed;
+  perfectHash(g, &bits, &seed);
+  int minlen = 1 << 30, maxlen = 0;
+  const char *slots[1 << 16] = {NULL};
+  int kinds[1 << 16] = {0};
+  for (int j = 0; j < g->nwords; j++) {
+    int n = strlen(g->words[j]);
+    minlen = n < minlen ? n : minlen;
+    maxlen = n > maxlen ? n : maxlen;
+    uint32_t slot = kwHash(g->words[j], n, seed) >> (32 - bits);
+    slots[slot] = g->words[j];
+    kinds[slot] = g->kinds[j];
+  }
+
+  printf("static const struct synKeyword %s_kwtab[%d] = {\n", g->id, 1 << bits);
+  for (int j = 0; j < (1 << bits); j++) {
+    if (!slots[j]) {
+      printf("    {NULL, 0, 0},\n");
+      continue;
+    }
+    printf("    {");
+    emitStr(slots[j]);
+    printf(", %d, %s},\n", (int)strlen(slots[j]),
+           kinds[j] == 2 ? "HL_KEYWORD2" : "HL_KEYWORD1");
+  }
+  printf("};\n\n");
+
+  printf("// highlight of the word at s if it is a keyword, else 0\n");
+  printf("static int %s_keyword(const char *s, int *len) {\n", g->id);
+  printf("  int n = 0;\n"
+         "  while (n <= %d && !SYN_SEP(s[n]))\n"
+         "    n++;\n"
+         "  *len = n;\n",
+         maxlen);
+  printf("  if (n < %d || n > %d)\n    return 0;\n", minlen, maxlen);
+  printf("  uint32_t h = (uint32_t)(unsigned char)s[0] * 0x9e3779b1u +\n"
+         "              (uint32_t)(unsigned char)s[n - 1] * 0x85ebca77u +\n"
+         "              (uint32_t)(unsigned char)s[n / 2] * 0xc2b2ae3du +\n"
+         "              (uint32_t)n;\n");
+  printf("  const struct synKeyword *k = &%s_kwtab[(h * %uu) >> %d];\n", g->id,
+         seed, 32 - bits);
+  printf("  return (k->len == n && !memcmp(k->word, s, n)) ? k->hl : 0;\n}\n\n");
+}
+
+// the checks of the interpreted highlighter for a char c, in its order,
+// each one continues the loop when it matches
+static void emitCase(FILE *f, struct grammar *g, int c) {
+  if (g->scs && (unsigned char)g->scs[0] == c) {
+    fprintf(f, "      if (");
+    emitMatch(f, g->scs);
+    fprintf(f, ") {\n"
+           "        synFill(hl, base, cap, i, HL_COMMENT, to - i);\n"
+           "        st->line_comment = 1;\n"
+           "        st->prev_hl = HL_COMMENT;\n"
+           "        return to;\n"
+           "      }\n");
+  }
+  if (g->mcs && (unsigned char)g->mcs[0] == c) {
+    fprintf(f, "      if (");
+    emitMatch(f, g->mcs);
+    fprintf(f, ") {\n"
+           "        synFill(hl, base, cap, i, HL_MLCOMMENT, %d);\n"
+           "        st->prev_hl = HL_MLCOMMENT;\n"
+           "        i += %d;\n"
+           "        st->in_comment = 1;\n"
+           "        continue;\n"
+           "      }\n",
+           (int)strlen(g->mcs), (int)strlen(g->mcs));
+  }
+  if (g->strings && (c == '"' || c == '\'')) {
+    fprintf(f, "      st->in_string = c;\n"
+           "      synFill(hl, base, cap, i, HL_STRING, 1);\n"
+           "      st->prev_hl = HL_STRING;\n"
+           "      i++;\n"
+           "      continue;\n");
+    return;
+  }
+  if (g->numbers && isdigit(c)) {
+    fprintf(f, "      if (st->prev_sep || prev_hl == HL_NUMBER) {\n"
+           "        synFill(hl, base, cap, i, HL_NUMBER, 1);\n"
+           "        st->prev_hl = HL_NUMBER;\n"
+           "        i++;\n"
+           "        st->prev_sep = 0;\n"
+           "        continue;\n"
+           "      }\n");
+  }
+  if (g->numbers && c == '.') {
+    fprintf(f, "      if (prev_hl == HL_NUMBER) {\n"
+           "        synFill(hl, base, cap, i, HL_NUMBER, 1);\n"
+           "        i++;\n"
+           "        st->prev_sep = 0;\n"
+           "        continue;\n"
+           "      }\n");
+  }
+  fprintf(f, "      break;\n");
+}
+
+static void emitScanner(struct grammar *g) {
+  printf("static int %s_scan(struct hlState *st, const char *s, int len, int i,\n"
+         "                   int to, unsigned char *hl, int base, int cap) {\n",
+         g->id);
+  printf("  if (st->line_comment) {\n"
+         "    synFill(hl, base, cap, i, HL_COMMENT, to - i);\n"
+         "    return to;\n"
+         "  }\n\n"
+         "  while (i < to) {\n"
+         "    unsigned char c = s[i];\n");
+  if (g->numbers)
+    printf("    unsigned char prev_hl = st->prev_hl;\n");
+  printf("\n");
+
+  if (g->mcs) {
+    int n = strlen(g->mce);
+    printf("    if (st->in_comment) { // jump to the end of the comment\n"
+           "      int lim = to + %d < len ? to + %d : len;\n"
+           "      const char *e = memmem(&s[i], lim - i, ",
+           n - 1, n - 1);
+    emitStr(g->mce);
+    printf(", %d);\n", n);
+    printf("      st->prev_hl = HL_MLCOMMENT;\n"
+           "      if (!e) {\n"
+           "        synFill(hl, base, cap, i, HL_MLCOMMENT, to - i);\n"
+           "        return to;\n"
+           "      }\n"
+           "      int end = e - s + %d;\n"
+           "      synFill(hl, base, cap, i, HL_MLCOMMENT, end - i);\n"
+           "      i = end;\n"
+           "      st->in_comment = 0;\n"
+           "      st->prev_sep = 1;\n"
+           "      continue;\n"
+           "    }\n\n",
+           n);
+  }
+
+  if (g->strings) {
+    printf("    if (st->in_string) {\n"
+           "      synFill(hl, base, cap, i, HL_STRING, 1);\n"
+           "      st->prev_hl = HL_STRING;\n"
+           "      if (c == '\\\\' && i + 1 < len) {\n"
+           "        synFill(hl, base, cap, i + 1, HL_STRING, 1);\n"
+           "        i += 2;\n"
+           "        continue;\n"
+           "      }\n"
+           "      if (c == st->in_string)\n"
+           "        st->in_string = 0;\n"
+           "      i++;\n"
+           "      st->prev_sep = 1;\n"
+           "      continue;\n"
+           "    }\n\n");
+  }
+
+  // chars that can start something other than a keyword
+  int special[256] = {0};
+  if (g->scs)
+    special[(unsigned char)g->scs[0]] = 1;
+  if (g->mcs)
+    special[(unsigned char)g->mcs[0]] = 1;
+  if (g->strings)
+    special['"'] = special['\''] = 1;
+  if (g->numbers) {
+    for (int c = '0'; c <= '9'; c++)
+      special[c] = 1;
+    special['.'] = 1;
+  }
+  // chars with the same checks share a case
+  char *body[256] = {NULL};
+  for (int c = 1; c < 256; c++) {
+    if (!special[c])
+      continue;
+    size_t n;
+    FILE *f = open_memstream(&body[c], &n);
+    emitCase(f, g, c);
+    fclose(f);
+  }
+  printf("    switch (c) {\n");
+  for (int c = 1; c < 256; c++) {
+    if (!body[c])
+      continue;
+    for (int d = c; d < 256; d++) {
+      if (body[d] && (d == c || !strcmp(body[d], body[c]))) {
+        printf("    case ");
+        emitChar(stdout, d);
+        printf(":\n");
+        if (d != c) {
+          free(body[d]);
+          body[d] = NULL;
+        }
+      }
+    }
+    printf("%s", body[c]);
+    free(body[c]);
+  }
+  printf("    }\n\n");
+
+  printf("    if (st->prev_sep) {\n"
+         "      int n;\n"
+         "      int kw = %s_keyword(&s[i], &n);\n"
+         "      if (kw) {\n"
+         "        st->prev_hl = kw;\n"
+         "        synFill(hl, base, cap, i, kw, n);\n"
+         "        i += n;\n"
+         "        st->prev_sep = 0;\n"
+         "        continue;\n"
+         "      }\n"
+         "    }\n\n"
+         "    st->prev_sep = SYN_SEP(c) != 0;\n"
+         "    st->prev_hl = HL_NORMAL;\n"
+         "    i++;\n"
+         "  }\n"
+         "  return i;\n"
+         "}\n\n",
+         g->id);
+}
+
+static void emitGrammar(struct grammar *g) {
+  printf("/* %s, from %s */\n\n", g->name, g->file);
+  printf("static char *%s_match[] = {", g->id);
+  for (int j = 0; j < g->nmatch; j++) {
+    emitStr(g->match[j]);
+    printf(", ");
+  }
+  printf("NULL};\n");
+  emitKeywords(g);
+  emitScanner(g);
+}
+
+int main(int argc, char **argv) {
+  int n = argc - 1;
+  struct grammar *g = calloc(n ? n : 1, sizeof(struct grammar));
+  for (int j = 0; j < n; j++)
+    parse(&g[j], argv[j + 1]);
+
+  printf("// generated by tools/syngen.c, do not edit\n\n"
+         "#define _GNU_SOURCE\n\n"
+         "#include <stdint.h>\n"
+         "#include <string.h>\n\n"
+         "#include \"editor.h\"\n"
+         "#include \"term.h\"\n"
+         "#include \"utility.h\"\n\n"
+         "struct synKeyword {\n"
+         "  const char *word;\n"
+         "  unsigned char len;\n"
+         "  unsigned char hl;\n"
+         "};\n\n");
+
+  printf("// is_seperator as a bitmap\nstatic const unsigned char "
+         "syn_sep[32] = {");
+  for (int j = 0; j < 32; j++) {
+    int byte = 0;
+    for (int b = 0; b < 8; b++) {
+      int c = j * 8 + b;
+      if (c < 128 && isSep(c))
+        byte |= 1 << b;
+    }
+    printf("%s0x%02x", j ? ", " : "", byte);
+  }
+  printf("};\n"
+         "#define SYN_SEP(c)                                                  "
+         "           \\\n"
+         "  (syn_sep[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & "
+         "7)))\n\n");
+
+  printf("static void synFill(unsigned char *hl, int base, int cap, int i, int "
+         "v,\n"
+         "                    int n) {\n"
+         "  if (!hl)\n"
+         "    return;\n"
+         "  int lo = (i < base) ? base : i;\n"
+         "  int hi = (i + n > base + cap) ? base + cap : i + n;\n"
+         "  if (hi > lo)\n"
+         "    memset(&hl[lo - base], v, hi - lo);\n"
+         "}\n\n");
+
+  for (int j = 0; j < n; j++)
+    emitGrammar(&g[j]);
+
+  printf("struct editorSyntax HLDB[] = {\n");
+  for (int j = 0; j < n; j++) {
+    printf("    {");
+    emitStr(g[j].name);
+    printf(", %s_match, %s_keywords, ", g[j].id, g[j].id);
+    emitStr(g[j].scs);
+    printf(", ");
+    emitStr(g[j].mcs);
+    printf(", ");
+    emitStr(g[j].mce);
+    printf(", %s | %s, %s_scan},\n",
+           g[j].numbers ? "HL_HIGHLIGHT_NUMBERS" : "0",
+           g[j].strings ? "HL_HIGHLIGHT_STRINGS" : "0", g[j].id);
+  }
+  printf("};\n\n"
+         "const unsigned int HLDB_ENTRIES = sizeof(HLDB) / sizeof(HLDB[0]);\n");
+  return 0;
+}